@@ -110,16 +110,20 @@ void interface_output_string (const char *msg)
   Serial.print (msg);
   }
 
+/*===========================================================================
+  interface_output_chars
+===========================================================================*/
+void interface_output_chars (const char *s, int len)
+  {
+  Serial.write ((const uint8_t *)s, len);
+  }
+
 /*===========================================================================
   interface_output_number
 ===========================================================================*/
 void interface_output_number (VARTYPE i)
   {
-#if VARTYPE == long
-  sprintf (buff, "%ld", i);
-#else
-  sprintf (buff, "%d", i);
-#endif
+  sprintf (buff, PRINTF_DEC, i);
   Serial.print (buff);
   }
 
@@ -192,6 +196,14 @@ VARTYPE interface_millis (void)
   return (VARTYPE) millis();
   }
 
+/*============================================================================
+ * interface_micros 
+ * =========================================================================*/
+uint32_t interface_micros (void)
+  {
+  return micros();
+  }
+
 /*============================================================================
  * interface_delay
  * =========================================================================*/
@@ -277,72 +289,56 @@ void interface_info (void)
   }
 
 /*============================================================================
- * interface_save
+ * interface_heap_block_size
+ * avr-libc's malloc() stores the size of each block in the two bytes
+ *   that precede it, as it does for the blocks in the free list. 
  * =========================================================================*/
-BOOL interface_save (const BasicProgram *bp)
+size_t interface_heap_block_size (void *p)
   {
-  BOOL ret = FALSE;
+  return ((size_t *)p)[-1];
+  }
 
-  int eeprom_len = EEPROM.length ();
-  int prog_len = basicprogram_get_length (bp); 
-  if (prog_len < eeprom_len - 3)
+/*============================================================================
+ * interface_heap_layout
+ * =========================================================================*/
+void interface_heap_layout (uint32_t *heap_size, uint32_t *free_list)
+  {
+  if ((int)__brkval == 0)
     {
-    int i = 0;
-    EEPROM.write (i++, 'P');
-    EEPROM.write (i++, 'M');
-    EEPROM.write (i++, 'B');
-    const char *ptr = basicprogram_c_str (bp);
-    for (i = 0; i <= prog_len; i++) // Include the final zero
-      EEPROM.write (i + 3, ptr[i]);
-    ret = TRUE;
+    *heap_size = 0;
+    *free_list = 0;
     }
   else
     {
-    strings_output_string (BASIC_ERR_PROGRAM_TOO_LARGE);
-    interface_output_endl();
+    *heap_size = (int)__brkval - (int)&__heap_start;
+    *free_list = free_list_size();
     }
-
-  return ret;
   }
 
 /*============================================================================
- * interface_load
+ * interface_eeprom_size
  * =========================================================================*/
-BOOL interface_load (BasicProgram *bp)
+int interface_eeprom_size (void)
   {
-  BOOL ret = FALSE;
-
-  char c1 = EEPROM.read (0);
-  char c2 = EEPROM.read (1);
-  char c3 = EEPROM.read (2);
+  return EEPROM.length ();
+  }
 
-  if (c1 == 'P' && c2 == 'M' && c3 == 'B')
-    {
-    basicprogram_clear (bp);
-    int i = 3;
-    char c = EEPROM.read (i);
-    BOOL ok = TRUE;
-    while (c && ok)
-      {
-      i++;
-      ok = basicprogram_add_char (bp, c);
-      c = EEPROM.read (i);
-      }
-    if (ok)
-      ret = TRUE;
-    else
-      {
-      strings_output_string (BASIC_ERR_NOMEM);
-      interface_output_endl();
-      }
-    }
-  else
-    {
-    strings_output_string (BASIC_ERR_NO_STORED_PROGRAM);
-    interface_output_endl();
-    }
+/*============================================================================
+ * interface_eeprom_read
+ * =========================================================================*/
+uint8_t interface_eeprom_read (int addr)
+  {
+  return EEPROM.read (addr);
+  }
 
-  return ret;
+/*============================================================================
+ * interface_eeprom_write
+ * EEPROM.update() only writes bytes that have changed, which saves wear
+ * on the EEPROM when the same program is saved again.
+ * =========================================================================*/
+void interface_eeprom_write (int addr, uint8_t b)
+  {
+  EEPROM.update (addr, b);
   }
 
 /*============================================================================
@@ -11,31 +11,70 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <ctype.h>
 #include "basicprogram.h"
+#include "tokenizer.h"
+#include "heap.h"
+#include "numparse.h"
 
 #define KLOG_IN
 #define KLOG_OUT
 
-typedef struct
-  {
-  BOOL found;
-  VARTYPE line;
-  VARTYPE line2;
-  const char *p1;
-  const char *p2;
-  } IterateLineData;
-
 /*============================================================================
   
   BasicProgram
 
+  The lines are stored one after another, each starting with a header
+  (see basicprogram.h) and ending with a \n. There is always a zero
+  after the last line, which reads as a line of length zero.
+
   ==========================================================================*/
 struct _BasicProgram
   {
   char *str;
+  int length;
+  // For a program that is not in RAM, str is NULL, and the program is
+  //   read using fetch
+  TokenizerFetch fetch;
+  const void *source;
   };
 
+/*============================================================================
+  
+  basicprogram_byte
+  
+  ==========================================================================*/
+static char basicprogram_byte (const BasicProgram *self, TokenizerPos pos)
+  {
+  return self->str ? self->str [pos] : self->fetch (self->source, pos);
+  }
+
+/*============================================================================
+  
+  basicprogram_line_length
+
+  The length of the line whose header is at pos
+  
+  ==========================================================================*/
+static uint8_t basicprogram_line_length (const BasicProgram *self, 
+                 TokenizerPos pos)
+  {
+  return (uint8_t)basicprogram_byte (self, pos);
+  }
+
+/*============================================================================
+  
+  basicprogram_line_number
+
+  The number of the line whose header is at pos
+  
+  ==========================================================================*/
+static uint16_t basicprogram_line_number (const BasicProgram *self, 
+                 TokenizerPos pos)
+  {
+  return (uint8_t)basicprogram_byte (self, pos + 1)
+    | ((uint16_t)(uint8_t)basicprogram_byte (self, pos + 2) << 8);
+  }
+
 
 /*============================================================================
   
@@ -45,10 +84,14 @@ struct _BasicProgram
 BasicProgram *basicprogram_new_empty (void)
   {
   KLOG_IN
-  BasicProgram *self = malloc (sizeof (BasicProgram));
+  BasicProgram *self = HEAP_MALLOC (HEAP_SITE_PROGRAM, 
+    sizeof (BasicProgram));
   if (self)
     {
-    self->str = strdup (""); 
+    self->str = HEAP_STRDUP (HEAP_SITE_PROGRAM, ""); 
+    self->length = 0;
+    self->fetch = NULL;
+    self->source = NULL;
     }
   KLOG_OUT
   return self;
@@ -56,16 +99,21 @@ BasicProgram *basicprogram_new_empty (void)
   
 /*============================================================================
   
-  basicprogram_new
+  basicprogram_new_fetch
 
   ==========================================================================*/
-BasicProgram *basicprogram_new (const char *prog)
+BasicProgram *basicprogram_new_fetch (TokenizerFetch fetch, 
+                const void *source, int length)
   {
   KLOG_IN
-  BasicProgram *self = malloc (sizeof (BasicProgram));
+  BasicProgram *self = HEAP_MALLOC (HEAP_SITE_PROGRAM, 
+    sizeof (BasicProgram));
   if (self)
     {
-    self->str = strdup (prog); 
+    self->str = NULL;
+    self->length = length;
+    self->fetch = fetch;
+    self->source = source;
     }
   KLOG_OUT
   return self;
@@ -79,8 +127,18 @@ BasicProgram *basicprogram_new (const char *prog)
 void basicprogram_set_program (BasicProgram *self, const char *prog)
   {
   KLOG_IN
-  if (self->str) free (self->str);
-  self->str = strdup (prog); 
+  basicprogram_clear (self);
+  char line [MAX_LINE];
+  while (*prog)
+    {
+    const char *e = strchr (prog, '\n');
+    int n = e ? e - prog : (int)strlen (prog);
+    if (n > MAX_LINE - 1) n = MAX_LINE - 1;
+    memcpy (line, prog, n);
+    line[n] = 0;
+    basicprogram_insert_line (self, line);
+    prog = e ? e + 1 : prog + n;
+    }
   KLOG_OUT
   }
   
@@ -94,8 +152,8 @@ void basicprogram_destroy (BasicProgram *self)
   KLOG_IN
   if (self)
     {
-    free (self->str);
-    free (self);
+    HEAP_FREE (HEAP_SITE_PROGRAM, self->str);
+    HEAP_FREE (HEAP_SITE_PROGRAM, self);
     }
   KLOG_OUT
   }
@@ -112,78 +170,67 @@ const char *basicprogram_c_str (const BasicProgram *self)
 
 /*============================================================================
   
-  basicprogram_iterate_lines
+  basicprogram_get_fetch
 
   ==========================================================================*/
-void basicprogram_iterate_lines (const BasicProgram *self, 
-        BasicProgramIterator bpi, void *user_data)
+TokenizerFetch basicprogram_get_fetch (const BasicProgram *self, 
+                 const void **source)
   {
-  const char *p1 = self->str;
-  const char *p2 = strchr (p1, '\n');
-  BOOL cont = TRUE;
-  while (p2 && cont)
-    {
-    cont = bpi (self, p1, p2, user_data);
-    p1 = p2 + 1;
-    p2 = strchr (p1, '\n');
-    }
+  *source = self->source;
+  return self->fetch;
   }
 
 /*============================================================================
   
-  basicprogram_get_line_number
-  // TODO -- in theory, line numbers can be in hex. We really ought to
-  //   allow for this, as the parser can.
+  basicprogram_iterate_lines
 
   ==========================================================================*/
-BOOL basicprogram_get_line_number (const char *line, VARTYPE *n)
+void basicprogram_iterate_lines (const BasicProgram *self, 
+        BasicProgramIterator bpi, void *user_data)
   {
-  BOOL ret = FALSE;
-  VARTYPE total = 0;
-  int i = 0;
-  int c = line[i];
-  while (isdigit (c) && i <= MAX_NUMBER)
+  TokenizerPos p = 0;
+  BOOL cont = TRUE;
+  while (p < (TokenizerPos)self->length && cont)
     {
-    ret = TRUE;
-    int digit = c - '0';
-    total *= 10;
-    total += digit;
-    i++;
-    c = line[i];
+    int len = basicprogram_line_length (self, p);
+    cont = bpi (self, basicprogram_line_number (self, p), 
+      p, p + len - 1, user_data);
+    p += len;
     }
-  *n = total;
-  if (i > MAX_NUMBER) ret = FALSE;
-  return ret;
   }
 
 /*============================================================================
   
-  basicprogram_get_line_offset_iterator
+  basicprogram_find_line
+
+  Find the offset of the first line whose number is n or greater, or
+  the end of the program if there is no such line. Returns TRUE if 
+  the line found is number n. The lines are in order, so there's no
+  need to look further than that.
 
   ==========================================================================*/
-static BOOL basicprogram_get_line_offset_iterator (const BasicProgram *self, 
-              const char *p1, const char *p2, void *user_data)
+static BOOL basicprogram_find_line (const BasicProgram *self, 
+              VARTYPE n, int *offset)
   {
   KLOG_IN
-  BOOL ret = TRUE;
-  self = self;
-  VARTYPE n;
-  if (basicprogram_get_line_number (p1, &n))
+  TokenizerPos p = 0;
+  TokenizerPos end = self->length;
+  if (self->str)
     {
-    if (n == ((IterateLineData*)user_data)->line)
-      {
-      ((IterateLineData*)user_data)->found = TRUE;
-      ((IterateLineData*)user_data)->p1 = p1;
-      ((IterateLineData*)user_data)->p2 = p2;
-      ret = FALSE;
-      }
+    // This is on the path of every GOTO and GOSUB, so a program in
+    //   RAM is walked directly, rather than a byte at a time
+    const uint8_t *s = (const uint8_t *)self->str;
+    while (p < end && (s[p + 1] | (s[p + 2] << 8)) < n)
+      p += s[p];
     }
   else
     {
-    // Skip malformed lines for now
+    while (p < end && basicprogram_line_number (self, p) < n)
+      p += basicprogram_line_length (self, p);
     }
+  *offset = p;
   KLOG_OUT
-  return ret;
+  return (p < end && basicprogram_line_number (self, p) == n);
   }
 
 /*============================================================================
@@ -195,175 +242,92 @@ BOOL basicprogram_get_line_offsets (const BasicProgram *self,
               VARTYPE line, int *begin, int *end)
   {
   KLOG_IN
-  BOOL ret =FALSE;
-  IterateLineData ild;
-  ild.line = line;
-  ild.found = FALSE;
-  basicprogram_iterate_lines (self, 
-           basicprogram_get_line_offset_iterator, &ild);
-  if (ild.found)
+  BOOL ret = FALSE;
+  int b;
+  if (basicprogram_find_line (self, line, &b))
     {
-    *begin = ild.p1 - self->str;
-    *end= ild.p2 - self->str;
+    *begin = b;
+    *end = b + basicprogram_line_length (self, b) - 1;
     ret = TRUE;
     }
-
   KLOG_OUT
   return ret;
   }
 
 /*============================================================================
   
-  basicprogram_delete_range
-
-  Delete n characters starting at b. If n > length, delete from b to end. 
+  basicprogram_resize
 
   ==========================================================================*/
-static void basicprogram_delete_range (BasicProgram *self, int b, int n)
+static BOOL basicprogram_resize (BasicProgram *self, int length)
   {
-  KLOG_IN
-  char *str = self->str;
-  int lself = strlen (str); 
-  if (b + n > lself)
-    basicprogram_delete_range (self, b, lself - n);
-  else
-    {
-    memmove (str + b, str + b + n + 1, lself - (b + n));
-    lself -= n + 1;
-    str[lself] = 0;
-    self->str = realloc (self->str, lself + 1);
-    }
-  KLOG_OUT
+  char *str = HEAP_REALLOC (HEAP_SITE_PROGRAM, self->str, length + 1);
+  if (!str) return FALSE;
+  self->str = str;
+  return TRUE;
   }
 
-
 /*============================================================================
   
-  basicprogram_delete_line
+  basicprogram_delete_range
+
+  Delete n bytes starting at b.
 
   ==========================================================================*/
-BasicProgramResult basicprogram_delete_line (BasicProgram *self, VARTYPE n)
+static void basicprogram_delete_range (BasicProgram *self, int b, int n)
   {
   KLOG_IN
-  BasicProgramResult ret;
-  int b, e;
-  if (basicprogram_get_line_offsets (self, 
-              n, &b, &e))
-    {
-    basicprogram_delete_range (self, b, e - b);
-    ret = BASICPROGRAM_LINE_DELETED;
-    }
-  else
-    ret = BASICPROGRAM_BAD_LINE_NUMBER;
-
+  // Move the final zero as well
+  memmove (self->str + b, self->str + b + n, self->length - (b + n) + 1);
+  self->length -= n;
+  basicprogram_resize (self, self->length);
   KLOG_OUT
-  return ret;
   }
 
 /*============================================================================
   
-  basicprogram_get_text_offset_of_line 
- 
-  Gets the start of the line text, after the number. 
-  If there line contains only a number, or not even a number, returns -1. 
-  Note that a line can legitimately consist only of whitespace.
+  basicprogram_insert_at_pos
 
   ==========================================================================*/
-static int basicprogram_get_text_offset_of_line (const char *line)
+static BOOL basicprogram_insert_at_pos (BasicProgram *self, int pos, 
+              const char *data, int n)
   {
   KLOG_IN
-  int ret = -1;
-
-  const char *sp = strchr (line, ' '); 
-  if (!sp)
-    sp = strchr (line, '\t'); 
-  if (sp)
+  BOOL ret = FALSE;
+  if (basicprogram_resize (self, self->length + n))
     {
-    return sp - line;
+    memmove (self->str + pos + n, self->str + pos, self->length - pos + 1);
+    memcpy (self->str + pos, data, n);
+    self->length += n;
+    ret = TRUE;
     }
-
   KLOG_OUT
   return ret;
   }
 
 /*============================================================================
   
-  basicprogram_get_next_line_up_iterator
+  basicprogram_delete_line
 
   ==========================================================================*/
-static BOOL basicprogram_get_next_line_up_iterator (const BasicProgram *self, 
-              const char *p1, const char *p2, void *user_data)
+BasicProgramResult basicprogram_delete_line (BasicProgram *self, VARTYPE n)
   {
   KLOG_IN
-  BOOL ret = TRUE;
-  p2 = p2;
-  self = self;
-  VARTYPE n;
-  if (basicprogram_get_line_number (p1, &n))
+  BasicProgramResult ret;
+  int b;
+  if (basicprogram_find_line (self, n, &b))
     {
-    if (n > ((IterateLineData *)user_data)->line)
-      {
-      ((IterateLineData *)user_data)->line2 = n;
-      ((IterateLineData *)user_data)->found = TRUE;
-      ret = FALSE;
-      }
+    basicprogram_delete_range (self, b, 
+      basicprogram_line_length (self, b));
+    ret = BASICPROGRAM_LINE_DELETED;
     }
   else
-    {
-    // Skip malformed lines for now
-    }
-  KLOG_OUT
-  return ret;
-  }
-
-
-/*============================================================================
-  
-  basicprogram_get_next_line_up
+    ret = BASICPROGRAM_BAD_LINE_NUMBER;
 
-  ==========================================================================*/
-static BOOL basicprogram_get_next_line_up (const BasicProgram *self, 
-         VARTYPE n, VARTYPE *next)
-  {
-  KLOG_IN
-  BOOL ret = FALSE;
-  IterateLineData ild;
-  ild.found = FALSE;
-  ild.line = n;
-  basicprogram_iterate_lines (self, 
-           basicprogram_get_next_line_up_iterator, &ild);
-  if (ild.found)
-    {
-    *next = ild.line2;
-    ret = TRUE;
-    }
   KLOG_OUT
   return ret;
   }
 
-/*============================================================================
-  
-  basicprogram_insert_at_pos
-
-  ==========================================================================*/
-void basicprogram_insert_at_pos (BasicProgram *self, int pos, const char *line)
-  {
-  KLOG_IN
-  int lself = strlen (self->str); 
-  int lline = strlen (line); 
-  // If pos is too large, insert at end
-  if (pos > lself - 1) pos = lself - 1;
-  if (pos < 0) pos = 0;
-
-  int newsize = lself + lline + 1;
-
-  self->str = realloc (self->str, newsize + 1);
-
-  memmove (self->str + pos + lline, self->str + pos, lself - pos + 1);
-  memmove (self->str + pos, line, lline);
-  KLOG_OUT
-  }
-
 /*============================================================================
   
   basicprogram_insert_line
@@ -375,54 +339,41 @@ BasicProgramResult basicprogram_insert_line (BasicProgram *self,
   KLOG_IN
   BasicProgramResult ret = BASICPROGRAM_UNCHANGED;
   VARTYPE n;
-  if (basicprogram_get_line_number (line, &n))
+  uint8_t digits;
+  if (numparse_prefix (line, &digits, &n) && digits > 0
+       && n <= BASICPROGRAM_MAX_LINE_NUMBER)
     {
-    VARTYPE to = basicprogram_get_text_offset_of_line (line);
-    if (to < 0) 
+    const char *text = line + digits;
+    if (*text == 0) 
       {
+      // Just a number -- delete the line
       ret = basicprogram_delete_line (self, n);
       }
     else
       {
-      // This is a line to insert, but does the line already exist?
-      int dummy;
-      if (basicprogram_get_line_offsets (self, 
-              n, &dummy, &dummy))
+      // Build the stored form of the line: header, crunched text, \n
+      char buff [BASICPROGRAM_HEADER_SIZE + MAX_LINE + 1];
+      tokenizer_crunch (text, buff + BASICPROGRAM_HEADER_SIZE);
+      int len = BASICPROGRAM_HEADER_SIZE 
+        + strlen (buff + BASICPROGRAM_HEADER_SIZE) + 1;
+      buff[0] = len;
+      buff[1] = n & 0xFF;
+      buff[2] = n >> 8;
+      buff[len - 1] = '\n';
+
+      int b;
+      if (basicprogram_find_line (self, n, &b))
         {
-        // The line exists. So delete it can call this method again
-        basicprogram_delete_line (self, n);
-        basicprogram_insert_line (self, line);
+        basicprogram_delete_range (self, b, 
+          basicprogram_line_length (self, b));
 	ret = BASICPROGRAM_LINE_REPLACED;
         }
+      else if (b == self->length)
+	ret = BASICPROGRAM_LINE_APPENDED;
       else
-        {
-        // We're adding a line that doesn't already exist
-        VARTYPE n2;
-        if (basicprogram_get_next_line_up (self, n, &n2))
-          {
-          int b, e;
-          if (basicprogram_get_line_offsets (self, 
-              n2, &b, &e))
-            {
-            basicprogram_insert_at_pos (self, b, "\n");
-            basicprogram_insert_at_pos (self, b, line);
-	    ret = BASICPROGRAM_LINE_INSERTED;
-            }
-          else
-            {
-            // Should never happen
-            }
-          }
-        else
-          {
-	  // Not existing line than which this is a lower number --
-	  //   insert at end (ie., between the last char and the zero)
-	  int l = strlen (self->str);
-          basicprogram_insert_at_pos (self, l, "\n");
-          basicprogram_insert_at_pos (self, l, line);
-	  ret = BASICPROGRAM_LINE_APPENDED;
-          }
-        }
+	ret = BASICPROGRAM_LINE_INSERTED;
+      if (!basicprogram_insert_at_pos (self, b, buff, len))
+        ret = BASICPROGRAM_NOMEM;
       }
     }
   else
@@ -438,8 +389,9 @@ BasicProgramResult basicprogram_insert_line (BasicProgram *self,
   ==========================================================================*/
 void basicprogram_clear (BasicProgram *self)
   {
-  free (self->str);
-  self->str = strdup ("");
+  HEAP_FREE (HEAP_SITE_PROGRAM, self->str);
+  self->str = HEAP_STRDUP (HEAP_SITE_PROGRAM, "");
+  self->length = 0;
   }
 
 /*============================================================================
@@ -449,7 +401,7 @@ void basicprogram_clear (BasicProgram *self)
   ==========================================================================*/
 int basicprogram_get_length (const BasicProgram *self)
   {
-  return strlen (self->str);
+  return self->length;
   }
 
 /*============================================================================
@@ -461,19 +413,13 @@ BOOL basicprogram_add_char (BasicProgram *self, char c)
   {
   BOOL ret = FALSE;
 
-  int cur_len = strlen (self->str); // UGH! We should store the length
-  self->str = realloc (self->str, cur_len + 2);
-  if (self->str)
+  if (basicprogram_resize (self, self->length + 1))
     {
-    self->str [cur_len] = c;
-    cur_len++;
-    self->str [cur_len] = 0;
+    self->str [self->length] = c;
+    self->length++;
+    self->str [self->length] = 0;
     ret = TRUE;
     }
-  else
-    self->str = strdup (""); // Don't leave the memory in a mess
   return ret;
   }
 
-
-
@@ -12,14 +12,24 @@
 
 #include "defs.h"
 #include "config.h"
+#include "tokenizer.h"
 
 struct BasicProgram;
 #ifndef __cplusplus
 typedef struct _BasicProgram BasicProgram;
 #endif
 
+// Each line is stored with a header: the length of the whole line in
+//   bytes, including the header and the final \n, and then the line
+//   number, low byte first. The text that follows has been crunched by
+//   tokenizer_crunch(). A line has to fit in 255 bytes, which it always
+//   will, since it can't be longer than MAX_LINE when it is typed. 
+#define BASICPROGRAM_HEADER_SIZE 3
+#define BASICPROGRAM_MAX_LINE_NUMBER 65535
+
 typedef BOOL (*BasicProgramIterator)(const BasicProgram *self, 
-                 const char *b, const char *e, void *user_data);
+                 VARTYPE line, TokenizerPos b, TokenizerPos e, 
+                 void *user_data);
 
 typedef enum 
   {
@@ -33,7 +43,9 @@ typedef enum
   // A line was replaced with a new one
   BASICPROGRAM_LINE_REPLACED,
   BASICPROGRAM_LINE_APPENDED,
-  BASICPROGRAM_LINE_INSERTED
+  BASICPROGRAM_LINE_INSERTED,
+  // There was no memory to add the line
+  BASICPROGRAM_NOMEM
   } BasicProgramResult;
 
 BEGIN_DECLS
@@ -41,53 +53,66 @@ BEGIN_DECLS
 /** Create an empty program (that is, a zero-length string). */
 extern BasicProgram *basicprogram_new_empty (void);
 
-/** Create the object from an existing basic program text, which is
+/** Create a program that is not held in RAM, but read in place with
+ *   the fetch function. The program must already be in the stored form,
+ *   and it can't be changed. */
+extern BasicProgram *basicprogram_new_fetch (TokenizerFetch fetch,
+                        const void *source, int length);
+
+/** Replace the program with one made from the text, which is
  *   assumed to be well-formed -- that is, lines starting with numbers, 
- *   separated by \n characters. DO NOT USE EXCEPT FOR TESTING!*/
+ *   separated by \n characters. Each line is stored as if it had
+ *   been typed. DO NOT USE EXCEPT FOR TESTING!*/
 extern void          basicprogram_set_program (BasicProgram *self, 
                         const char *prog);
 
 extern void          basicprogram_destroy (BasicProgram *self);
 
+/** Get the stored program. This is not really a C string any more, 
+ *   since the line headers can contain zeros, but it does have a zero
+ *   after the last line. Returns NULL if the program is not in RAM. */
 extern const char   *basicprogram_c_str (const BasicProgram *self);
 
+/** Get the function that reads a program that is not in RAM, and the
+ *   source to pass to it. Returns NULL for a program in RAM, for which
+ *   basicprogram_c_str() gives the stored program. */
+extern TokenizerFetch basicprogram_get_fetch (const BasicProgram *self,
+                        const void **source);
+
 /** Find the offsets of the line in the program. The offsets are of the 
- *   first character of the line, and the terminating \n character. The
+ *   line header, and the terminating \n character. The
  *   line number is not the simple count, but the number stored in the
  *   line itself, which can be completely different. */
 extern BOOL          basicprogram_get_line_offsets (const BasicProgram *self, 
                        VARTYPE line, int *begin, int *end);
 
-/** Parse the initial line number from the line. If the line doesn't start
- *   with a number, return FALSE. The line is expected to be 
- *   separated from the rest of the line by some whitespace. */
-extern BOOL          basicprogram_get_line_number (const char *line, 
-                        VARTYPE *n);
-
 /** Delete the line numbered n. If there is no such line, do nothing. */
 extern BasicProgramResult basicprogram_delete_line (BasicProgram *self, 
                         VARTYPE n);
 
 
 /** Insert a line at the appropriate point in the program. The line is
- *    assumed to start with a valid line number. If this number matches
- *    an existing line, the old line is replaced. If the line consists
- *    only of a line number and not text, the line is deleted completely.
- *    The line should _not_ end with a CR -- one will be inserted.
+ *    text as typed, and is assumed to start with a valid line number,
+ *    which must not be more than BASICPROGRAM_MAX_LINE_NUMBER. If this 
+ *    number matches an existing line, the old line is replaced. If the 
+ *    line consists only of a line number and not text, the line is 
+ *    deleted completely. The line should _not_ end with a CR.
  *    "insert_line" is an unhelpful, name, but 
  *    "insert_delete_replace_append_or_insert_line" would be unweildy.*/
 extern BasicProgramResult basicprogram_insert_line (BasicProgram *self, 
                        const char *line);
 
 /** Iterate lines in the program, calling the specified iterator for each
- *    line. The iterator receives the offsets of each line. */
+ *    line. The iterator receives the line number, and the offsets of 
+ *    the header of the line and of its final \n. */
 extern void          basicprogram_iterate_lines (const BasicProgram *self, 
                          BasicProgramIterator bpi, void *user_data);
 
 /** Clear the whole program without warning. */
 extern void          basicprogram_clear (BasicProgram *self);
 
-/** Get the length of the program, not including any final zeros. */
+/** Get the length of the program in bytes, not including the final 
+ *   zero. */
 extern int           basicprogram_get_length (const BasicProgram *self);
 
 /** Add a single character to the end of the program. We need to be able
@@ -0,0 +1,9 @@
+10 rem Tight arithmetic loop
+20 a = 0
+30 b = 7
+40 for i = 1 to 100000
+50 a = (a + i * b - 3) % 10007
+60 next
+70 print a
+run
+quit
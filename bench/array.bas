@@ -0,0 +1,14 @@
+10 rem Array indexing: fill an array, then sum it repeatedly
+20 dim a(999)
+30 for i = 0 to 999
+40 a(i) = i % 97
+50 next
+60 s = 0
+70 for r = 1 to 20
+80 for i = 0 to 999
+90 s = s + a(i)
+100 next
+110 next
+120 print s
+run
+quit
@@ -0,0 +1,199 @@
+/*===========================================================================
+
+  pmbasic
+
+  benchrun.c
+
+  Benchmark harness for the Linux build. Runs each workload (a file of
+  program lines and commands that is fed to PMBASIC's standard input)
+  a number of times, and writes one line of CSV for each:
+
+    workload,runs,median_ms,p99_ms,statements,statements_per_sec,peak_rss_kb
+
+  The statement count comes from the JSON that PMBASIC writes when
+  started with --stats-json. The program's own output is discarded, and
+  PMBASIC runs with --virtual-time, so DELAY does not distort the times.
+
+  Usage: benchrun [-n runs] pmbasic workload.bas...
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+/*===========================================================================
+  benchrun_now
+===========================================================================*/
+static double benchrun_now (void)
+  {
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+  }
+
+/*===========================================================================
+  benchrun_once
+  Run the interpreter once on the workload. Returns 0 on success, and
+    sets the elapsed time, statement count, and peak RSS.
+===========================================================================*/
+static int benchrun_once (const char *pmbasic, const char *workload,
+         double *msec, unsigned long *statements, long *rss_kb)
+  {
+  int in = open (workload, O_RDONLY);
+  if (in < 0)
+    {
+    perror (workload);
+    return -1;
+    }
+
+  int fds[2];
+  if (pipe (fds) != 0)
+    {
+    perror ("pipe");
+    close (in);
+    return -1;
+    }
+
+  double start = benchrun_now ();
+  pid_t pid = fork ();
+  if (pid == 0)
+    {
+    int null = open ("/dev/null", O_WRONLY);
+    dup2 (in, 0);
+    dup2 (null, 1);
+    dup2 (fds[1], 2);
+    close (fds[0]);
+    execl (pmbasic, pmbasic, "--virtual-time", "--stats-json",
+      (char *)NULL);
+    _exit (127);
+    }
+  close (in);
+  close (fds[1]);
+  if (pid < 0)
+    {
+    perror ("fork");
+    close (fds[0]);
+    return -1;
+    }
+
+  char buff [4096];
+  int total = 0;
+  int n;
+  while ((n = read (fds[0], buff + total, sizeof (buff) - 1 - total)) > 0)
+    total += n;
+  buff[total] = 0;
+  close (fds[0]);
+
+  int status;
+  struct rusage ru;
+  wait4 (pid, &status, 0, &ru);
+  *msec = benchrun_now () - start;
+  *rss_kb = ru.ru_maxrss;
+
+  if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+    {
+    fprintf (stderr, "%s: interpreter failed\n", workload);
+    return -1;
+    }
+
+  *statements = 0;
+  const char *p = strstr (buff, "\"total_statements\":");
+  if (p)
+    *statements = strtoul (p + strlen ("\"total_statements\":"), NULL, 10);
+  return 0;
+  }
+
+/*===========================================================================
+  benchrun_compare
+===========================================================================*/
+static int benchrun_compare (const void *p1, const void *p2)
+  {
+  double d1 = *(const double *)p1;
+  double d2 = *(const double *)p2;
+  return d1 < d2 ? -1 : d1 > d2 ? 1 : 0;
+  }
+
+/*===========================================================================
+  benchrun_percentile
+  Nearest-rank percentile of a sorted array
+===========================================================================*/
+static double benchrun_percentile (const double *sorted, int n, int pc)
+  {
+  int rank = (pc * n + 99) / 100;
+  if (rank < 1) rank = 1;
+  return sorted[rank - 1];
+  }
+
+/*===========================================================================
+  main
+===========================================================================*/
+int main (int argc, char **argv)
+  {
+  int runs = 10;
+  int opt;
+  while ((opt = getopt (argc, argv, "n:")) != -1)
+    {
+    if (opt == 'n')
+      runs = atoi (optarg);
+    else
+      {
+      fprintf (stderr, "Usage: %s [-n runs] pmbasic workload...\n",
+        argv[0]);
+      return 1;
+      }
+    }
+  if (runs < 1 || argc - optind < 2)
+    {
+    fprintf (stderr, "Usage: %s [-n runs] pmbasic workload...\n", argv[0]);
+    return 1;
+    }
+
+  const char *pmbasic = argv[optind];
+  double *times = malloc (runs * sizeof (double));
+  int ret = 0;
+
+  printf ("workload,runs,median_ms,p99_ms,statements,"
+          "statements_per_sec,peak_rss_kb\n");
+  for (int w = optind + 1; w < argc; w++)
+    {
+    unsigned long statements = 0;
+    long peak_rss = 0;
+    int ok = 1;
+    for (int i = 0; i < runs && ok; i++)
+      {
+      long rss = 0;
+      if (benchrun_once (pmbasic, argv[w], &times[i], &statements,
+            &rss) != 0)
+        ok = 0;
+      if (rss > peak_rss) peak_rss = rss;
+      }
+    if (!ok)
+      {
+      ret = 1;
+      continue;
+      }
+
+    qsort (times, runs, sizeof (double), benchrun_compare);
+    double median = runs % 2 ? times[runs / 2]
+      : (times[runs / 2 - 1] + times[runs / 2]) / 2;
+    double p99 = benchrun_percentile (times, runs, 99);
+    printf ("%s,%d,%.3f,%.3f,%lu,%.0f,%ld\n", argv[w], runs, median, p99,
+      statements, median > 0 ? statements / (median / 1000.0) : 0.0,
+      peak_rss);
+    fflush (stdout);
+    }
+
+  free (times);
+  return ret;
+  }
+
@@ -0,0 +1,6 @@
+10 rem A loop body packed onto one line with ':'
+20 s = 0 : t = 0
+30 for i = 1 to 60000 : s = s + i % 7 : t = t + s % 3 : next
+40 print s, t
+run
+quit
@@ -0,0 +1,12 @@
+10 rem Scale and clamp readings with DEF FN functions
+20 def fn scale(r) = r * 500 / 1023
+30 def fn clamp(v, lo, hi) = min(max(v, lo), hi)
+40 s = 0
+50 for j = 1 to 20
+60 for i = 0 to 1023
+70 s = s + fn clamp(fn scale(i), 100, 400)
+80 next
+90 next
+100 print s
+run
+quit
@@ -0,0 +1,255 @@
+10 rem Large program, jumping back and forth between its ends
+20 c = 0
+30 goto 5000
+40 goto 5000
+100 rem padding padding padding padding padding padding
+120 rem padding padding padding padding padding padding
+140 rem padding padding padding padding padding padding
+160 rem padding padding padding padding padding padding
+180 rem padding padding padding padding padding padding
+200 rem padding padding padding padding padding padding
+220 rem padding padding padding padding padding padding
+240 rem padding padding padding padding padding padding
+260 rem padding padding padding padding padding padding
+280 rem padding padding padding padding padding padding
+300 rem padding padding padding padding padding padding
+320 rem padding padding padding padding padding padding
+340 rem padding padding padding padding padding padding
+360 rem padding padding padding padding padding padding
+380 rem padding padding padding padding padding padding
+400 rem padding padding padding padding padding padding
+420 rem padding padding padding padding padding padding
+440 rem padding padding padding padding padding padding
+460 rem padding padding padding padding padding padding
+480 rem padding padding padding padding padding padding
+500 rem padding padding padding padding padding padding
+520 rem padding padding padding padding padding padding
+540 rem padding padding padding padding padding padding
+560 rem padding padding padding padding padding padding
+580 rem padding padding padding padding padding padding
+600 rem padding padding padding padding padding padding
+620 rem padding padding padding padding padding padding
+640 rem padding padding padding padding padding padding
+660 rem padding padding padding padding padding padding
+680 rem padding padding padding padding padding padding
+700 rem padding padding padding padding padding padding
+720 rem padding padding padding padding padding padding
+740 rem padding padding padding padding padding padding
+760 rem padding padding padding padding padding padding
+780 rem padding padding padding padding padding padding
+800 rem padding padding padding padding padding padding
+820 rem padding padding padding padding padding padding
+840 rem padding padding padding padding padding padding
+860 rem padding padding padding padding padding padding
+880 rem padding padding padding padding padding padding
+900 rem padding padding padding padding padding padding
+920 rem padding padding padding padding padding padding
+940 rem padding padding padding padding padding padding
+960 rem padding padding padding padding padding padding
+980 rem padding padding padding padding padding padding
+1000 rem padding padding padding padding padding padding
+1020 rem padding padding padding padding padding padding
+1040 rem padding padding padding padding padding padding
+1060 rem padding padding padding padding padding padding
+1080 rem padding padding padding padding padding padding
+1100 rem padding padding padding padding padding padding
+1120 rem padding padding padding padding padding padding
+1140 rem padding padding padding padding padding padding
+1160 rem padding padding padding padding padding padding
+1180 rem padding padding padding padding padding padding
+1200 rem padding padding padding padding padding padding
+1220 rem padding padding padding padding padding padding
+1240 rem padding padding padding padding padding padding
+1260 rem padding padding padding padding padding padding
+1280 rem padding padding padding padding padding padding
+1300 rem padding padding padding padding padding padding
+1320 rem padding padding padding padding padding padding
+1340 rem padding padding padding padding padding padding
+1360 rem padding padding padding padding padding padding
+1380 rem padding padding padding padding padding padding
+1400 rem padding padding padding padding padding padding
+1420 rem padding padding padding padding padding padding
+1440 rem padding padding padding padding padding padding
+1460 rem padding padding padding padding padding padding
+1480 rem padding padding padding padding padding padding
+1500 rem padding padding padding padding padding padding
+1520 rem padding padding padding padding padding padding
+1540 rem padding padding padding padding padding padding
+1560 rem padding padding padding padding padding padding
+1580 rem padding padding padding padding padding padding
+1600 rem padding padding padding padding padding padding
+1620 rem padding padding padding padding padding padding
+1640 rem padding padding padding padding padding padding
+1660 rem padding padding padding padding padding padding
+1680 rem padding padding padding padding padding padding
+1700 rem padding padding padding padding padding padding
+1720 rem padding padding padding padding padding padding
+1740 rem padding padding padding padding padding padding
+1760 rem padding padding padding padding padding padding
+1780 rem padding padding padding padding padding padding
+1800 rem padding padding padding padding padding padding
+1820 rem padding padding padding padding padding padding
+1840 rem padding padding padding padding padding padding
+1860 rem padding padding padding padding padding padding
+1880 rem padding padding padding padding padding padding
+1900 rem padding padding padding padding padding padding
+1920 rem padding padding padding padding padding padding
+1940 rem padding padding padding padding padding padding
+1960 rem padding padding padding padding padding padding
+1980 rem padding padding padding padding padding padding
+2000 rem padding padding padding padding padding padding
+2020 rem padding padding padding padding padding padding
+2040 rem padding padding padding padding padding padding
+2060 rem padding padding padding padding padding padding
+2080 rem padding padding padding padding padding padding
+2100 rem padding padding padding padding padding padding
+2120 rem padding padding padding padding padding padding
+2140 rem padding padding padding padding padding padding
+2160 rem padding padding padding padding padding padding
+2180 rem padding padding padding padding padding padding
+2200 rem padding padding padding padding padding padding
+2220 rem padding padding padding padding padding padding
+2240 rem padding padding padding padding padding padding
+2260 rem padding padding padding padding padding padding
+2280 rem padding padding padding padding padding padding
+2300 rem padding padding padding padding padding padding
+2320 rem padding padding padding padding padding padding
+2340 rem padding padding padding padding padding padding
+2360 rem padding padding padding padding padding padding
+2380 rem padding padding padding padding padding padding
+2400 rem padding padding padding padding padding padding
+2420 rem padding padding padding padding padding padding
+2440 rem padding padding padding padding padding padding
+2460 rem padding padding padding padding padding padding
+2480 rem padding padding padding padding padding padding
+2500 rem padding padding padding padding padding padding
+2520 rem padding padding padding padding padding padding
+2540 rem padding padding padding padding padding padding
+2560 rem padding padding padding padding padding padding
+2580 rem padding padding padding padding padding padding
+2600 rem padding padding padding padding padding padding
+2620 rem padding padding padding padding padding padding
+2640 rem padding padding padding padding padding padding
+2660 rem padding padding padding padding padding padding
+2680 rem padding padding padding padding padding padding
+2700 rem padding padding padding padding padding padding
+2720 rem padding padding padding padding padding padding
+2740 rem padding padding padding padding padding padding
+2760 rem padding padding padding padding padding padding
+2780 rem padding padding padding padding padding padding
+2800 rem padding padding padding padding padding padding
+2820 rem padding padding padding padding padding padding
+2840 rem padding padding padding padding padding padding
+2860 rem padding padding padding padding padding padding
+2880 rem padding padding padding padding padding padding
+2900 rem padding padding padding padding padding padding
+2920 rem padding padding padding padding padding padding
+2940 rem padding padding padding padding padding padding
+2960 rem padding padding padding padding padding padding
+2980 rem padding padding padding padding padding padding
+3000 rem padding padding padding padding padding padding
+3020 rem padding padding padding padding padding padding
+3040 rem padding padding padding padding padding padding
+3060 rem padding padding padding padding padding padding
+3080 rem padding padding padding padding padding padding
+3100 rem padding padding padding padding padding padding
+3120 rem padding padding padding padding padding padding
+3140 rem padding padding padding padding padding padding
+3160 rem padding padding padding padding padding padding
+3180 rem padding padding padding padding padding padding
+3200 rem padding padding padding padding padding padding
+3220 rem padding padding padding padding padding padding
+3240 rem padding padding padding padding padding padding
+3260 rem padding padding padding padding padding padding
+3280 rem padding padding padding padding padding padding
+3300 rem padding padding padding padding padding padding
+3320 rem padding padding padding padding padding padding
+3340 rem padding padding padding padding padding padding
+3360 rem padding padding padding padding padding padding
+3380 rem padding padding padding padding padding padding
+3400 rem padding padding padding padding padding padding
+3420 rem padding padding padding padding padding padding
+3440 rem padding padding padding padding padding padding
+3460 rem padding padding padding padding padding padding
+3480 rem padding padding padding padding padding padding
+3500 rem padding padding padding padding padding padding
+3520 rem padding padding padding padding padding padding
+3540 rem padding padding padding padding padding padding
+3560 rem padding padding padding padding padding padding
+3580 rem padding padding padding padding padding padding
+3600 rem padding padding padding padding padding padding
+3620 rem padding padding padding padding padding padding
+3640 rem padding padding padding padding padding padding
+3660 rem padding padding padding padding padding padding
+3680 rem padding padding padding padding padding padding
+3700 rem padding padding padding padding padding padding
+3720 rem padding padding padding padding padding padding
+3740 rem padding padding padding padding padding padding
+3760 rem padding padding padding padding padding padding
+3780 rem padding padding padding padding padding padding
+3800 rem padding padding padding padding padding padding
+3820 rem padding padding padding padding padding padding
+3840 rem padding padding padding padding padding padding
+3860 rem padding padding padding padding padding padding
+3880 rem padding padding padding padding padding padding
+3900 rem padding padding padding padding padding padding
+3920 rem padding padding padding padding padding padding
+3940 rem padding padding padding padding padding padding
+3960 rem padding padding padding padding padding padding
+3980 rem padding padding padding padding padding padding
+4000 rem padding padding padding padding padding padding
+4020 rem padding padding padding padding padding padding
+4040 rem padding padding padding padding padding padding
+4060 rem padding padding padding padding padding padding
+4080 rem padding padding padding padding padding padding
+4100 rem padding padding padding padding padding padding
+4120 rem padding padding padding padding padding padding
+4140 rem padding padding padding padding padding padding
+4160 rem padding padding padding padding padding padding
+4180 rem padding padding padding padding padding padding
+4200 rem padding padding padding padding padding padding
+4220 rem padding padding padding padding padding padding
+4240 rem padding padding padding padding padding padding
+4260 rem padding padding padding padding padding padding
+4280 rem padding padding padding padding padding padding
+4300 rem padding padding padding padding padding padding
+4320 rem padding padding padding padding padding padding
+4340 rem padding padding padding padding padding padding
+4360 rem padding padding padding padding padding padding
+4380 rem padding padding padding padding padding padding
+4400 rem padding padding padding padding padding padding
+4420 rem padding padding padding padding padding padding
+4440 rem padding padding padding padding padding padding
+4460 rem padding padding padding padding padding padding
+4480 rem padding padding padding padding padding padding
+4500 rem padding padding padding padding padding padding
+4520 rem padding padding padding padding padding padding
+4540 rem padding padding padding padding padding padding
+4560 rem padding padding padding padding padding padding
+4580 rem padding padding padding padding padding padding
+4600 rem padding padding padding padding padding padding
+4620 rem padding padding padding padding padding padding
+4640 rem padding padding padding padding padding padding
+4660 rem padding padding padding padding padding padding
+4680 rem padding padding padding padding padding padding
+4700 rem padding padding padding padding padding padding
+4720 rem padding padding padding padding padding padding
+4740 rem padding padding padding padding padding padding
+4760 rem padding padding padding padding padding padding
+4780 rem padding padding padding padding padding padding
+4800 rem padding padding padding padding padding padding
+4820 rem padding padding padding padding padding padding
+4840 rem padding padding padding padding padding padding
+4860 rem padding padding padding padding padding padding
+4880 rem padding padding padding padding padding padding
+4900 rem padding padding padding padding padding padding
+4920 rem padding padding padding padding padding padding
+4940 rem padding padding padding padding padding padding
+4960 rem padding padding padding padding padding padding
+4980 rem padding padding padding padding padding padding
+5000 c = c + 1
+5010 if c < 10000 then goto 40
+5020 print c
+5030 end
+run
+quit
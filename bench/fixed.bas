@@ -0,0 +1,32 @@
+fixed on
+10 rem Fixed-point arithmetic: a small Mandelbrot set, and square roots
+20 for y = 0 to 11
+30 ci = y / 5 - 1.1
+40 l$ = ""
+50 for x = 0 to 39
+60 cr = x / 16 - 2
+70 zr = 0
+80 zi = 0
+90 n = 0
+100 t = zr * zr - zi * zi + cr
+110 zi = 2 * zr * zi + ci
+120 zr = t
+130 n = n + 1
+140 if n < 30 then if zr * zr + zi * zi < 4 then goto 100
+145 c$ = "."
+150 if n = 30 then c$ = "#"
+155 l$ = l$ + c$
+160 next
+170 print l$
+180 next
+190 s = 0
+200 for i = 1 to 500
+210 r = i / 2
+220 for k = 1 to 8
+230 r = (r + i / r) / 2
+240 next
+250 s = s + r
+260 next
+270 print s, r * r
+run
+quit
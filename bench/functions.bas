@@ -0,0 +1,12 @@
+10 rem Intrinsic functions, each of which would otherwise be several
+20 rem statements of IF and arithmetic
+30 x = RND(-1)
+40 s = 0
+50 for i = 1 to 5000
+60 r = RND(2001) - 1000
+70 s = s + ABS(r) + MIN(r, 0) - MAX(r, 0) + SGN(r)
+80 s = s + SQR(i * 97) + SHR(SHL(i, 3), 5)
+90 next
+100 print s
+run
+quit
@@ -0,0 +1,15 @@
+10 rem GOSUB-heavy recursion, as deep as the GOSUB stack allows
+20 c = 0
+30 for i = 1 to 5000
+40 d = 0
+50 gosub 100
+60 next
+70 print c
+80 end
+100 d = d + 1
+110 c = c + 1
+120 if d < 8 then gosub 100
+130 d = d - 1
+140 return
+run
+quit
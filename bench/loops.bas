@@ -0,0 +1,14 @@
+10 rem WHILE and REPEAT loops, each ending where it began
+20 s = 0
+30 i = 0
+40 while i < 1000
+50 j = 0
+60 repeat
+70 s = s + j
+80 j = j + 1
+90 until j = 100
+100 i = i + 1
+110 wend
+120 print s
+run
+quit
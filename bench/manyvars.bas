@@ -0,0 +1,48 @@
+10 rem Many variables: lookups have to scan the whole table
+20 v0 = 0
+30 v1 = 1
+40 v2 = 2
+50 v3 = 3
+60 v4 = 4
+70 v5 = 5
+80 v6 = 6
+90 v7 = 7
+100 v8 = 8
+110 v9 = 9
+120 v10 = 10
+130 v11 = 11
+140 v12 = 12
+150 v13 = 13
+160 v14 = 14
+170 v15 = 15
+180 v16 = 16
+190 v17 = 17
+200 v18 = 18
+210 v19 = 19
+220 v20 = 20
+230 v21 = 21
+240 v22 = 22
+250 v23 = 23
+260 v24 = 24
+270 v25 = 25
+280 v26 = 26
+290 v27 = 27
+300 v28 = 28
+310 v29 = 29
+320 v30 = 30
+330 v31 = 31
+340 v32 = 32
+350 v33 = 33
+360 v34 = 34
+370 v35 = 35
+380 v36 = 36
+390 v37 = 37
+400 v38 = 38
+410 v39 = 39
+420 for i = 1 to 5000
+430 s = v0 + v13 + v26 + v39
+440 v39 = v38 + v1 - s
+450 next
+460 print s, v39
+run
+quit
@@ -0,0 +1,16 @@
+10 rem Whole-array arithmetic with MAT, on the same data as array.bas
+20 dim a(999), b(999)
+30 for i = 0 to 999
+40 a(i) = i % 97
+50 next
+60 s = 0
+70 for r = 1 to 2000
+80 mat b = a * 3
+90 mat b = b - a
+100 mat sum t = b
+110 s = s + t
+120 next
+130 mat dot p = a, b
+140 print s, p
+run
+quit
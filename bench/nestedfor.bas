@@ -0,0 +1,12 @@
+10 rem Nested FOR loops
+20 n = 0
+30 for i = 1 to 40
+40 for j = 1 to 40
+50 for k = 1 to 40
+60 n = n + 1
+70 next
+80 next
+90 next
+100 print n
+run
+quit
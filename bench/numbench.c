@@ -0,0 +1,192 @@
+/*===========================================================================
+
+  pmbasic
+
+  numbench.c
+
+  Microbenchmark for numparse. Converts a set of decimal numbers of
+  each length from 1 to 10 digits, and a set of hex numbers, many
+  times, first with numparse and then with the digit-at-a-time loop
+  that the tokenizer used before, and writes one line of CSV for each:
+
+    parser,digits,ns_per_number
+
+  The results of both are checked against each other, except where
+  numparse reports an overflow that the old loop did not notice.
+
+  Usage: numbench [-n iterations]
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "../config.h"
+#include "../defs.h"
+#include "../numparse.h"
+#include "../numwidth.h"
+
+// Numbers of each length
+#define NUMBENCH_COUNT 1024
+
+static char numbers [NUMBENCH_COUNT][16];
+
+// Stops the compiler from optimizing the conversions away
+static volatile VARTYPE sink;
+
+// numparse uses fixedpoint.c for fractions, which outputs through the
+//   interface, but nothing here is ever output that way
+void interface_output_number (VARTYPE i) { (void)i; }
+void interface_output_string (const char *s) { (void)s; }
+
+/*===========================================================================
+  numbench_now
+===========================================================================*/
+static double numbench_now (void)
+  {
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000.0 + ts.tv_nsec;
+  }
+
+/*===========================================================================
+  numbench_old_decimal
+  The conversion from tokenizer_slurp_decimal, which does not check
+    for overflow
+===========================================================================*/
+static VARTYPE numbench_old_decimal (const char *s, uint8_t len)
+  {
+  VARTYPE total = 0;
+  for (uint8_t i = 0; i < len; i++)
+    total = 10 * total + (s[i] - '0');
+  return total;
+  }
+
+/*===========================================================================
+  numbench_old_hex
+  The conversion from tokenizer_slurp_hex
+===========================================================================*/
+static VARTYPE numbench_old_hex (const char *s, uint8_t len)
+  {
+  VARTYPE total = 0;
+  for (uint8_t i = 0; i < len; i++)
+    {
+    char c = s[i];
+    int d;
+    if (c >= '0' && c <= '9') d = c - '0';
+    else if (c >= 'A' && c <= 'F') d = c - 'A' + 10;
+    else d = c - 'a' + 10;
+    total = 16 * total + d;
+    }
+  return total;
+  }
+
+/*===========================================================================
+  numbench_fill
+===========================================================================*/
+static void numbench_fill (uint8_t len, BOOL hex)
+  {
+  static const char digits[] = "0123456789abcdefABCDEF";
+  for (int i = 0; i < NUMBENCH_COUNT; i++)
+    {
+    for (uint8_t j = 0; j < len; j++)
+      numbers[i][j] = hex ? digits [rand () % 22]
+        : digits [(j == 0 ? 1 : 0) + rand () % (j == 0 ? 9 : 10)];
+    numbers[i][len] = 0;
+    }
+  }
+
+/*===========================================================================
+  numbench_check
+===========================================================================*/
+static int numbench_check (uint8_t len, BOOL hex)
+  {
+  for (int i = 0; i < NUMBENCH_COUNT; i++)
+    {
+    VARTYPE v;
+    BOOL ok = hex ? numparse_hex (numbers[i], len, &v)
+      : numparse_decimal (numbers[i], len, &v);
+    // The old loops relied on VARTYPE being the width of arithmetic
+    VARTYPE old = NUMWIDTH_WRAP (hex ? numbench_old_hex (numbers[i], len)
+      : numbench_old_decimal (numbers[i], len));
+    if (ok && v != old)
+      {
+      fprintf (stderr, "Mismatch on %s: %ld, %ld\n", numbers[i],
+        (long)v, (long)old);
+      return 1;
+      }
+    }
+  return 0;
+  }
+
+/*===========================================================================
+  numbench_run
+===========================================================================*/
+static void numbench_run (uint8_t len, BOOL hex, int iterations)
+  {
+  double start = numbench_now ();
+  for (int n = 0; n < iterations; n++)
+    for (int i = 0; i < NUMBENCH_COUNT; i++)
+      {
+      VARTYPE v = 0;
+      if (hex)
+        numparse_hex (numbers[i], len, &v);
+      else
+        numparse_decimal (numbers[i], len, &v);
+      sink = v;
+      }
+  double t_new = numbench_now () - start;
+
+  start = numbench_now ();
+  for (int n = 0; n < iterations; n++)
+    for (int i = 0; i < NUMBENCH_COUNT; i++)
+      sink = hex ? numbench_old_hex (numbers[i], len)
+        : numbench_old_decimal (numbers[i], len);
+  double t_old = numbench_now () - start;
+
+  double total = (double)iterations * NUMBENCH_COUNT;
+  printf ("numparse%s,%d,%.2f\n", hex ? "_hex" : "", len, t_new / total);
+  printf ("old%s,%d,%.2f\n", hex ? "_hex" : "", len, t_old / total);
+  }
+
+/*===========================================================================
+  main
+===========================================================================*/
+int main (int argc, char **argv)
+  {
+  int iterations = 2000;
+  int opt;
+  while ((opt = getopt (argc, argv, "n:")) != -1)
+    {
+    if (opt == 'n')
+      iterations = atoi (optarg);
+    else
+      {
+      fprintf (stderr, "Usage: %s [-n iterations]\n", argv[0]);
+      return 1;
+      }
+    }
+
+  srand (1);
+  int ret = 0;
+  printf ("parser,digits,ns_per_number\n");
+  for (uint8_t len = 1; len <= 10; len++)
+    {
+    numbench_fill (len, FALSE);
+    ret |= numbench_check (len, FALSE);
+    numbench_run (len, FALSE, iterations);
+    }
+  for (uint8_t len = 2; len <= 8; len += 2)
+    {
+    numbench_fill (len, TRUE);
+    ret |= numbench_check (len, TRUE);
+    numbench_run (len, TRUE, iterations);
+    }
+  return ret;
+  }
+
@@ -0,0 +1,7 @@
+10 rem PRINT-heavy output
+20 for i = 1 to 20000
+30 print "Line ", i, " value ", i * 3;
+40 print " done"
+50 next
+run
+quit
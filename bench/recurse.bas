@@ -0,0 +1,11 @@
+10 rem Recursive Fibonacci, with the argument and a partial sum in locals
+20 gosub 100(22)
+30 print f
+40 end
+100 local n, t
+110 if n < 2 then f = n : return
+120 gosub 100(n - 1) : t = f
+130 gosub 100(n - 2) : f = f + t
+140 return
+run
+quit
@@ -0,0 +1,13 @@
+10 rem String handling: build a long string, and take it apart again
+20 s$ = ""
+30 for i = 1 to 2000
+40 s$ = s$ + "ab"
+50 next
+60 n = 0
+70 for i = 1 to 2000
+80 if mid$(s$, i * 2 - 1, 2) = "ab" then n = n + 1
+90 t$ = left$(s$, i % 50) + right$(s$, 3)
+100 next
+110 print len(s$), n, len(t$)
+run
+quit
@@ -0,0 +1,270 @@
+/*===========================================================================
+
+  pmbasic
+
+  callstack.c
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#include <string.h>
+#include <stdint.h>
+#include "config.h"
+#include "defs.h"
+#include "callstack.h"
+#include "heap.h"
+#include "errcodes.h"
+
+/*===========================================================================
+  CallFrame
+  first_slot is the first of the frame's local slots; the slots from
+  there up to the top of the slot stack belong to it. The first
+  num_args of them start out as arguments, and num_bound of those have
+  been bound to variables by LOCAL so far.
+===========================================================================*/
+typedef struct _CallFrame
+  {
+  TokenizerPos pos;
+  VARTYPE line;
+  int first_slot;
+  uint8_t num_args;
+  uint8_t num_bound;
+  } CallFrame;
+
+/*===========================================================================
+  LocalSlot
+  An argument that hasn't been bound yet has no variable, and is just
+  dropped on RETURN.
+===========================================================================*/
+typedef struct _LocalSlot
+  {
+  Variable *var;
+  VARTYPE value;
+  } LocalSlot;
+
+/*===========================================================================
+  CallStack
+===========================================================================*/
+struct _CallStack
+  {
+  CallFrame *frames;
+  int num_frames;
+  int max_frames;
+  LocalSlot *slots;
+  int num_slots;
+  int max_slots;
+  };
+
+// The number of frames and slots to allocate at first, when the stacks
+//   can grow
+#define CALLSTACK_INITIAL 16
+
+#ifdef STATIC_POOLS
+static CallStack callstack_pool;
+static CallFrame callstack_pool_frames [MAX_GOSUB_STACK_DEPTH];
+static LocalSlot callstack_pool_slots [POOL_LOCALS];
+#endif
+
+/*===========================================================================
+  callstack_new
+===========================================================================*/
+CallStack *callstack_new (void)
+  {
+#ifdef STATIC_POOLS
+  CallStack *self = &callstack_pool;
+  self->frames = callstack_pool_frames;
+  self->max_frames = MAX_GOSUB_STACK_DEPTH;
+  self->slots = callstack_pool_slots;
+  self->max_slots = POOL_LOCALS;
+#else
+  CallStack *self = HEAP_MALLOC (HEAP_SITE_CALLSTACK, sizeof (CallStack));
+  if (!self) return NULL;
+  self->frames = NULL;
+  self->max_frames = 0;
+  self->slots = NULL;
+  self->max_slots = 0;
+#endif
+  callstack_clear (self);
+  return self;
+  }
+
+/*===========================================================================
+  callstack_destroy
+===========================================================================*/
+void callstack_destroy (CallStack *self)
+  {
+#ifndef STATIC_POOLS
+  HEAP_FREE (HEAP_SITE_CALLSTACK, self->frames);
+  HEAP_FREE (HEAP_SITE_CALLSTACK, self->slots);
+  HEAP_FREE (HEAP_SITE_CALLSTACK, self);
+#else
+  (void)self;
+#endif
+  }
+
+/*===========================================================================
+  callstack_clear
+===========================================================================*/
+void callstack_clear (CallStack *self)
+  {
+  self->num_frames = 0;
+  self->num_slots = 0;
+  }
+
+#ifndef STATIC_POOLS
+/*===========================================================================
+  callstack_grow
+  Move a stack to a new block of twice the size. The old block is only
+    freed once the stack points to the new one, because the sampling
+    profiler's signal handler can read the frames at any time.
+===========================================================================*/
+static void *callstack_grow (void *p, int *max, size_t size)
+  {
+  int new_max = *max ? 2 * *max : CALLSTACK_INITIAL;
+  void *q = HEAP_MALLOC (HEAP_SITE_CALLSTACK, new_max * size);
+  if (!q) return NULL;
+  if (p) memcpy (q, p, *max * size);
+  *max = new_max;
+  return q;
+  }
+#endif
+
+/*===========================================================================
+  callstack_new_slot
+  Returns NULL if there is no room for another slot
+===========================================================================*/
+static LocalSlot *callstack_new_slot (CallStack *self, uint8_t *error)
+  {
+  if (self->num_slots == self->max_slots)
+    {
+#ifndef STATIC_POOLS
+    LocalSlot *old = self->slots;
+    LocalSlot *slots = callstack_grow (old, &self->max_slots,
+      sizeof (LocalSlot));
+    if (slots)
+      {
+      self->slots = slots;
+      HEAP_FREE (HEAP_SITE_CALLSTACK, old);
+      }
+    else
+#endif
+      {
+      *error = BASIC_ERR_NOMEM;
+      return NULL;
+      }
+    }
+  return &self->slots [self->num_slots++];
+  }
+
+/*===========================================================================
+  callstack_push_arg
+===========================================================================*/
+void callstack_push_arg (CallStack *self, VARTYPE value, uint8_t *error)
+  {
+  LocalSlot *slot = callstack_new_slot (self, error);
+  if (!slot) return;
+  slot->var = NULL;
+  slot->value = value;
+  }
+
+/*===========================================================================
+  callstack_push
+===========================================================================*/
+void callstack_push (CallStack *self, TokenizerPos pos, VARTYPE line,
+        uint8_t num_args, uint8_t *error)
+  {
+  if (self->num_frames >= MAX_GOSUB_STACK_DEPTH)
+    {
+    *error = BASIC_ERR_GOSUB_DEPTH;
+    return;
+    }
+#ifndef STATIC_POOLS
+  if (self->num_frames == self->max_frames)
+    {
+    CallFrame *old = self->frames;
+    CallFrame *frames = callstack_grow (old, &self->max_frames,
+      sizeof (CallFrame));
+    if (!frames)
+      {
+      *error = BASIC_ERR_NOMEM;
+      return;
+      }
+    self->frames = frames;
+    HEAP_FREE (HEAP_SITE_CALLSTACK, old);
+    }
+#endif
+  CallFrame *frame = &self->frames [self->num_frames];
+  frame->pos = pos;
+  frame->line = line;
+  frame->first_slot = self->num_slots - num_args;
+  frame->num_args = num_args;
+  frame->num_bound = 0;
+  self->num_frames++;
+  }
+
+/*===========================================================================
+  callstack_pop
+  The slots are restored from the top down, so that if a variable was
+    made local twice by the same frame, it gets back its oldest value.
+===========================================================================*/
+BOOL callstack_pop (CallStack *self, TokenizerPos *pos, VARTYPE *line)
+  {
+  if (self->num_frames == 0) return FALSE;
+  const CallFrame *frame = &self->frames [self->num_frames - 1];
+  while (self->num_slots > frame->first_slot)
+    {
+    const LocalSlot *slot = &self->slots [--self->num_slots];
+    if (slot->var) variable_set_number (slot->var, slot->value);
+    }
+  *pos = frame->pos;
+  *line = frame->line;
+  self->num_frames--;
+  return TRUE;
+  }
+
+/*===========================================================================
+  callstack_local
+===========================================================================*/
+void callstack_local (CallStack *self, Variable *var, uint8_t *error)
+  {
+  if (self->num_frames == 0)
+    {
+    *error = BASIC_ERR_LOCAL_WITHOUT_GOSUB;
+    return;
+    }
+  CallFrame *frame = &self->frames [self->num_frames - 1];
+  LocalSlot *slot;
+  VARTYPE value = 0;
+  if (frame->num_bound < frame->num_args)
+    {
+    slot = &self->slots [frame->first_slot + frame->num_bound];
+    frame->num_bound++;
+    value = slot->value;
+    }
+  else
+    {
+    slot = callstack_new_slot (self, error);
+    if (!slot) return;
+    }
+  slot->var = var;
+  slot->value = variable_get_number (var);
+  variable_set_number (var, value);
+  }
+
+/*===========================================================================
+  callstack_depth
+===========================================================================*/
+int callstack_depth (const CallStack *self)
+  {
+  return self->num_frames;
+  }
+
+/*===========================================================================
+  callstack_line
+===========================================================================*/
+VARTYPE callstack_line (const CallStack *self, int i)
+  {
+  return self->frames [i].line;
+  }
+
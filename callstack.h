@@ -0,0 +1,78 @@
+/*===========================================================================
+
+  pmbasic
+
+  callstack.h
+
+  The GOSUB stack. Each GOSUB pushes a frame, which records where to
+  return to, and owns a run of local slots on a second stack, just above
+  the slots of the frame that called it. The slots start out holding
+  the arguments of the GOSUB, if it has any. LOCAL binds each slot in
+  turn to a variable: the variable's value is saved in the slot, and
+  the variable is given the argument -- or zero, once the arguments have
+  run out, when a new slot is added. RETURN puts the saved values back,
+  so a subroutine can call itself, and the caller's variables are as
+  they were when it returns.
+
+  A local is still an ordinary variable, looked up by name like any
+  other; only LOCAL and RETURN touch the slots. So a program that
+  doesn't use LOCAL runs exactly as fast as before.
+
+  Without STATIC_POOLS, both stacks start small and double when they
+  are full. The depth is still limited, by MAX_GOSUB_STACK_DEPTH, so
+  that a subroutine that calls itself for ever stops with an error,
+  rather than using up all the memory. With STATIC_POOLS, they are
+  fixed-size pools of MAX_GOSUB_STACK_DEPTH frames and POOL_LOCALS
+  slots.
+
+  Some of these functions return error codes -- these values must be
+  one of the constants defined in errcodes.h.
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#pragma once
+
+#include "defs.h"
+#include "config.h"
+#include "tokenizer.h"
+#include "variable.h"
+
+struct _CallStack;
+typedef struct _CallStack CallStack;
+
+BEGIN_DECLS
+
+extern CallStack *callstack_new (void);
+extern void       callstack_destroy (CallStack *self);
+
+/** Remove all the frames, without restoring any locals. */
+extern void       callstack_clear (CallStack *self);
+
+/** Add an argument for the next frame. The arguments are pushed before
+ *    the frame that they belong to. */
+extern void       callstack_push_arg (CallStack *self, VARTYPE value,
+                    uint8_t *error);
+
+/** Push a frame, which returns to pos, in the line numbered line. The
+ *    last num_args arguments pushed belong to it. */
+extern void       callstack_push (CallStack *self, TokenizerPos pos,
+                    VARTYPE line, uint8_t num_args, uint8_t *error);
+
+/** Pop a frame, restoring the values of its locals, and get where it
+ *    returns to. Returns FALSE if there are no frames. */
+extern BOOL       callstack_pop (CallStack *self, TokenizerPos *pos,
+                    VARTYPE *line);
+
+/** Make a numeric variable local to the top frame. */
+extern void       callstack_local (CallStack *self, Variable *var,
+                    uint8_t *error);
+
+extern int        callstack_depth (const CallStack *self);
+
+/** Get the line that frame i, counting from the bottom, returns to. */
+extern VARTYPE    callstack_line (const CallStack *self, int i);
+
+END_DECLS
+
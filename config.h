@@ -12,54 +12,213 @@
 #pragma once
 
 #include <stdint.h>
+#include <inttypes.h>
 
-// Define whether to build a version with int or long arithmetic.
+// Width in bits of the numbers that PMBASIC stores: 16, 32, or 64. 
 // This decision affects all data stored and managed by PMBASIC,
 //   although it doesn't affect the program size particularly.
-// Bear in mind that on AVRs, "long" is generally only 32-bit
-//#define VARTYPE int16_t
-#define VARTYPE int32_t 
-
-// Define the decimal indicator supplied to the printf() function,
-//   which depends on the integer size
-#if VARIABLE_TYPE == long
-#define PRINTF_DEC "%ld"
+// Bear in mind that on AVRs, 64-bit arithmetic is slow, and needs a
+//   lot of code
+#ifdef ARDUINO
+#define VARTYPE_BITS 32
 #else
-#define PRINTF_DEC "%d"
+#define VARTYPE_BITS 64
 #endif
 
-// Longest number that can be parsed. This needs to be related to
-//   the data type used to represent numbers in binary (e.g., int)
-#if VARIABLE_TYPE == long
+// Define RUNTIME_WIDTH to choose the width of arithmetic -- 16, 32, or 64
+//   bits -- when PMBASIC is run, rather than when it is built. Numbers
+//   are stored in 64 bits, whatever the width, so VARTYPE_BITS must be
+//   64. See numwidth.h
+#ifndef ARDUINO
+#define RUNTIME_WIDTH
+#endif
+
+// The width of arithmetic when PMBASIC starts, with RUNTIME_WIDTH
+#define DEFAULT_WIDTH 32
+
+#if defined (RUNTIME_WIDTH) && VARTYPE_BITS != 64
+#error RUNTIME_WIDTH needs VARTYPE_BITS to be 64
+#endif
+
+// Define FIXED_POINT to build the fixed-point mode (FIXED ON), in which
+//   numbers have 16 bits after the binary point. The whole part gets
+//   what is left of the width, so this needs a width of at least 32.
+//   See fixedpoint.h
+#define FIXED_POINT
+
+#if defined (FIXED_POINT) && VARTYPE_BITS < 32
+#error FIXED_POINT needs VARTYPE_BITS to be at least 32
+#endif
+
+// VARTYPE is the type of the numbers, and UVARTYPE the unsigned type of
+//   the same size, which is used to detect and wrap overflow. 
+//   PRINTF_DEC is the decimal indicator supplied to the printf() function
+//   for a VARTYPE, and MAX_NUMBER is the number of digits in the largest
+//   decimal number that it can hold.
+#if VARTYPE_BITS == 16
+#define VARTYPE int16_t 
+#define UVARTYPE uint16_t
+#define PRINTF_DEC "%" PRId16
+#define MAX_NUMBER 5
+#elif VARTYPE_BITS == 32
+#define VARTYPE int32_t 
+#define UVARTYPE uint32_t
+#define PRINTF_DEC "%" PRId32
 #define MAX_NUMBER 10
 #else
-#define MAX_NUMBER 5
+#define VARTYPE int64_t 
+#define UVARTYPE uint64_t
+#define PRINTF_DEC "%" PRId64
+#define MAX_NUMBER 19
 #endif
 
 // Longest hex number that can be parsed. This needs to be related to
 //   the data type used to represent numbers in binary (e.g., int)
-#if VARIABLE_TYPE == long
-#define MAX_HEX_NUMBER 8
-#else
-#define MAX_HEX_NUMBER 4
-#endif
+#define MAX_HEX_NUMBER (VARTYPE_BITS / 4)
 
 // Longest line in total that we will handle. This includes the number,
 // whitespace, and and terminating '\n', but not any terminating zero
 #define MAX_LINE 81
 
-// Largest number of nested GOSUB operations
+// Largest number of nested GOSUB operations. On Linux the GOSUB stack
+//   grows as it is needed, and this is just there to stop a subroutine
+//   that calls itself for ever
+#ifdef ARDUINO
 #define MAX_GOSUB_STACK_DEPTH 10
+#else
+#define MAX_GOSUB_STACK_DEPTH 10000
+#endif
+
+// Longest value that a string variable can hold, in bytes. This can't
+//   be more than about 65000, because lengths are stored in 16 bits
+#ifdef ARDUINO
+#define MAX_STRINGLEN 80
+#else
+#define MAX_STRINGLEN 16384
+#endif
 
-// Largest character string that can be stored, in bytes (including
-//  terminating zero)
-#define MAX_STRINGLEN 41
+// Largest number of string values that can be held at once while an
+//   expression is evaluated. Each nested LEFT$, etc., needs one or two
+#define MAX_STRING_TEMPS 8
 
-// Largest depth of nested FOR loops
+// Largest depth of nested loops: FOR, WHILE, and REPEAT loops all
+//   count towards this
 #define MAX_FOR_STACK_DEPTH 4
 
 #define TOKEN_MAX_LENGTH 40
 
+// Define PROFILER to build the PROFILE command, which runs the program
+//   and reports execution counts and times for each line. The counters
+//   need RAM for every program line, so this is not something we can
+//   afford on the Arduino by default. 
+#ifndef ARDUINO
+#define PROFILER
+#endif
+
+// Define STATS to count the statements executed of each kind, and the
+//   arithmetic operators evaluated. The counts are shown by INFO STATS. 
+#ifndef ARDUINO
+#define STATS
+#endif
+
+// Define SAMPLER to build the sampling profiler, which uses a SIGPROF
+//   timer to record where the program is at regular intervals. This
+//   only makes sense on Linux.
+#ifndef ARDUINO
+#define SAMPLER
+#endif
+
 
 
 
+
+// Define HEAPSTATS to keep track of heap memory: the number of bytes
+//   in use, the peak, and how much each part of the program has 
+//   allocated. The figures are shown by INFO. Block sizes come from the
+//   C library, so this costs no RAM per block, but the per-site 
+//   counters take about 60 bytes, which matters on small AVRs. 
+#define HEAPSTATS
+
+// Define STATIC_POOLS to run programs without using the heap at all. 
+//   Variables, the line index, and the tokenizer come from fixed-size
+//   static pools, so the heap cannot fragment however many times a 
+//   program is run. A program that needs more than the pools provide
+//   stops with "Out of memory". Only the program text itself is still
+//   kept on the heap, because it has to grow and shrink as it is edited.
+#ifdef ARDUINO
+#define STATIC_POOLS
+#endif
+
+// Number of program lines that the static line index can hold
+#define POOL_LINES 48
+
+// Number of WHILE statements that the static loop index can hold
+#define POOL_LOOPS 8
+
+// Number of DEF FN functions that the static function index can hold
+#define POOL_FUNCTIONS 4
+
+// Largest number of FN calls that can be nested inside each other, in
+//   the arguments or the bodies of other functions. Each one uses the
+//   C stack, which is very small on the Arduino
+#ifdef ARDUINO
+#define MAX_FN_DEPTH 4
+#else
+#define MAX_FN_DEPTH 64
+#endif
+
+// Number of GOSUB arguments and LOCAL variables that can be held at
+//   once, by all the subroutines that are running, if STATIC_POOLS is
+//   defined. Without STATIC_POOLS, the space grows as it is needed
+#ifdef ARDUINO
+#define POOL_LOCALS 8
+#else
+#define POOL_LOCALS 1024
+#endif
+
+// Size in bytes of the arena that variables are allocated from. Each
+//   variable takes its name, plus a terminating zero, plus a VARTYPE,
+//   rounded up to a multiple of the size of a VARTYPE. With STATIC_POOLS
+//   there is only one arena; otherwise more are allocated as needed.
+#ifdef ARDUINO
+#define VARIABLE_ARENA_SIZE 160
+#else
+#define VARIABLE_ARENA_SIZE 1024
+#endif
+
+// Size in bytes of the static pool that arrays are allocated from, if
+//   STATIC_POOLS is defined. Each array takes its elements, plus its
+//   name and a few bytes of housekeeping. Without STATIC_POOLS, each 
+//   array is allocated separately on the heap.
+#ifdef ARDUINO
+#define POOL_ARRAYS 128
+#else
+#define POOL_ARRAYS 4096
+#endif
+
+// Size in bytes of the string heap, which holds the values of all
+//   string variables. Each value takes its text, rounded up to a 
+//   multiple of the size of a pointer, plus a 4-byte (Arduino) or 16-byte
+//   header. With STATIC_POOLS this is a fixed-size static pool; otherwise
+//   the heap starts at this size, and doubles when it is full.
+#ifdef ARDUINO
+#define POOL_STRINGS 256
+#else
+#define POOL_STRINGS 4096
+#endif
+
+// Longest variable name, not including the terminating zero. The names
+//   of FOR loop variables are stored in fixed-size buffers of this size,
+//   as are all variable names if STATIC_POOLS is defined.
+#ifdef ARDUINO
+#define MAX_VARIABLE_NAME 8
+#else
+#define MAX_VARIABLE_NAME TOKEN_MAX_LENGTH
+#endif
+
+// Size of the simulated EEPROM on Linux, which is kept in a file. The
+//   Pro Micro's own EEPROM is 1kB.
+#ifndef ARDUINO
+#define EEPROM_SIZE 1024
+#define EEPROM_DEFAULT_FILE "pmbasic.eeprom"
+#endif
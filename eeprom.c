@@ -0,0 +1,174 @@
+/*===========================================================================
+
+  pmbasic
+
+  eeprom.c
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#include <stdlib.h>
+#include "config.h"
+#include "defs.h"
+#include "eeprom.h"
+#include "interface.h"
+#include "strings.h"
+#include "errcodes.h"
+
+// The signature, and two bytes of length
+#define EEPROM_HEADER_SIZE 5
+
+// The length of the program being read by eeprom_fetch()
+static int eeprom_program_length = 0;
+
+/*===========================================================================
+  eeprom_signature
+  Returns the third byte of the signature, 'C' or 'B', or zero if there
+    is no saved program.
+===========================================================================*/
+static char eeprom_signature (void)
+  {
+  if (interface_eeprom_read (0) == 'P' && interface_eeprom_read (1) == 'M')
+    {
+    char c = interface_eeprom_read (2);
+    if (c == 'C' || c == 'B') return c;
+    }
+  strings_output_string (BASIC_ERR_NO_STORED_PROGRAM);
+  interface_output_endl();
+  return 0;
+  }
+
+/*===========================================================================
+  eeprom_get_length
+===========================================================================*/
+static int eeprom_get_length (void)
+  {
+  int length = interface_eeprom_read (3) | (interface_eeprom_read (4) << 8);
+  int max = interface_eeprom_size () - EEPROM_HEADER_SIZE;
+  return length > max ? max : length;
+  }
+
+/*===========================================================================
+  eeprom_save
+===========================================================================*/
+BOOL eeprom_save (const BasicProgram *bp)
+  {
+  BOOL ret = FALSE;
+
+  int prog_len = basicprogram_get_length (bp); 
+  if (prog_len <= interface_eeprom_size () - EEPROM_HEADER_SIZE)
+    {
+    interface_eeprom_write (0, 'P');
+    interface_eeprom_write (1, 'M');
+    interface_eeprom_write (2, 'C');
+    interface_eeprom_write (3, prog_len & 0xFF);
+    interface_eeprom_write (4, prog_len >> 8);
+    const char *ptr = basicprogram_c_str (bp);
+    for (int i = 0; i < prog_len; i++) 
+      interface_eeprom_write (i + EEPROM_HEADER_SIZE, ptr[i]);
+    ret = TRUE;
+    }
+  else
+    {
+    strings_output_string (BASIC_ERR_PROGRAM_TOO_LARGE);
+    interface_output_endl();
+    }
+
+  return ret;
+  }
+
+/*===========================================================================
+  eeprom_load_text
+  Load a program saved by an older version, as "PMB" followed by
+    the text of the program and a zero. 
+===========================================================================*/
+static BOOL eeprom_load_text (BasicProgram *bp)
+  {
+  char line [MAX_LINE];
+  int n = 0;
+  int i = 3;
+  int size = interface_eeprom_size ();
+  char c;
+  do
+    {
+    c = interface_eeprom_read (i++);
+    if (c == '\n' || c == 0)
+      {
+      line[n] = 0;
+      if (n && basicprogram_insert_line (bp, line) == BASICPROGRAM_NOMEM)
+        return FALSE;
+      n = 0;
+      }
+    else if (n < MAX_LINE - 1)
+      line[n++] = c;
+    } while (c && i < size);
+  return TRUE;
+  }
+
+/*===========================================================================
+  eeprom_load
+===========================================================================*/
+BOOL eeprom_load (BasicProgram *bp)
+  {
+  BOOL ret = FALSE;
+  char sig = eeprom_signature ();
+  if (sig)
+    {
+    basicprogram_clear (bp);
+    BOOL ok = TRUE;
+    if (sig == 'C')
+      {
+      int prog_len = eeprom_get_length ();
+      for (int i = 0; i < prog_len && ok; i++)
+        ok = basicprogram_add_char (bp, 
+          interface_eeprom_read (i + EEPROM_HEADER_SIZE));
+      }
+    else
+      ok = eeprom_load_text (bp);
+    if (ok)
+      ret = TRUE;
+    else
+      {
+      basicprogram_clear (bp);
+      strings_output_string (BASIC_ERR_NOMEM);
+      interface_output_endl();
+      }
+    }
+  return ret;
+  }
+
+/*===========================================================================
+  eeprom_fetch
+===========================================================================*/
+static char eeprom_fetch (const void *source, TokenizerPos pos)
+  {
+  (void)source;
+  if (pos >= (TokenizerPos)eeprom_program_length) return 0;
+  return interface_eeprom_read (pos + EEPROM_HEADER_SIZE);
+  }
+
+/*===========================================================================
+  eeprom_program_new
+===========================================================================*/
+BasicProgram *eeprom_program_new (void)
+  {
+  char sig = eeprom_signature ();
+  if (sig == 0) return NULL;
+  if (sig != 'C')
+    {
+    // A text program has to be loaded, to be converted to tokens
+    strings_output_string (BASIC_ERR_NO_STORED_PROGRAM);
+    interface_output_endl();
+    return NULL;
+    }
+  eeprom_program_length = eeprom_get_length ();
+  BasicProgram *bp = basicprogram_new_fetch (eeprom_fetch, NULL, 
+    eeprom_program_length);
+  if (!bp)
+    {
+    strings_output_string (BASIC_ERR_NOMEM);
+    interface_output_endl();
+    }
+  return bp;
+  }
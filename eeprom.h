@@ -0,0 +1,39 @@
+/*===========================================================================
+
+  pmbasic
+
+  eeprom.h
+
+  Saving the program to EEPROM, loading it back, and running it straight
+  from EEPROM without loading it. The EEPROM holds "PMC", the length of
+  the program, low byte first, and then the program exactly as it is
+  stored in memory. The EEPROM itself is reached through the 
+  interface_eeprom functions; on Linux it is simulated with a file.
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#pragma once
+
+#include "defs.h"
+#include "config.h"
+#include "basicprogram.h"
+
+BEGIN_DECLS
+
+/** Save the program, reporting an error if it will not fit. */
+extern BOOL          eeprom_save (const BasicProgram *bp);
+
+/** Replace the program with the one saved in EEPROM. Programs saved 
+ *    by older versions, as text after "PMB", are read a line at a time
+ *    as if they had been typed. */
+extern BOOL          eeprom_load (BasicProgram *bp);
+
+/** Create a program that is read in place from EEPROM, so that it can
+ *    be run without taking up any RAM. It must be destroyed with 
+ *    basicprogram_destroy(). Returns NULL, having reported the error, if
+ *    there is no saved program. */
+extern BasicProgram *eeprom_program_new (void);
+
+END_DECLS
@@ -42,6 +42,24 @@
 #define BASIC_ERR_EXPECTED_COMMA       26
 #define BASIC_ERR_NO_STORED_PROGRAM    27
 #define BASIC_ERR_PROGRAM_TOO_LARGE    28
+#define BASIC_ERR_NAME_TOO_LONG        29
+#define BASIC_ERR_BAD_SUBSCRIPT        30
+#define BASIC_ERR_ARRAY_DEFINED        31
+#define BASIC_ERR_UNDEFINED_ARRAY      32
+#define BASIC_ERR_ARRAY_SIZE           33
+#define BASIC_ERR_TYPE_MISMATCH        34
+#define BASIC_ERR_STRING_TOO_LONG      35
+#define BASIC_ERR_STRING_COMPLEX       36
+#define BASIC_ERR_BAD_WIDTH            37
+#define BASIC_ERR_FIXED_WIDTH          38
+#define BASIC_ERR_BAD_ARGUMENT         39
+#define BASIC_ERR_WEND_WITHOUT_WHILE   40
+#define BASIC_ERR_WHILE_WITHOUT_WEND   41
+#define BASIC_ERR_UNTIL_WITHOUT_REPEAT 42
+#define BASIC_ERR_LOCAL_WITHOUT_GOSUB  43
+#define BASIC_ERR_UNDEFINED_FN         44
+#define BASIC_ERR_FN_DEFINED           45
+#define BASIC_ERR_FN_DEPTH             46
 
 
 
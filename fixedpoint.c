@@ -0,0 +1,222 @@
+/*===========================================================================
+
+  pmbasic
+
+  fixedpoint.c
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#include <stdint.h>
+#include "config.h"
+#include "defs.h"
+#include "fixedpoint.h"
+#include "numwidth.h"
+#include "interface.h"
+
+#ifdef FIXED_POINT
+
+BOOL fixedpoint_on = FALSE;
+
+// Half of 1/65536th, for rounding
+#define FIXEDPOINT_HALF ((UVARTYPE)1 << (FIXEDPOINT_BITS - 1))
+
+// The 128-bit type is only used for the products and quotients of
+//   numbers that are wider than 32 bits
+#if VARTYPE_BITS == 64 && defined (__SIZEOF_INT128__)
+#define FIXEDPOINT_INT128
+#endif
+
+/*===========================================================================
+  fixedpoint_magnitude
+===========================================================================*/
+static UVARTYPE fixedpoint_magnitude (VARTYPE n)
+  {
+  return n < 0 ? 0 - (UVARTYPE)n : (UVARTYPE)n;
+  }
+
+/*===========================================================================
+  fixedpoint_set
+===========================================================================*/
+BOOL fixedpoint_set (BOOL on)
+  {
+  if (on && NUMWIDTH_BITS < 32) return FALSE;
+  fixedpoint_on = on;
+  return TRUE;
+  }
+
+#if !defined (FIXEDPOINT_INT128) && (VARTYPE_BITS == 64 || defined (__AVR__))
+/*===========================================================================
+  fixedpoint_umul_parts
+  Multiply two magnitudes, keeping bits 16 and up of the product, from
+    the products of their halves. Only the bits of the full product
+    that can reach the result are worked out: the low half of the low
+    product only matters for rounding, and anything that would end up
+    above the top bit is lost. On the AVR, the compiler turns each of
+    the multiplications into a call to its fast 16x16-bit routine,
+    rather than the general 32x32-bit one.
+===========================================================================*/
+#if VARTYPE_BITS == 64
+typedef uint32_t FixedHalf;
+#else
+typedef uint16_t FixedHalf;
+#endif
+#define FIXEDPOINT_HALF_BITS (VARTYPE_BITS / 2)
+
+static UVARTYPE fixedpoint_umul_parts (UVARTYPE a, UVARTYPE b)
+  {
+  FixedHalf al = (FixedHalf)a;
+  FixedHalf ah = (FixedHalf)(a >> FIXEDPOINT_HALF_BITS);
+  FixedHalf bl = (FixedHalf)b;
+  FixedHalf bh = (FixedHalf)(b >> FIXEDPOINT_HALF_BITS);
+  UVARTYPE low = (UVARTYPE)al * bl;
+  UVARTYPE middle = (UVARTYPE)ah * bl + (UVARTYPE)al * bh;
+  UVARTYPE high = (UVARTYPE)ah * bh;
+  return (high << (VARTYPE_BITS - FIXEDPOINT_BITS))
+    + (middle << (FIXEDPOINT_HALF_BITS - FIXEDPOINT_BITS))
+    + ((low + FIXEDPOINT_HALF) >> FIXEDPOINT_BITS);
+  }
+#endif
+
+/*===========================================================================
+  fixedpoint_mul
+===========================================================================*/
+VARTYPE fixedpoint_mul (VARTYPE a, VARTYPE b)
+  {
+  BOOL negative = (a < 0) != (b < 0);
+  UVARTYPE ua = fixedpoint_magnitude (a);
+  UVARTYPE ub = fixedpoint_magnitude (b);
+  UVARTYPE p;
+#if defined (FIXEDPOINT_INT128)
+  p = (UVARTYPE)(((unsigned __int128)ua * ub + FIXEDPOINT_HALF)
+    >> FIXEDPOINT_BITS);
+#elif VARTYPE_BITS == 32 && !defined (__AVR__)
+  p = (UVARTYPE)(((uint64_t)ua * ub + FIXEDPOINT_HALF) >> FIXEDPOINT_BITS);
+#else
+  p = fixedpoint_umul_parts (ua, ub);
+#endif
+  return NUMWIDTH_WRAP (negative ? 0 - p : p);
+  }
+
+#if !defined (FIXEDPOINT_INT128) && (VARTYPE_BITS == 64 || defined (__AVR__))
+/*===========================================================================
+  fixedpoint_udiv_long
+  Divide two magnitudes, and then carry on for FIXEDPOINT_BITS more
+    bits of quotient, a bit at a time. The remainder is always less
+    than b, but doubling it can overflow; if it does, it is certainly
+    more than b.
+===========================================================================*/
+static UVARTYPE fixedpoint_udiv_long (UVARTYPE a, UVARTYPE b)
+  {
+  UVARTYPE q = a / b;
+  UVARTYPE r = a % b;
+  for (uint8_t i = 0; i < FIXEDPOINT_BITS; i++)
+    {
+    BOOL carry = r >> (VARTYPE_BITS - 1);
+    r <<= 1;
+    q <<= 1;
+    if (carry || r >= b)
+      {
+      r -= b;
+      q |= 1;
+      }
+    }
+  if (r >= b - r) q++;
+  return q;
+  }
+#endif
+
+/*===========================================================================
+  fixedpoint_div
+===========================================================================*/
+VARTYPE fixedpoint_div (VARTYPE a, VARTYPE b)
+  {
+  BOOL negative = (a < 0) != (b < 0);
+  UVARTYPE ua = fixedpoint_magnitude (a);
+  UVARTYPE ub = fixedpoint_magnitude (b);
+  UVARTYPE q;
+#if VARTYPE_BITS == 64
+  if ((ua >> (64 - FIXEDPOINT_BITS)) == 0)
+    {
+    // Always the case at width 32: the dividend fits into 64 bits
+    UVARTYPE n = ua << FIXEDPOINT_BITS;
+    q = n / ub;
+    if (n % ub >= ub - n % ub) q++;
+    }
+  else
+    {
+#if defined (FIXEDPOINT_INT128)
+    unsigned __int128 n = (unsigned __int128)ua << FIXEDPOINT_BITS;
+    UVARTYPE r = (UVARTYPE)(n % ub);
+    q = (UVARTYPE)(n / ub);
+    if (r >= ub - r) q++;
+#else
+    q = fixedpoint_udiv_long (ua, ub);
+#endif
+    }
+#elif !defined (__AVR__)
+  uint64_t n = (uint64_t)ua << FIXEDPOINT_BITS;
+  UVARTYPE r = (UVARTYPE)(n % ub);
+  q = (UVARTYPE)(n / ub);
+  if (r >= ub - r) q++;
+#else
+  q = fixedpoint_udiv_long (ua, ub);
+#endif
+  return NUMWIDTH_WRAP (negative ? 0 - q : q);
+  }
+
+/*===========================================================================
+  fixedpoint_fraction
+  The digits are taken from the last to the first, each time adding the
+    digit and dividing by ten. This is done with 24 bits after the
+    point, so that the errors from dividing don't reach the result,
+    and then rounded to 16.
+===========================================================================*/
+UVARTYPE fixedpoint_fraction (const char *s, uint8_t len)
+  {
+  uint32_t f = 0;
+  while (len > 0)
+    {
+    len--;
+    f = (f + ((uint32_t)(s[len] - '0') << 24)) / 10;
+    }
+  return (f + 128) >> 8;
+  }
+
+/*===========================================================================
+  fixedpoint_output
+  Four decimal places is 10000/65536ths, or 625/4096ths, of the
+    fraction, which doesn't overflow 32 bits
+===========================================================================*/
+void fixedpoint_output (VARTYPE n)
+  {
+  UVARTYPE u = fixedpoint_magnitude (n);
+  UVARTYPE whole = u >> FIXEDPOINT_BITS;
+  uint32_t frac = (uint32_t)(u & ((1L << FIXEDPOINT_BITS) - 1));
+  uint16_t digits = (uint16_t)((frac * 625 + 2048) >> 12);
+  if (digits == 10000)
+    {
+    whole++;
+    digits = 0;
+    }
+  if (n < 0 && (whole || digits)) interface_output_string ("-");
+  interface_output_number ((VARTYPE)whole);
+  if (digits)
+    {
+    char buff[6];
+    buff[0] = '.';
+    for (uint8_t i = 4; i > 0; i--)
+      {
+      buff[i] = '0' + digits % 10;
+      digits /= 10;
+      }
+    uint8_t len = 5;
+    while (buff[len - 1] == '0') len--;
+    buff[len] = 0;
+    interface_output_string (buff);
+    }
+  }
+
+#endif
+
@@ -0,0 +1,86 @@
+/*===========================================================================
+
+  pmbasic
+
+  fixedpoint.h
+
+  Fixed-point arithmetic. In fixed-point mode (FIXED ON), every number
+  is held as a whole number of 1/65536ths: the bottom FIXEDPOINT_BITS
+  bits are the fraction, and the rest of the width (see numwidth.h) is
+  the whole part. So at width 32, numbers run from -32768 to just under
+  32768, in steps of about 0.000015.
+
+  Adding, subtracting, comparing, and taking the remainder work exactly
+  as they do on whole numbers, so only multiplication and division need
+  anything special. Both are rounded to the nearest 1/65536th, and wrap
+  to the width like everything else. The intermediate results need
+  twice the width: on Linux, these are native 64-bit or 128-bit
+  operations; on the AVR, the product is built from 16x16-bit multiplies,
+  and the quotient by long division, to avoid 64-bit arithmetic, which
+  is slow and large there.
+
+  Wherever a whole number is needed -- a line number, a subscript, a
+  pin, a count of characters -- the fraction is discarded, rounding
+  towards minus infinity. Wherever PMBASIC produces a whole number --
+  LEN, MILLIS, the result of a comparison -- it is converted. The
+  FIXEDPOINT_TO_INT and FIXEDPOINT_FROM_INT macros do this, and do
+  nothing at all when fixed-point mode is off, or not built.
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#pragma once
+
+#include "defs.h"
+#include "config.h"
+#include "numwidth.h"
+
+// The number of bits after the binary point. The formatting and
+//   parsing of fractions assume that this is 16
+#define FIXEDPOINT_BITS 16
+
+#ifdef FIXED_POINT
+extern BOOL fixedpoint_on;
+#define FIXEDPOINT_ON fixedpoint_on
+// Room for the point, and the digits of a fraction, in a number that
+//   is typed in
+#define FIXEDPOINT_FRACTION_CHARS 6
+#else
+#define FIXEDPOINT_ON FALSE
+#define FIXEDPOINT_FRACTION_CHARS 0
+#endif
+
+// The number 1, in whatever form numbers have at present
+#define FIXEDPOINT_ONE ((VARTYPE)(FIXEDPOINT_ON ? 1L << FIXEDPOINT_BITS : 1))
+
+#define FIXEDPOINT_FROM_INT(n) (FIXEDPOINT_ON \
+   ? NUMWIDTH_WRAP ((UVARTYPE)(n) << FIXEDPOINT_BITS) : (VARTYPE)(n))
+
+#define FIXEDPOINT_TO_INT(n) (FIXEDPOINT_ON \
+   ? (VARTYPE)(n) >> FIXEDPOINT_BITS : (VARTYPE)(n))
+
+BEGIN_DECLS
+
+/** Turn fixed-point mode on or off. Returns FALSE if it can't be turned
+ *    on, because the width is less than 32 bits. */
+extern BOOL    fixedpoint_set (BOOL on);
+
+/** Multiply two fixed-point numbers, rounding to the nearest. */
+extern VARTYPE fixedpoint_mul (VARTYPE a, VARTYPE b);
+
+/** Divide two fixed-point numbers, rounding to the nearest. b must not
+ *    be zero. */
+extern VARTYPE fixedpoint_div (VARTYPE a, VARTYPE b);
+
+/** Convert the decimal fraction in the len digits at s -- the digits
+ *    after the point -- to 1/65536ths, rounding to the nearest. The
+ *    result may be 65536, if the digits are all nines. */
+extern UVARTYPE fixedpoint_fraction (const char *s, uint8_t len);
+
+/** Output a fixed-point number, with up to four decimal places, and no
+ *    trailing zeros. */
+extern void    fixedpoint_output (VARTYPE n);
+
+END_DECLS
+
@@ -0,0 +1,178 @@
+/*===========================================================================
+
+  pmbasic
+
+  heap.c
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "defs.h"
+#include "heap.h"
+#include "strings.h"
+#include "interface.h"
+
+#ifdef HEAPSTATS
+
+typedef struct _HeapSiteStats
+  {
+  size_t live;     // Bytes currently allocated
+  uint32_t allocs; // Number of allocations ever made
+  } HeapSiteStats;
+
+static HeapSiteStats heap_sites [HEAP_NUM_SITES];
+static size_t heap_live = 0;
+static size_t heap_peak = 0;
+
+/*===========================================================================
+  heap_add
+===========================================================================*/
+static void heap_add (HeapSite site, void *p)
+  {
+  size_t size = interface_heap_block_size (p);
+  heap_sites[site].live += size;
+  heap_sites[site].allocs++;
+  heap_live += size;
+  if (heap_live > heap_peak) heap_peak = heap_live;
+  }
+
+/*===========================================================================
+  heap_remove
+===========================================================================*/
+static void heap_remove (HeapSite site, void *p)
+  {
+  size_t size = interface_heap_block_size (p);
+  heap_sites[site].live -= size;
+  heap_live -= size;
+  }
+
+/*===========================================================================
+  heap_malloc
+===========================================================================*/
+void *heap_malloc (HeapSite site, size_t size)
+  {
+  void *p = malloc (size);
+  if (p) heap_add (site, p);
+  return p;
+  }
+
+/*===========================================================================
+  heap_calloc
+===========================================================================*/
+void *heap_calloc (HeapSite site, size_t n, size_t size)
+  {
+  void *p = calloc (n, size);
+  if (p) heap_add (site, p);
+  return p;
+  }
+
+/*===========================================================================
+  heap_realloc
+===========================================================================*/
+void *heap_realloc (HeapSite site, void *p, size_t size)
+  {
+  size_t old_size = p ? interface_heap_block_size (p) : 0;
+  void *new_p = realloc (p, size);
+  if (new_p)
+    {
+    // Count a reallocation as freeing the old block and allocating
+    //   a new one
+    heap_sites[site].live -= old_size;
+    heap_live -= old_size;
+    heap_add (site, new_p);
+    }
+  return new_p;
+  }
+
+/*===========================================================================
+  heap_strdup
+===========================================================================*/
+char *heap_strdup (HeapSite site, const char *s)
+  {
+  char *p = strdup (s);
+  if (p) heap_add (site, p);
+  return p;
+  }
+
+/*===========================================================================
+  heap_free
+===========================================================================*/
+void heap_free (HeapSite site, void *p)
+  {
+  if (!p) return;
+  heap_remove (site, p);
+  free (p);
+  }
+
+/*===========================================================================
+  heap_get_live
+===========================================================================*/
+size_t heap_get_live (void)
+  {
+  return heap_live;
+  }
+
+/*===========================================================================
+  heap_get_peak
+===========================================================================*/
+size_t heap_get_peak (void)
+  {
+  return heap_peak;
+  }
+
+/*===========================================================================
+  heap_output_bytes
+===========================================================================*/
+static void heap_output_bytes (uint8_t label, uint32_t n)
+  {
+  strings_output_string (label);
+  interface_output_number (n);
+  interface_output_string (" ");
+  strings_output_string (STRING_INDEX_BYTES);
+  interface_output_endl ();
+  }
+
+/*===========================================================================
+  heap_report
+===========================================================================*/
+void heap_report (void)
+  {
+  heap_output_bytes (STRING_INDEX_HEAP_LIVE, heap_live);
+  heap_output_bytes (STRING_INDEX_HEAP_PEAK, heap_peak);
+
+  // Fragmentation is the proportion of the heap that is in free
+  //   blocks below the top, which can only be reused by allocations
+  //   that happen to fit into them
+  uint32_t heap_size = 0;
+  uint32_t free_list = 0;
+  interface_heap_layout (&heap_size, &free_list);
+  heap_output_bytes (STRING_INDEX_HEAP_FREE_LIST, free_list);
+  strings_output_string (STRING_INDEX_HEAP_FRAG);
+  interface_output_number (heap_size ?
+    (VARTYPE)((free_list * 100) / heap_size) : 0);
+  interface_output_string ("%");
+  interface_output_endl ();
+
+  for (uint8_t i = 0; i < HEAP_NUM_SITES; i++)
+    {
+    if (heap_sites[i].allocs == 0) continue;
+    interface_output_string ("  ");
+    strings_output_string (STRINGS_FIRST_HEAP_SITE + i);
+    interface_output_string (" ");
+    interface_output_number (heap_sites[i].live);
+    interface_output_string (" ");
+    strings_output_string (STRING_INDEX_BYTES);
+    interface_output_string (", ");
+    interface_output_number (heap_sites[i].allocs);
+    interface_output_string (" ");
+    strings_output_string (STRING_INDEX_ALLOCS);
+    interface_output_endl ();
+    }
+  }
+
+#endif
+
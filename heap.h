@@ -0,0 +1,81 @@
+/*===========================================================================
+
+  pmbasic
+
+  heap.h
+
+  A thin layer over malloc() and free() that keeps track of how much
+  memory is in use, the most that has ever been in use, and which
+  part of the program allocated it. Every allocation is tagged with a
+  HeapSite, and the same site must be given when the memory is freed.
+
+  The sizes are taken from the C library's own block headers, so the
+  accounting costs no extra RAM per block. All the code uses the HEAP_
+  macros rather than calling malloc() directly; if HEAPSTATS is not
+  defined in config.h, the macros just call the C library.
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#pragma once
+
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+#include "config.h"
+
+// The parts of the program that allocate memory. The string table has
+//   a name for each, starting at STRINGS_FIRST_HEAP_SITE
+typedef enum _HeapSite
+  {
+  HEAP_SITE_PROGRAM = 0,
+  HEAP_SITE_PARSER,
+  HEAP_SITE_TOKENIZER,
+  HEAP_SITE_LIST,
+  HEAP_SITE_LINE_INDEX,
+  HEAP_SITE_VARIABLE,
+  HEAP_SITE_PROFILER,
+  HEAP_SITE_ARRAY,
+  HEAP_SITE_STRING,
+  HEAP_SITE_CALLSTACK,
+  HEAP_NUM_SITES
+  } HeapSite;
+
+#ifdef HEAPSTATS
+
+#define HEAP_MALLOC(site, size) heap_malloc (site, size)
+#define HEAP_CALLOC(site, n, size) heap_calloc (site, n, size)
+#define HEAP_REALLOC(site, p, size) heap_realloc (site, p, size)
+#define HEAP_STRDUP(site, s) heap_strdup (site, s)
+#define HEAP_FREE(site, p) heap_free (site, p)
+
+BEGIN_DECLS
+
+extern void  *heap_malloc (HeapSite site, size_t size);
+extern void  *heap_calloc (HeapSite site, size_t n, size_t size);
+extern void  *heap_realloc (HeapSite site, void *p, size_t size);
+extern char  *heap_strdup (HeapSite site, const char *s);
+extern void   heap_free (HeapSite site, void *p);
+
+/** Get the number of bytes currently allocated, and the largest
+ *    number that have been allocated at any one time. */
+extern size_t heap_get_live (void);
+extern size_t heap_get_peak (void);
+
+/** Write the totals, and the figures for each site that has made
+ *    any allocations, using the interface_output functions. */
+extern void   heap_report (void);
+
+END_DECLS
+
+#else
+
+#define HEAP_MALLOC(site, size) malloc (size)
+#define HEAP_CALLOC(site, n, size) calloc (n, size)
+#define HEAP_REALLOC(site, p, size) realloc (p, size)
+#define HEAP_STRDUP(site, s) strdup (s)
+#define HEAP_FREE(site, p) free (p)
+
+#endif
+
@@ -22,9 +22,12 @@ BEGIN_DECLS
 extern BOOL    interface_check_stop (void);
 extern void    interface_output_number (VARTYPE i);
 extern void    interface_output_string (const char *s);
+/** Output len characters of s, which need not be terminated. */
+extern void    interface_output_chars (const char *s, int len);
 extern void    interface_output_endl (void);
 extern void    interface_readstring (char *buff, int len, uint8_t *error);
 extern VARTYPE interface_millis (void);
+extern uint32_t interface_micros (void);
 extern void    interface_delay (VARTYPE msec);
 extern void    interface_poke (int addr, uint8_t byte);
 extern uint8_t interface_peek (int addr);
@@ -33,11 +36,24 @@ extern void    interface_digitalwrite (uint8_t pin, uint8_t value);
 extern void    interface_pinmode (uint8_t pin, uint8_t mode);
 extern VARTYPE interface_analogread (uint8_t pin);
 extern uint8_t interface_digitalread (uint8_t pin);
-extern BOOL    interface_load (BasicProgram *bp);
-extern BOOL    interface_save (const BasicProgram *bp);
 extern void    interface_help (void);
 extern void    interface_info (void);
 
+/** Get the number of bytes in the heap block at p, as recorded by the
+ *    C library's allocator. */
+extern size_t  interface_heap_block_size (void *p);
+
+/** Get the size of the heap, up to its current top, and the number of
+ *    bytes in free blocks below the top. */
+extern void    interface_heap_layout (uint32_t *heap_size, 
+                 uint32_t *free_list);
+
+/** Get the size of the EEPROM, and read and write its bytes. On Linux
+ *    the EEPROM is simulated with a file. */
+extern int     interface_eeprom_size (void);
+extern uint8_t interface_eeprom_read (int addr);
+extern void    interface_eeprom_write (int addr, uint8_t b);
+
 END_DECLS
 
 
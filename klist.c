@@ -14,6 +14,7 @@
 #include <stdio.h>
 #include <assert.h>
 #include "klist.h"
+#include "heap.h"
 
 #define KLOG_IN
 #define KLOG_OUT
@@ -51,7 +52,7 @@ struct _KList
 extern KList *klist_new_empty (KListFreeFn free_fn)
   {
   KLOG_IN
-  KList *self = malloc (sizeof (KList));
+  KList *self = HEAP_MALLOC (HEAP_SITE_LIST, sizeof (KList));
   if (self)
     {
     self->free_fn = free_fn;
@@ -73,7 +74,7 @@ void klist_destroy (KList *self)
   if (self)
     {
     klist_clear (self);
-    free (self);
+    HEAP_FREE (HEAP_SITE_LIST, self);
     }
   KLOG_OUT
   }
@@ -89,7 +90,7 @@ void klist_append (KList *self, void *ref)
   assert (self != NULL);
   assert (ref != NULL);
 
-  ListItem *i = malloc (sizeof (ListItem));
+  ListItem *i = HEAP_MALLOC (HEAP_SITE_LIST, sizeof (ListItem));
   i->data = ref;
   i->next = NULL;
 
@@ -125,7 +126,7 @@ void klist_clear (KList *self)
     self->free_fn (l->data);
     ListItem *temp = l;
     l = l->next;
-    free (temp);
+    HEAP_FREE (HEAP_SITE_LIST, temp);
     }
   
   self->head = 0;
@@ -194,7 +195,7 @@ void klist_remove (KList *self, const void *item, ListCompareFn fn)
         }
       self->free_fn (l->data);
       ListItem *temp = l->next;
-      free (l);
+      HEAP_FREE (HEAP_SITE_LIST, l);
       self->length--;
       l = temp;
       }
@@ -233,7 +234,7 @@ void klist_remove_ref (KList *self, const void *ref, BOOL destroy)
       if (destroy) self->free_fn (l->data);
       ListItem *temp = l->next;
       self->length--;
-      free (l);
+      HEAP_FREE (HEAP_SITE_LIST, l);
       l = temp;
       }
     else
@@ -256,7 +257,7 @@ void klist_sort (KList *self, ListSortFn fn, void *user_data)
   KLOG_IN
   int length = klist_length (self);
   
-  void **temp = malloc (length * sizeof (void *));
+  void **temp = HEAP_MALLOC (HEAP_SITE_LIST, length * sizeof (void *));
   ListItem *l = self->head;
   int i = 0;
   while (l != NULL)
@@ -281,7 +282,7 @@ void klist_sort (KList *self, ListSortFn fn, void *user_data)
     i++;
     }
   
-  free (temp);
+  HEAP_FREE (HEAP_SITE_LIST, temp);
 
   KLOG_OUT
   }
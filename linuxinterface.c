@@ -9,13 +9,44 @@
 ===========================================================================*/
 #include <stdio.h> 
 #include <stdlib.h> 
+#include <string.h> 
 #include <unistd.h> 
 #include <sys/time.h> 
+#include <time.h> 
+#include <malloc.h> 
 #include "interface.h"
 #include "errcodes.h"
+#include "stats.h"
+#include "sampler.h"
+#include "numwidth.h"
+#include "fixedpoint.h"
 
 extern void pmbasic_main_loop (void);
 
+// When virtual_time is set (--virtual-time on the command line), DELAY
+//   does not sleep, but just advances a simulated clock, which MILLIS
+//   then reads. Programs run at full speed, but still see consistent
+//   timing, which is what we need for automated testing.
+static BOOL virtual_time = FALSE;
+static VARTYPE virtual_clock = 0;
+
+// The simulated EEPROM, and the file that holds it between runs
+static uint8_t eeprom [EEPROM_SIZE];
+static BOOL eeprom_loaded = FALSE;
+static const char *eeprom_file = EEPROM_DEFAULT_FILE;
+
+#ifdef STATS
+/*===========================================================================
+  write_stats_json
+  Called at exit if --stats-json was given. The output goes to stderr,
+    to keep it separate from the program's own output.
+===========================================================================*/
+static void write_stats_json (void)
+  {
+  stats_write_json (stderr);
+  }
+#endif
+
 /*===========================================================================
   interface_output_string
 ===========================================================================*/
@@ -24,12 +55,20 @@ void interface_output_string (const char *s)
   printf ("%s", s);
   }
 
+/*===========================================================================
+  interface_output_chars
+===========================================================================*/
+void interface_output_chars (const char *s, int len)
+  {
+  fwrite (s, 1, len, stdout);
+  }
+
 /*===========================================================================
   interface_output_number
 ===========================================================================*/
 void interface_output_number (VARTYPE i)
   {
-  printf ("%d", i);
+  printf (PRINTF_DEC, i);
   }
 
 /*===========================================================================
@@ -47,18 +86,22 @@ void interface_readstring (char *buff, int len, uint8_t *error)
   {
   *error = 0;
   int pos = 0;
+#ifdef SAMPLER
+  sampler_drain ();
+#endif
   int c = getchar() ;
   if (c < 0) exit(0); // Nasty!
   int i = 0;
   while (c > 0 && c != 10) 
     {
-    if (i < len)
+    // len includes the terminating zero, as in the Arduino version
+    if (i < len - 1)
       buff[pos++] = c;
     c = getchar() ;
     i++;
     }
   buff[pos] = 0;
-  if (i > len) *error = BASIC_ERR_INPUT_TOO_LONG;
+  if (i > len - 1) *error = BASIC_ERR_INPUT_TOO_LONG;
   }
 
 /*===========================================================================
@@ -66,6 +109,11 @@ void interface_readstring (char *buff, int len, uint8_t *error)
 ===========================================================================*/
 BOOL interface_check_stop (void)
   {
+#ifdef SAMPLER
+  // This is called before every statement, so it's a convenient place
+  //   to empty the sampler's ring buffer before it fills up
+  if (sampler_drain_wanted) sampler_drain ();
+#endif
   return FALSE;  // Not implemented
   }
 
@@ -74,16 +122,34 @@ BOOL interface_check_stop (void)
  * =========================================================================*/
 VARTYPE interface_millis (void)
   {
+  if (virtual_time) return virtual_clock;
   struct timeval tv;
   gettimeofday (&tv, NULL);
   return tv.tv_sec * 1000 + tv.tv_usec / 1000;
   }
 
+/*============================================================================
+ * interface_micros 
+ * Note that this is a real (monotonic) time, even in virtual-time mode,
+ *   because it's used for profiling the interpreter itself. 
+ * =========================================================================*/
+uint32_t interface_micros (void)
+  {
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+  }
+
 /*============================================================================
  * interface_delay
  * =========================================================================*/
 void interface_delay (VARTYPE msec)
   {
+  if (virtual_time)
+    {
+    if (msec > 0) virtual_clock += msec;
+    return;
+    }
   usleep (1000 * msec);
   }
 
@@ -146,23 +212,81 @@ void interface_info (void)
   }
 
 /*============================================================================
- * interface_save
+ * interface_heap_block_size
  * =========================================================================*/
-BOOL interface_save (const BasicProgram *bp)
+size_t interface_heap_block_size (void *p)
   {
-  (void) bp;
-  printf ("SAVE not implemented\n");
-  return FALSE;
+  return malloc_usable_size (p);
   }
 
 /*============================================================================
- * interface_load
+ * interface_heap_layout
+ * In glibc, 'keepcost' is the free space at the top of the heap, which 
+ *   could be returned to the system; the rest of the free space is in
+ *   holes.
  * =========================================================================*/
-BOOL interface_load (BasicProgram *bp)
+void interface_heap_layout (uint32_t *heap_size, uint32_t *free_list)
   {
-  (void) bp;
-  printf ("LOAD not implemented\n");
-  return FALSE;
+  struct mallinfo2 mi = mallinfo2 ();
+  *heap_size = mi.arena;
+  *free_list = mi.fordblks - mi.keepcost;
+  }
+
+/*============================================================================
+ * interface_eeprom_load
+ * The simulated EEPROM is read from its file the first time it is used.
+ *   A missing or short file reads as erased EEPROM, which is all 0xFF.
+ * =========================================================================*/
+static void interface_eeprom_load (void)
+  {
+  if (eeprom_loaded) return;
+  eeprom_loaded = TRUE;
+  memset (eeprom, 0xFF, sizeof (eeprom));
+  FILE *f = fopen (eeprom_file, "rb");
+  if (f)
+    {
+    if (fread (eeprom, 1, sizeof (eeprom), f) == 0 && ferror (f))
+      perror (eeprom_file);
+    fclose (f);
+    }
+  }
+
+/*============================================================================
+ * interface_eeprom_size
+ * =========================================================================*/
+int interface_eeprom_size (void)
+  {
+  return EEPROM_SIZE;
+  }
+
+/*============================================================================
+ * interface_eeprom_read
+ * =========================================================================*/
+uint8_t interface_eeprom_read (int addr)
+  {
+  if (addr < 0 || addr >= EEPROM_SIZE) return 0xFF;
+  interface_eeprom_load ();
+  return eeprom[addr];
+  }
+
+/*============================================================================
+ * interface_eeprom_write
+ * The whole file is rewritten on each write, which is slow but simple;
+ *   SAVE is the only thing that writes to the EEPROM.
+ * =========================================================================*/
+void interface_eeprom_write (int addr, uint8_t b)
+  {
+  if (addr < 0 || addr >= EEPROM_SIZE) return;
+  interface_eeprom_load ();
+  eeprom[addr] = b;
+  FILE *f = fopen (eeprom_file, "wb");
+  if (f)
+    {
+    fwrite (eeprom, 1, sizeof (eeprom), f);
+    fclose (f);
+    }
+  else
+    perror (eeprom_file);
   }
 
 /*============================================================================
@@ -170,7 +294,7 @@ BOOL interface_load (BasicProgram *bp)
  * =========================================================================*/
 void interface_analogwrite (uint8_t pin, VARTYPE value)
   {
-  printf ("ANALOGWRITE %d, %d not implemented\n", pin, value);
+  printf ("ANALOGWRITE %d, " PRINTF_DEC " not implemented\n", pin, value);
   }
 
 /*============================================================================
@@ -185,8 +309,62 @@ VARTYPE interface_analogread (uint8_t pin)
 /*===========================================================================
   main 
 ===========================================================================*/
-int main ()
+int main (int argc, char **argv)
   {
+#ifdef SAMPLER
+  const char *sample_file = NULL;
+  int sample_hz = 1000;
+#endif
+#ifdef FIXED_POINT
+  BOOL fixed = FALSE;
+#endif
+  for (int i = 1; i < argc; i++)
+    {
+    if (strcmp (argv[i], "--virtual-time") == 0)
+      virtual_time = TRUE;
+    else if (strcmp (argv[i], "--eeprom") == 0 && i + 1 < argc)
+      eeprom_file = argv[++i];
+    else if (strcmp (argv[i], "--width") == 0 && i + 1 < argc
+         && numwidth_set (atoi (argv[i + 1])))
+      i++;
+#ifdef FIXED_POINT
+    else if (strcmp (argv[i], "--fixed") == 0)
+      fixed = TRUE;
+#endif
+#ifdef STATS
+    else if (strcmp (argv[i], "--stats-json") == 0)
+      atexit (write_stats_json);
+#endif
+#ifdef SAMPLER
+    else if (strcmp (argv[i], "--sample-profile") == 0 && i + 1 < argc)
+      sample_file = argv[++i];
+    else if (strcmp (argv[i], "--sample-hz") == 0 && i + 1 < argc)
+      sample_hz = atoi (argv[++i]);
+#endif
+    else
+      {
+      fprintf (stderr, "Usage: %s [--virtual-time] [--eeprom file]"
+        " [--width 16|32|64] [--fixed] [--stats-json]"
+        " [--sample-profile file] [--sample-hz hz]\n",
+        argv[0]);
+      return 1;
+      }
+    }
+#ifdef FIXED_POINT
+  // The width may come after --fixed
+  if (fixed && !fixedpoint_set (TRUE))
+    {
+    fprintf (stderr, "%s: --fixed needs a width of 32 or 64\n", argv[0]);
+    return 1;
+    }
+#endif
+#ifdef SAMPLER
+  if (sample_file && !sampler_start (sample_file, sample_hz))
+    {
+    fprintf (stderr, "Can't start sampling profiler\n");
+    return 1;
+    }
+#endif
   pmbasic_main_loop ();
   }
 
@@ -0,0 +1,584 @@
+/*===========================================================================
+
+  pmbasic
+
+  mat.c
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#include <stdint.h>
+#include "config.h"
+#include "defs.h"
+#include "mat.h"
+#include "numwidth.h"
+#include "fixedpoint.h"
+
+// On x86-64, SSE2 is always present, and AVX2 is used if the processor
+//   has it. The AVX2 functions are compiled for AVX2 whatever the
+//   compiler options, and only called after checking the processor.
+//   The vector code is written for 32-bit and 64-bit elements; 16-bit
+//   elements just use the simple loops.
+#if defined (__x86_64__) && defined (__GNUC__) \
+   && (VARTYPE_BITS == 32 || VARTYPE_BITS == 64)
+#define MAT_X86
+#include <immintrin.h>
+#define MAT_AVX2 __attribute__ ((target ("avx2")))
+#endif
+
+#ifdef MAT_X86
+
+/*===========================================================================
+  mat_have_avx2
+===========================================================================*/
+static BOOL mat_have_avx2 (void)
+  {
+  static int8_t have = -1;
+  if (have < 0) have = __builtin_cpu_supports ("avx2") ? 1 : 0;
+  return have;
+  }
+
+#if VARTYPE_BITS == 32
+
+/*===========================================================================
+  mat_mullo_sse2
+  SSE2 has no instruction that multiplies 32-bit elements and keeps the
+    low halves of the results (that came with SSE4.1). So the even and
+    odd elements are multiplied separately, into 64-bit results, and
+    their low halves put back together.
+===========================================================================*/
+static __m128i mat_mullo_sse2 (__m128i a, __m128i b)
+  {
+  __m128i even = _mm_mul_epu32 (a, b);
+  __m128i odd = _mm_mul_epu32 (_mm_srli_epi64 (a, 32),
+    _mm_srli_epi64 (b, 32));
+  return _mm_unpacklo_epi32 (_mm_shuffle_epi32 (even, _MM_SHUFFLE (0, 0, 2, 0)),
+    _mm_shuffle_epi32 (odd, _MM_SHUFFLE (0, 0, 2, 0)));
+  }
+
+/*===========================================================================
+  mat_add_sse2
+  The vector functions return the number of elements they have dealt
+    with, leaving any left over at the end for the simple loop
+===========================================================================*/
+static size_t mat_add_sse2 (VARTYPE *c, const VARTYPE *a, const VARTYPE *b,
+         size_t n)
+  {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+    __m128i va = _mm_loadu_si128 ((const __m128i *)(a + i));
+    __m128i vb = _mm_loadu_si128 ((const __m128i *)(b + i));
+    _mm_storeu_si128 ((__m128i *)(c + i), _mm_add_epi32 (va, vb));
+    }
+  return i;
+  }
+
+/*===========================================================================
+  mat_add_avx2
+===========================================================================*/
+static MAT_AVX2 size_t mat_add_avx2 (VARTYPE *c, const VARTYPE *a,
+         const VARTYPE *b, size_t n)
+  {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    {
+    __m256i va = _mm256_loadu_si256 ((const __m256i *)(a + i));
+    __m256i vb = _mm256_loadu_si256 ((const __m256i *)(b + i));
+    _mm256_storeu_si256 ((__m256i *)(c + i), _mm256_add_epi32 (va, vb));
+    }
+  return i;
+  }
+
+/*===========================================================================
+  mat_sub_sse2
+===========================================================================*/
+static size_t mat_sub_sse2 (VARTYPE *c, const VARTYPE *a, const VARTYPE *b,
+         size_t n)
+  {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+    __m128i va = _mm_loadu_si128 ((const __m128i *)(a + i));
+    __m128i vb = _mm_loadu_si128 ((const __m128i *)(b + i));
+    _mm_storeu_si128 ((__m128i *)(c + i), _mm_sub_epi32 (va, vb));
+    }
+  return i;
+  }
+
+/*===========================================================================
+  mat_sub_avx2
+===========================================================================*/
+static MAT_AVX2 size_t mat_sub_avx2 (VARTYPE *c, const VARTYPE *a,
+         const VARTYPE *b, size_t n)
+  {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    {
+    __m256i va = _mm256_loadu_si256 ((const __m256i *)(a + i));
+    __m256i vb = _mm256_loadu_si256 ((const __m256i *)(b + i));
+    _mm256_storeu_si256 ((__m256i *)(c + i), _mm256_sub_epi32 (va, vb));
+    }
+  return i;
+  }
+
+/*===========================================================================
+  mat_scale_sse2
+===========================================================================*/
+static size_t mat_scale_sse2 (VARTYPE *c, const VARTYPE *a, VARTYPE k,
+         size_t n)
+  {
+  __m128i vk = _mm_set1_epi32 (k);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+    __m128i va = _mm_loadu_si128 ((const __m128i *)(a + i));
+    _mm_storeu_si128 ((__m128i *)(c + i), mat_mullo_sse2 (va, vk));
+    }
+  return i;
+  }
+
+/*===========================================================================
+  mat_scale_avx2
+===========================================================================*/
+static MAT_AVX2 size_t mat_scale_avx2 (VARTYPE *c, const VARTYPE *a,
+         VARTYPE k, size_t n)
+  {
+  __m256i vk = _mm256_set1_epi32 (k);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    {
+    __m256i va = _mm256_loadu_si256 ((const __m256i *)(a + i));
+    _mm256_storeu_si256 ((__m256i *)(c + i), _mm256_mullo_epi32 (va, vk));
+    }
+  return i;
+  }
+
+/*===========================================================================
+  mat_sum_sse2
+  The sum and dot product keep a total in each lane, and add the lanes
+    together at the end. Because overflow wraps around, the order of
+    the additions makes no difference to the result.
+===========================================================================*/
+static size_t mat_sum_sse2 (const VARTYPE *a, size_t n, UVARTYPE *total)
+  {
+  __m128i vt = _mm_setzero_si128 ();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    vt = _mm_add_epi32 (vt, _mm_loadu_si128 ((const __m128i *)(a + i)));
+  UVARTYPE lanes [4];
+  _mm_storeu_si128 ((__m128i *)lanes, vt);
+  *total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  return i;
+  }
+
+/*===========================================================================
+  mat_sum_avx2
+===========================================================================*/
+static MAT_AVX2 size_t mat_sum_avx2 (const VARTYPE *a, size_t n,
+         UVARTYPE *total)
+  {
+  __m256i vt = _mm256_setzero_si256 ();
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    vt = _mm256_add_epi32 (vt, _mm256_loadu_si256 ((const __m256i *)(a + i)));
+  UVARTYPE lanes [8];
+  _mm256_storeu_si256 ((__m256i *)lanes, vt);
+  *total = 0;
+  for (uint8_t l = 0; l < 8; l++) *total += lanes[l];
+  return i;
+  }
+
+/*===========================================================================
+  mat_dot_sse2
+===========================================================================*/
+static size_t mat_dot_sse2 (const VARTYPE *a, const VARTYPE *b, size_t n,
+         UVARTYPE *total)
+  {
+  __m128i vt = _mm_setzero_si128 ();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+    __m128i va = _mm_loadu_si128 ((const __m128i *)(a + i));
+    __m128i vb = _mm_loadu_si128 ((const __m128i *)(b + i));
+    vt = _mm_add_epi32 (vt, mat_mullo_sse2 (va, vb));
+    }
+  UVARTYPE lanes [4];
+  _mm_storeu_si128 ((__m128i *)lanes, vt);
+  *total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  return i;
+  }
+
+/*===========================================================================
+  mat_dot_avx2
+===========================================================================*/
+static MAT_AVX2 size_t mat_dot_avx2 (const VARTYPE *a, const VARTYPE *b,
+         size_t n, UVARTYPE *total)
+  {
+  __m256i vt = _mm256_setzero_si256 ();
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    {
+    __m256i va = _mm256_loadu_si256 ((const __m256i *)(a + i));
+    __m256i vb = _mm256_loadu_si256 ((const __m256i *)(b + i));
+    vt = _mm256_add_epi32 (vt, _mm256_mullo_epi32 (va, vb));
+    }
+  UVARTYPE lanes [8];
+  _mm256_storeu_si256 ((__m256i *)lanes, vt);
+  *total = 0;
+  for (uint8_t l = 0; l < 8; l++) *total += lanes[l];
+  return i;
+  }
+
+#else
+
+/*===========================================================================
+  mat_wrap_sse2
+  Elements are 64 bits, but the arithmetic may be narrower (see
+    numwidth.h), so each result has to be wrapped to the width. There is
+    no arithmetic right shift for 64-bit elements before AVX-512, so
+    the unused bits are shifted out at the top and then back in as
+    zeros, and the sign extended by flipping the sign bit of the width
+    and subtracting it. At 64 bits, this changes nothing.
+===========================================================================*/
+#define MAT_WRAP_SHIFT _mm_cvtsi32_si128 (NUMWIDTH_SHIFT)
+#define MAT_WRAP_SIGN ((int64_t)((UVARTYPE)1 << (63 - NUMWIDTH_SHIFT)))
+
+static __m128i mat_wrap_sse2 (__m128i v, __m128i shift, __m128i sign)
+  {
+  v = _mm_srl_epi64 (_mm_sll_epi64 (v, shift), shift);
+  return _mm_sub_epi64 (_mm_xor_si128 (v, sign), sign);
+  }
+
+/*===========================================================================
+  mat_wrap_avx2
+===========================================================================*/
+static MAT_AVX2 __m256i mat_wrap_avx2 (__m256i v, __m128i shift,
+         __m256i sign)
+  {
+  v = _mm256_srl_epi64 (_mm256_sll_epi64 (v, shift), shift);
+  return _mm256_sub_epi64 (_mm256_xor_si256 (v, sign), sign);
+  }
+
+/*===========================================================================
+  mat_mullo_sse2
+  Nothing before AVX-512 multiplies 64-bit elements. But the low 64 bits
+    of a product only need the low half of a times the low half of b,
+    and the two cross products shifted up by 32 bits. If the width is
+    no more than 32 bits, the low halves are all that matter, and the
+    cross products can be left out.
+===========================================================================*/
+static __m128i mat_mullo_sse2 (__m128i a, __m128i b, BOOL narrow)
+  {
+  __m128i low = _mm_mul_epu32 (a, b);
+  if (narrow) return low;
+  __m128i cross = _mm_add_epi64 (_mm_mul_epu32 (_mm_srli_epi64 (a, 32), b),
+    _mm_mul_epu32 (a, _mm_srli_epi64 (b, 32)));
+  return _mm_add_epi64 (low, _mm_slli_epi64 (cross, 32));
+  }
+
+/*===========================================================================
+  mat_mullo_avx2
+===========================================================================*/
+static MAT_AVX2 __m256i mat_mullo_avx2 (__m256i a, __m256i b, BOOL narrow)
+  {
+  __m256i low = _mm256_mul_epu32 (a, b);
+  if (narrow) return low;
+  __m256i cross = _mm256_add_epi64 (
+    _mm256_mul_epu32 (_mm256_srli_epi64 (a, 32), b),
+    _mm256_mul_epu32 (a, _mm256_srli_epi64 (b, 32)));
+  return _mm256_add_epi64 (low, _mm256_slli_epi64 (cross, 32));
+  }
+
+/*===========================================================================
+  mat_add_sse2
+  The vector functions return the number of elements they have dealt
+    with, leaving any left over at the end for the simple loop
+===========================================================================*/
+static size_t mat_add_sse2 (VARTYPE *c, const VARTYPE *a, const VARTYPE *b,
+         size_t n)
+  {
+  __m128i shift = MAT_WRAP_SHIFT;
+  __m128i sign = _mm_set1_epi64x (MAT_WRAP_SIGN);
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2)
+    {
+    __m128i va = _mm_loadu_si128 ((const __m128i *)(a + i));
+    __m128i vb = _mm_loadu_si128 ((const __m128i *)(b + i));
+    _mm_storeu_si128 ((__m128i *)(c + i), 
+      mat_wrap_sse2 (_mm_add_epi64 (va, vb), shift, sign));
+    }
+  return i;
+  }
+
+/*===========================================================================
+  mat_add_avx2
+===========================================================================*/
+static MAT_AVX2 size_t mat_add_avx2 (VARTYPE *c, const VARTYPE *a,
+         const VARTYPE *b, size_t n)
+  {
+  __m128i shift = MAT_WRAP_SHIFT;
+  __m256i sign = _mm256_set1_epi64x (MAT_WRAP_SIGN);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+    __m256i va = _mm256_loadu_si256 ((const __m256i *)(a + i));
+    __m256i vb = _mm256_loadu_si256 ((const __m256i *)(b + i));
+    _mm256_storeu_si256 ((__m256i *)(c + i), 
+      mat_wrap_avx2 (_mm256_add_epi64 (va, vb), shift, sign));
+    }
+  return i;
+  }
+
+/*===========================================================================
+  mat_sub_sse2
+===========================================================================*/
+static size_t mat_sub_sse2 (VARTYPE *c, const VARTYPE *a, const VARTYPE *b,
+         size_t n)
+  {
+  __m128i shift = MAT_WRAP_SHIFT;
+  __m128i sign = _mm_set1_epi64x (MAT_WRAP_SIGN);
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2)
+    {
+    __m128i va = _mm_loadu_si128 ((const __m128i *)(a + i));
+    __m128i vb = _mm_loadu_si128 ((const __m128i *)(b + i));
+    _mm_storeu_si128 ((__m128i *)(c + i), 
+      mat_wrap_sse2 (_mm_sub_epi64 (va, vb), shift, sign));
+    }
+  return i;
+  }
+
+/*===========================================================================
+  mat_sub_avx2
+===========================================================================*/
+static MAT_AVX2 size_t mat_sub_avx2 (VARTYPE *c, const VARTYPE *a,
+         const VARTYPE *b, size_t n)
+  {
+  __m128i shift = MAT_WRAP_SHIFT;
+  __m256i sign = _mm256_set1_epi64x (MAT_WRAP_SIGN);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+    __m256i va = _mm256_loadu_si256 ((const __m256i *)(a + i));
+    __m256i vb = _mm256_loadu_si256 ((const __m256i *)(b + i));
+    _mm256_storeu_si256 ((__m256i *)(c + i), 
+      mat_wrap_avx2 (_mm256_sub_epi64 (va, vb), shift, sign));
+    }
+  return i;
+  }
+
+/*===========================================================================
+  mat_scale_sse2
+===========================================================================*/
+static size_t mat_scale_sse2 (VARTYPE *c, const VARTYPE *a, VARTYPE k,
+         size_t n)
+  {
+  BOOL narrow = NUMWIDTH_SHIFT >= 32;
+  __m128i shift = MAT_WRAP_SHIFT;
+  __m128i sign = _mm_set1_epi64x (MAT_WRAP_SIGN);
+  __m128i vk = _mm_set1_epi64x (k);
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2)
+    {
+    __m128i va = _mm_loadu_si128 ((const __m128i *)(a + i));
+    _mm_storeu_si128 ((__m128i *)(c + i), 
+      mat_wrap_sse2 (mat_mullo_sse2 (va, vk, narrow), shift, sign));
+    }
+  return i;
+  }
+
+/*===========================================================================
+  mat_scale_avx2
+===========================================================================*/
+static MAT_AVX2 size_t mat_scale_avx2 (VARTYPE *c, const VARTYPE *a,
+         VARTYPE k, size_t n)
+  {
+  BOOL narrow = NUMWIDTH_SHIFT >= 32;
+  __m128i shift = MAT_WRAP_SHIFT;
+  __m256i sign = _mm256_set1_epi64x (MAT_WRAP_SIGN);
+  __m256i vk = _mm256_set1_epi64x (k);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+    __m256i va = _mm256_loadu_si256 ((const __m256i *)(a + i));
+    _mm256_storeu_si256 ((__m256i *)(c + i), 
+      mat_wrap_avx2 (mat_mullo_avx2 (va, vk, narrow), shift, sign));
+    }
+  return i;
+  }
+
+/*===========================================================================
+  mat_sum_sse2
+  The sum and dot product keep a total in each lane, and add the lanes
+    together at the end. Because overflow wraps around, the order of
+    the additions makes no difference to the result, and the total only
+    has to be wrapped to the width once, by the caller.
+===========================================================================*/
+static size_t mat_sum_sse2 (const VARTYPE *a, size_t n, UVARTYPE *total)
+  {
+  __m128i vt = _mm_setzero_si128 ();
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2)
+    vt = _mm_add_epi64 (vt, _mm_loadu_si128 ((const __m128i *)(a + i)));
+  UVARTYPE lanes [2];
+  _mm_storeu_si128 ((__m128i *)lanes, vt);
+  *total = lanes[0] + lanes[1];
+  return i;
+  }
+
+/*===========================================================================
+  mat_sum_avx2
+===========================================================================*/
+static MAT_AVX2 size_t mat_sum_avx2 (const VARTYPE *a, size_t n,
+         UVARTYPE *total)
+  {
+  __m256i vt = _mm256_setzero_si256 ();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    vt = _mm256_add_epi64 (vt, _mm256_loadu_si256 ((const __m256i *)(a + i)));
+  UVARTYPE lanes [4];
+  _mm256_storeu_si256 ((__m256i *)lanes, vt);
+  *total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  return i;
+  }
+
+/*===========================================================================
+  mat_dot_sse2
+===========================================================================*/
+static size_t mat_dot_sse2 (const VARTYPE *a, const VARTYPE *b, size_t n,
+         UVARTYPE *total)
+  {
+  BOOL narrow = NUMWIDTH_SHIFT >= 32;
+  __m128i vt = _mm_setzero_si128 ();
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2)
+    {
+    __m128i va = _mm_loadu_si128 ((const __m128i *)(a + i));
+    __m128i vb = _mm_loadu_si128 ((const __m128i *)(b + i));
+    vt = _mm_add_epi64 (vt, mat_mullo_sse2 (va, vb, narrow));
+    }
+  UVARTYPE lanes [2];
+  _mm_storeu_si128 ((__m128i *)lanes, vt);
+  *total = lanes[0] + lanes[1];
+  return i;
+  }
+
+/*===========================================================================
+  mat_dot_avx2
+===========================================================================*/
+static MAT_AVX2 size_t mat_dot_avx2 (const VARTYPE *a, const VARTYPE *b,
+         size_t n, UVARTYPE *total)
+  {
+  BOOL narrow = NUMWIDTH_SHIFT >= 32;
+  __m256i vt = _mm256_setzero_si256 ();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+    __m256i va = _mm256_loadu_si256 ((const __m256i *)(a + i));
+    __m256i vb = _mm256_loadu_si256 ((const __m256i *)(b + i));
+    vt = _mm256_add_epi64 (vt, mat_mullo_avx2 (va, vb, narrow));
+    }
+  UVARTYPE lanes [4];
+  _mm256_storeu_si256 ((__m256i *)lanes, vt);
+  *total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  return i;
+  }
+
+#endif
+
+#endif
+
+/*===========================================================================
+  mat_add
+  The simple loops do their arithmetic unsigned, so that overflow wraps
+    around in the same way as in the vector code.
+===========================================================================*/
+void mat_add (VARTYPE *c, const VARTYPE *a, const VARTYPE *b, size_t n)
+  {
+  size_t i = 0;
+#ifdef MAT_X86
+  i = mat_have_avx2 () ? mat_add_avx2 (c, a, b, n) : mat_add_sse2 (c, a, b, n);
+#endif
+  for (; i < n; i++)
+    c[i] = NUMWIDTH_WRAP ((UVARTYPE)a[i] + (UVARTYPE)b[i]);
+  }
+
+/*===========================================================================
+  mat_sub
+===========================================================================*/
+void mat_sub (VARTYPE *c, const VARTYPE *a, const VARTYPE *b, size_t n)
+  {
+  size_t i = 0;
+#ifdef MAT_X86
+  i = mat_have_avx2 () ? mat_sub_avx2 (c, a, b, n) : mat_sub_sse2 (c, a, b, n);
+#endif
+  for (; i < n; i++)
+    c[i] = NUMWIDTH_WRAP ((UVARTYPE)a[i] - (UVARTYPE)b[i]);
+  }
+
+/*===========================================================================
+  mat_scale
+===========================================================================*/
+void mat_scale (VARTYPE *c, const VARTYPE *a, VARTYPE k, size_t n)
+  {
+  size_t i = 0;
+#ifdef FIXED_POINT
+  // Fixed-point products need rounding, and twice the width, so there
+  //   are no vector versions
+  if (FIXEDPOINT_ON)
+    {
+    for (; i < n; i++)
+      c[i] = fixedpoint_mul (a[i], k);
+    return;
+    }
+#endif
+#ifdef MAT_X86
+  i = mat_have_avx2 () ? mat_scale_avx2 (c, a, k, n) 
+    : mat_scale_sse2 (c, a, k, n);
+#endif
+  for (; i < n; i++)
+    c[i] = NUMWIDTH_WRAP ((UVARTYPE)a[i] * (UVARTYPE)k);
+  }
+
+/*===========================================================================
+  mat_sum
+===========================================================================*/
+VARTYPE mat_sum (const VARTYPE *a, size_t n)
+  {
+  UVARTYPE total = 0;
+  size_t i = 0;
+#ifdef MAT_X86
+  i = mat_have_avx2 () ? mat_sum_avx2 (a, n, &total) 
+    : mat_sum_sse2 (a, n, &total);
+#endif
+  for (; i < n; i++)
+    total += (UVARTYPE)a[i];
+  return NUMWIDTH_WRAP (total);
+  }
+
+/*===========================================================================
+  mat_dot
+===========================================================================*/
+VARTYPE mat_dot (const VARTYPE *a, const VARTYPE *b, size_t n)
+  {
+  UVARTYPE total = 0;
+  size_t i = 0;
+#ifdef FIXED_POINT
+  if (FIXEDPOINT_ON)
+    {
+    for (; i < n; i++)
+      total += (UVARTYPE)fixedpoint_mul (a[i], b[i]);
+    return NUMWIDTH_WRAP (total);
+    }
+#endif
+#ifdef MAT_X86
+  i = mat_have_avx2 () ? mat_dot_avx2 (a, b, n, &total) 
+    : mat_dot_sse2 (a, b, n, &total);
+#endif
+  for (; i < n; i++)
+    total += (UVARTYPE)a[i] * (UVARTYPE)b[i];
+  return NUMWIDTH_WRAP (total);
+  }
+
@@ -0,0 +1,47 @@
+/*===========================================================================
+
+  pmbasic
+
+  mat.h
+
+  Whole-array arithmetic, for the MAT statements. Each function works
+  on n elements at once, so the interpreter is only involved once per
+  statement, not once per element. On x86-64 the work is done with
+  SSE2 or, where the processor has it, AVX2 instructions; elsewhere
+  it is a simple loop. The results are the same either way: like all
+  PMBASIC arithmetic, overflow wraps around, at the current width of
+  arithmetic (see numwidth.h). In fixed-point mode (see fixedpoint.h),
+  multiplication is done one element at a time.
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#pragma once
+
+#include <stddef.h>
+#include "defs.h"
+#include "config.h"
+
+BEGIN_DECLS
+
+/** c = a + b, element by element. c can be the same as a or b. */
+extern void    mat_add (VARTYPE *c, const VARTYPE *a, const VARTYPE *b,
+                  size_t n);
+
+/** c = a - b, element by element. c can be the same as a or b. */
+extern void    mat_sub (VARTYPE *c, const VARTYPE *a, const VARTYPE *b,
+                  size_t n);
+
+/** c = a * k. c can be the same as a. */
+extern void    mat_scale (VARTYPE *c, const VARTYPE *a, VARTYPE k,
+                  size_t n);
+
+/** Get the sum of the elements of a. */
+extern VARTYPE mat_sum (const VARTYPE *a, size_t n);
+
+/** Get the sum of the products of the elements of a and b. */
+extern VARTYPE mat_dot (const VARTYPE *a, const VARTYPE *b, size_t n);
+
+END_DECLS
+
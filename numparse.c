@@ -0,0 +1,186 @@
+/*===========================================================================
+
+  pmbasic
+
+  numparse.c
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#include <string.h>
+#include "config.h"
+#include "defs.h"
+#include "numparse.h"
+#include "numwidth.h"
+#include "fixedpoint.h"
+
+// The largest number at the current width
+#define NUMPARSE_MAX NUMWIDTH_MAX
+
+// The most decimal digits that always fit into the current width
+#define NUMPARSE_SAFE_DIGITS (NUMWIDTH_BITS == 16 ? 4 \
+   : NUMWIDTH_BITS == 32 ? 9 : 18)
+
+// On 64-bit hosts whose byte order puts the first digit in the bottom
+//   byte of a word, long decimal numbers are converted eight digits at
+//   a time, with ordinary arithmetic on a 64-bit word ("SIMD within a
+//   register"). On the Arduino, or anything else, the digits are
+//   converted one at a time.
+#if __SIZEOF_POINTER__ == 8 && defined (__BYTE_ORDER__) \
+   && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define NUMPARSE_SWAR
+#endif
+
+#define NUMPARSE_IS_DIGIT(c) ((uint8_t)((c) - '0') < 10)
+
+#ifdef NUMPARSE_SWAR
+/*===========================================================================
+  numparse_eight
+  Convert exactly eight decimal digits. Each step combines pairs of
+    adjacent fields: first single digits into two-digit numbers in
+    alternate bytes, then those into four-digit numbers, and finally
+    the two four-digit numbers into one.
+===========================================================================*/
+static uint32_t numparse_eight (const char *s)
+  {
+  uint64_t v;
+  memcpy (&v, s, 8);
+  v -= 0x3030303030303030ULL;
+  v = (v * 10) + (v >> 8);
+  v = (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32)))
+    + (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+  return (uint32_t)v;
+  }
+#endif
+
+/*===========================================================================
+  numparse_decimal
+===========================================================================*/
+BOOL numparse_decimal (const char *s, uint8_t len, VARTYPE *value)
+  {
+  // Leading zeros don't count towards the size of the number
+  while (len > 0 && *s == '0')
+    {
+    s++;
+    len--;
+    }
+
+#ifdef NUMPARSE_SWAR
+  if (len >= 8)
+    {
+    // Nineteen digits always fit into 64 bits, so the check for
+    //   overflow can be left to the end
+    if (len > 19) return FALSE;
+    uint64_t total = 0;
+    for (; len >= 8; s += 8, len -= 8)
+      total = total * 100000000 + numparse_eight (s);
+    for (; len > 0; s++, len--)
+      total = total * 10 + (*s - '0');
+    if (total > NUMPARSE_MAX) return FALSE;
+    *value = (VARTYPE)total;
+    return TRUE;
+    }
+#endif
+
+  UVARTYPE total = 0;
+  if (len <= NUMPARSE_SAFE_DIGITS)
+    {
+    // Too few digits to overflow, so no need to check each one
+    for (; len > 0; s++, len--)
+      total = total * 10 + (*s - '0');
+    *value = (VARTYPE)total;
+    return TRUE;
+    }
+  for (; len > 0; s++, len--)
+    {
+    uint8_t digit = *s - '0';
+    if (total > NUMPARSE_MAX / 10
+         || (total == NUMPARSE_MAX / 10 && digit > NUMPARSE_MAX % 10))
+      return FALSE;
+    total = total * 10 + digit;
+    }
+  *value = (VARTYPE)total;
+  return TRUE;
+  }
+
+/*===========================================================================
+  numparse_hex
+===========================================================================*/
+BOOL numparse_hex (const char *s, uint8_t len, VARTYPE *value)
+  {
+  while (len > 0 && *s == '0')
+    {
+    s++;
+    len--;
+    }
+  if (len > NUMWIDTH_BITS / 4) return FALSE;
+
+  UVARTYPE total = 0;
+  for (; len > 0; s++, len--)
+    {
+    char c = *s;
+    // Setting bit 5 turns A-F into a-f, without affecting the digits
+    uint8_t digit = NUMPARSE_IS_DIGIT (c) ? c - '0' : (c | 0x20) - 'a' + 10;
+    total = (total << 4) | digit;
+    }
+  // The top digit may have set the sign bit of the width
+  *value = NUMWIDTH_WRAP (total);
+  return TRUE;
+  }
+
+/*===========================================================================
+  numparse_prefix
+===========================================================================*/
+BOOL numparse_prefix (const char *s, uint8_t *length, VARTYPE *value)
+  {
+  uint8_t len = 0;
+  while (NUMPARSE_IS_DIGIT (s[len]) && len < 255) len++;
+  *length = len;
+  *value = 0;
+  return numparse_decimal (s, len, value);
+  }
+
+#ifdef FIXED_POINT
+/*===========================================================================
+  numparse_fixed
+===========================================================================*/
+BOOL numparse_fixed (const char *s, uint8_t len, VARTYPE *value)
+  {
+  uint8_t whole_len = 0;
+  while (whole_len < len && s[whole_len] != '.') whole_len++;
+  VARTYPE whole = 0;
+  if (!numparse_decimal (s, whole_len, &whole)) return FALSE;
+  UVARTYPE frac = 0;
+  if (whole_len < len)
+    frac = fixedpoint_fraction (s + whole_len + 1, len - whole_len - 1);
+  // The fraction may have been rounded up to a whole one
+  if ((UVARTYPE)whole > (NUMPARSE_MAX - frac) >> FIXEDPOINT_BITS)
+    return FALSE;
+  *value = (VARTYPE)(((UVARTYPE)whole << FIXEDPOINT_BITS) + frac);
+  return TRUE;
+  }
+#endif
+
+/*===========================================================================
+  numparse_number_prefix
+===========================================================================*/
+BOOL numparse_number_prefix (const char *s, uint8_t *length, VARTYPE *value)
+  {
+#ifdef FIXED_POINT
+  if (!FIXEDPOINT_ON) return numparse_prefix (s, length, value);
+  uint8_t len = 0;
+  while (NUMPARSE_IS_DIGIT (s[len]) && len < 255) len++;
+  if (s[len] == '.' && len < 255)
+    {
+    len++;
+    while (NUMPARSE_IS_DIGIT (s[len]) && len < 255) len++;
+    }
+  *length = len;
+  *value = 0;
+  return numparse_fixed (s, len, value);
+#else
+  return numparse_prefix (s, length, value);
+#endif
+  }
+
@@ -0,0 +1,54 @@
+/*===========================================================================
+
+  pmbasic
+
+  numparse.h
+
+  Conversion of decimal and hex digits to numbers. This is the only
+  number parser: the tokenizer uses it for numbers in the program, and
+  the line editor and INPUT for numbers that are typed. Overflow is
+  always detected, whatever the width of arithmetic (see numwidth.h).
+  A decimal number must fit into the width as a positive number; a hex
+  number may use all the bits, so #FFFF is -1 if the width is 16.
+  In fixed-point mode, a decimal number may have a fraction.
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#pragma once
+
+#include "defs.h"
+#include "config.h"
+
+BEGIN_DECLS
+
+/** Convert the len decimal digits at s, which must all be digits.
+ *    Returns FALSE if the number is too large. */
+extern BOOL    numparse_decimal (const char *s, uint8_t len, VARTYPE *value);
+
+/** Convert the len hex digits at s, of either case, which must all be
+ *    hex digits. Returns FALSE if the number is too large. */
+extern BOOL    numparse_hex (const char *s, uint8_t len, VARTYPE *value);
+
+/** Convert the len characters at s, which are decimal digits, with
+ *    perhaps a point and more digits, to a fixed-point number (see
+ *    fixedpoint.h). Returns FALSE if the number is too large. */
+extern BOOL    numparse_fixed (const char *s, uint8_t len, VARTYPE *value);
+
+/** Convert the decimal number at the start of a string, such as a line
+ *    that has been typed, and set length to the number of digits,
+ *    which is zero if the string does not start with one. Anything
+ *    after the digits is ignored. Returns FALSE if the number is too
+ *    large. */
+extern BOOL    numparse_prefix (const char *s, uint8_t *length,
+                  VARTYPE *value);
+
+/** As numparse_prefix, but in fixed-point mode the number may have a
+ *    fraction, which is included in length, and the result is a
+ *    fixed-point number. */
+extern BOOL    numparse_number_prefix (const char *s, uint8_t *length,
+                  VARTYPE *value);
+
+END_DECLS
+
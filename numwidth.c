@@ -0,0 +1,35 @@
+/*===========================================================================
+
+  pmbasic
+
+  numwidth.c
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#include <stdint.h>
+#include "config.h"
+#include "defs.h"
+#include "numwidth.h"
+
+#ifdef RUNTIME_WIDTH
+uint8_t numwidth_bits = DEFAULT_WIDTH;
+uint8_t numwidth_shift = VARTYPE_BITS - DEFAULT_WIDTH;
+#endif
+
+/*===========================================================================
+  numwidth_set
+===========================================================================*/
+BOOL numwidth_set (uint8_t bits)
+  {
+#ifdef RUNTIME_WIDTH
+  if (bits != 16 && bits != 32 && bits != 64) return FALSE;
+  numwidth_bits = bits;
+  numwidth_shift = VARTYPE_BITS - bits;
+  return TRUE;
+#else
+  return bits == VARTYPE_BITS;
+#endif
+  }
+
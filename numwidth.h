@@ -0,0 +1,58 @@
+/*===========================================================================
+
+  pmbasic
+
+  numwidth.h
+
+  The width of PMBASIC's arithmetic. Without RUNTIME_WIDTH, this is just
+  the width of VARTYPE, fixed when PMBASIC is built. With RUNTIME_WIDTH
+  (the default on Linux), numbers are stored in 64 bits, but arithmetic
+  is done in 16, 32, or 64 bits, chosen with --width on the command line
+  or the WIDTH command. Every result is wrapped to the width -- only its
+  low bits are kept, and the sign extended -- so a program sees exactly
+  what it would see if VARTYPE were that wide. This means that a program
+  for the 16-bit Arduino build can be tested on Linux, and a program
+  that needs large numbers, such as milliseconds since 1970, can have
+  them. Number parsing follows the width as well.
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#pragma once
+
+#include "defs.h"
+#include "config.h"
+
+#ifdef RUNTIME_WIDTH
+extern uint8_t numwidth_bits;
+// The number of bits of a VARTYPE that are not used at the current width
+extern uint8_t numwidth_shift;
+#define NUMWIDTH_BITS numwidth_bits
+#define NUMWIDTH_SHIFT numwidth_shift
+#else
+#define NUMWIDTH_BITS VARTYPE_BITS
+#define NUMWIDTH_SHIFT 0
+#endif
+
+// Wrap n, which may be signed or unsigned, to the current width. The
+//   arithmetic should be done unsigned, so that overflow is defined
+#ifdef RUNTIME_WIDTH
+#define NUMWIDTH_WRAP(n) \
+   ((VARTYPE)((UVARTYPE)(n) << numwidth_shift) >> numwidth_shift)
+#else
+#define NUMWIDTH_WRAP(n) ((VARTYPE)(UVARTYPE)(n))
+#endif
+
+// The largest number at the current width
+#define NUMWIDTH_MAX ((UVARTYPE)~(UVARTYPE)0 >> (NUMWIDTH_SHIFT + 1))
+
+BEGIN_DECLS
+
+/** Set the width of arithmetic, in bits. Returns FALSE if the width is
+ *    not one that this build supports: 16, 32, or 64 with RUNTIME_WIDTH,
+ *    or just VARTYPE_BITS without. */
+extern BOOL    numwidth_set (uint8_t bits);
+
+END_DECLS
+
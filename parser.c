@@ -17,21 +17,85 @@
 #include "config.h"
 #include "tokenizer.h"
 #include "parser.h"
-#include "klist.h"
 #include "basicprogram.h"
 #include "strings.h"
 #include "interface.h"
 #include "variabletable.h"
+#include "stringheap.h"
 #include "errcodes.h"
+#include "profiler.h"
+#include "stats.h"
+#include "heap.h"
+#include "numparse.h"
+#include "numwidth.h"
+#include "fixedpoint.h"
+#include "mat.h"
+#include "callstack.h"
+#ifdef ARDUINO
+#include <avr/pgmspace.h>
+#define PARSER_READ_BYTE(p) pgm_read_byte (p)
+#define PARSER_READ_FUNCTION(p) ((ParserFunction)pgm_read_word (p))
+#else
+#define PROGMEM
+#define PARSER_READ_BYTE(p) (*(p))
+#define PARSER_READ_FUNCTION(p) (*(p))
+#endif
 
 /*===========================================================================
   Parser 
 ===========================================================================*/
 
+struct _Parser;
+
+// The line hook is called at the start of every numbered line. Normally
+//   it does nothing, but PROFILE swaps in a version that records timings.
+//   Using a function pointer rather than testing a flag means that the 
+//   normal case doesn't have to test anything.
+typedef void (*ParserLineHook) (struct _Parser *self, VARTYPE line);
+
+// Record the kind of statement that is executing (for the sampling 
+//   profiler) and count it (for INFO STATS). The kind is the string
+//   table index of the statement's keyword.
+#define PARSER_BEGIN_STATEMENT(index) \
+  self->current_statement = (index); \
+  STATS_COUNT_STATEMENT (index)
+
+typedef struct _LineIndexEntry 
+  {
+  VARTYPE n;
+  TokenizerPos start;
+  } LineIndexEntry;
+
+// The loop index pairs each WHILE with its WEND. Both positions are 
+//   just after the keyword
+typedef struct _LoopIndexEntry 
+  {
+  TokenizerPos start;
+  TokenizerPos end;
+  } LoopIndexEntry;
+
+// The function index holds the name of each DEF FN, and where its list
+//   of parameters starts, just after the '('. The body follows the
+//   parameters, so calling a function needs no other searching
+typedef struct _FunctionIndexEntry 
+  {
+  char name [MAX_VARIABLE_NAME + 1];
+  uint8_t len;
+  TokenizerPos params;
+  } FunctionIndexEntry;
+
+// FOR, WHILE, and REPEAT loops share a stack, so they have to nest 
+//   properly with each other. keyword says which kind of loop this is.
+//   back_pos is where the body of a FOR or REPEAT starts, or where the 
+//   condition of a WHILE starts; line is the number of the line that 
+//   started the loop
 typedef struct ForState
   {
-  const char *back_pos;
-  char *var_name;
+  TokenizerPos back_pos;
+  VARTYPE line;
+  uint8_t keyword;
+  char var_name [MAX_VARIABLE_NAME + 1];
+  uint8_t var_len;
   VARTYPE to;
   } ForState;
 
@@ -39,16 +103,30 @@ struct _Parser
   {
   const BasicProgram *bp; 
 
-  // Index mapping line numbers to offsets in program
-  KList *line_index;
+  // Index mapping line numbers to offsets in program, in program order
+  LineIndexEntry *line_index;
+  int line_index_length;
+
+  // Index of the ends of WHILE loops, in program order
+  LoopIndexEntry *loop_index;
+  int loop_index_length;
+
+  // Index of DEF FN functions, in program order
+  FunctionIndexEntry *function_index;
+  int function_index_length;
+  // The number of FN calls that are being evaluated
+  uint8_t fn_depth;
 
   VARTYPE current_line;
+  uint8_t current_statement;
   VariableTable *vt;
 
-  // Subroutine stack and its depth
-  // Note that we store the offset into the program text, not the line no. 
-  const char *gosub_stack [MAX_GOSUB_STACK_DEPTH];
-  uint8_t gosub_stack_ptr;
+  // Subroutine stack, with the locals of each subroutine. Each frame
+  //   stores the offset into the program text to return to, and the
+  //   line number of the GOSUB: RETURN can come back to the middle of a
+  //   line, so it needs to know which line that is; the sampling 
+  //   profiler also uses these to report call stacks
+  CallStack *calls;
 
   // FOR state and its depth
   ForState for_stack [MAX_FOR_STACK_DEPTH];
@@ -56,28 +134,80 @@ struct _Parser
 
   // ended is set when END is parsed
   BOOL ended;
-  };
 
-typedef struct _LineIndexEntry 
-  {
-  VARTYPE n;
-  const char *start;
-  } LineIndexEntry;
+  // Set while a line that is not part of the program is being run
+  BOOL immediate;
+
+  // The state of the RND generator, which is never zero
+  UVARTYPE rnd_state;
+
+  ParserLineHook line_hook;
+#ifdef PROFILER
+  Profiler *profiler;
+#endif
+  };
 
 static VARTYPE parser_branch_factor (Parser *self, 
          Tokenizer *t, uint8_t *error); //FWD
 static void parser_branch_statement (Parser *self, 
          Tokenizer *t, uint8_t *error); // FWD
+static BOOL parser_branch_string_expr (Parser *self, Tokenizer *t, 
+         const StringHandle *target, StringView *out, 
+         uint8_t *error); // FWD
+static VARTYPE parser_branch_fn (Parser *self, 
+         Tokenizer *t, uint8_t *error); // FWD
+
+#ifdef STATIC_POOLS
+static LineIndexEntry parser_line_index_pool [POOL_LINES];
+static LoopIndexEntry parser_loop_index_pool [POOL_LOOPS];
+static FunctionIndexEntry parser_function_index_pool [POOL_FUNCTIONS];
+#endif
+
+#ifdef SAMPLER
+// The parser that is currently running a program, if any. This is 
+//   read by the sampling profiler's signal handler
+static const Parser * volatile parser_active = NULL;
+#endif
+
+// The first state of the RND generator. Any odd number will do
+#define PARSER_RND_SEED 2463534243U
+
+/*===========================================================================
+  parser_line_hook_none
+===========================================================================*/
+static void parser_line_hook_none (Parser *self, VARTYPE line)
+  {
+  (void)self;
+  (void)line;
+  }
 
 /*===========================================================================
   parser_new
 ===========================================================================*/
 Parser *parser_new (void)
   {
-  Parser *self = malloc (sizeof (Parser));
+  Parser *self = HEAP_MALLOC (HEAP_SITE_PARSER, sizeof (Parser));
   if (self)
     {
+    self->calls = callstack_new ();
+    if (!self->calls)
+      {
+      HEAP_FREE (HEAP_SITE_PARSER, self);
+      return NULL;
+      }
     self->line_index = NULL;
+    self->line_index_length = 0;
+    self->loop_index = NULL;
+    self->loop_index_length = 0;
+    self->function_index = NULL;
+    self->function_index_length = 0;
+    self->fn_depth = 0;
+    self->immediate = FALSE;
+    self->line_hook = parser_line_hook_none;
+    self->rnd_state = PARSER_RND_SEED;
+#ifdef PROFILER
+    self->profiler = NULL;
+#endif
     }
   return self;
   }
@@ -87,11 +217,26 @@ Parser *parser_new (void)
 ===========================================================================*/
 static void parser_clear_line_index (Parser *self)
   {
+#ifndef STATIC_POOLS
   if (self->line_index)
     {
-    klist_destroy (self->line_index);
+    HEAP_FREE (HEAP_SITE_LINE_INDEX, self->line_index);
     }
+  if (self->loop_index)
+    {
+    HEAP_FREE (HEAP_SITE_LINE_INDEX, self->loop_index);
+    }
+  if (self->function_index)
+    {
+    HEAP_FREE (HEAP_SITE_LINE_INDEX, self->function_index);
+    }
+#endif
   self->line_index = NULL;
+  self->line_index_length = 0;
+  self->loop_index = NULL;
+  self->loop_index_length = 0;
+  self->function_index = NULL;
+  self->function_index_length = 0;
   }
 
 /*===========================================================================
@@ -100,7 +245,8 @@ static void parser_clear_line_index (Parser *self)
 void parser_destroy (Parser *self)
   {
   parser_clear_line_index (self);
-  free (self);
+  callstack_destroy (self->calls);
+  HEAP_FREE (HEAP_SITE_PARSER, self);
   }
 
 /*===========================================================================
@@ -109,35 +255,25 @@ void parser_destroy (Parser *self)
 typedef struct 
   {
   Parser *self;
-  uint8_t error;
+  int count;
   } ILI;
 
 static BOOL parser_iterate_lines_for_index (const BasicProgram *self, 
-                 const char *b, const char *e, void *user_data)
+                 VARTYPE line, TokenizerPos b, TokenizerPos e, 
+                 void *user_data)
   {
   (void)self;
   (void)e;
-  BOOL ret = FALSE;
-  VARTYPE n;
-  BOOL gotnum = basicprogram_get_line_number (b, &n);
-  if (gotnum)
-    {
-    LineIndexEntry *lie = malloc (sizeof (LineIndexEntry));
-    if (lie)
-      {
-      lie->n = n;
-      lie->start = b;
-      klist_append (((ILI *)user_data)->self->line_index, lie);
-      ret = TRUE;
-      }
-    else
-      ((ILI *)user_data)->error = BASIC_ERR_NOMEM; 
-    }
-  else
+  // On the first pass there is no index yet, and we just count lines
+  ILI *ili = (ILI *)user_data;
+  if (ili->self->line_index)
     {
-    ((ILI *)user_data)->error = BASIC_ERR_NO_LINE_NUM; 
+    LineIndexEntry *lie = &ili->self->line_index [ili->count];
+    lie->n = line;
+    lie->start = b;
     }
-  return ret;
+  ili->count++;
+  return TRUE;
   }
 
 /*===========================================================================
@@ -145,11 +281,10 @@ static BOOL parser_iterate_lines_for_index (const BasicProgram *self,
 ===========================================================================*/
 void parser_dump_line_index (const Parser *self)
   {
-  int l = klist_length (self->line_index);
-  for (int i = 0; i < l; i++)
+  for (int i = 0; i < self->line_index_length; i++)
     {
-    const LineIndexEntry *lie = klist_get (self->line_index, i);
-    printf ("n=" PRINTF_DEC " pos=%s\n", lie->n, lie->start);
+    const LineIndexEntry *lie = &self->line_index [i];
+    printf ("n=" PRINTF_DEC " pos=%d\n", lie->n, (int)lie->start);
     }
   }
 
@@ -161,22 +296,30 @@ static BOOL parser_index_lines (Parser *self,
   {
   BOOL ret = FALSE;
 
-  if (self->line_index)
-    parser_clear_line_index (self);
+  parser_clear_line_index (self);
 
-  self->line_index = klist_new_empty (free);
+  // Count the lines, so the index can be allocated in one piece, then
+  //   go round again to fill it in
+  ILI ili;
+  ili.count = 0;
+  ili.self = self;
+  basicprogram_iterate_lines (self->bp, 
+     parser_iterate_lines_for_index, &ili);
+
+#ifdef STATIC_POOLS
+  if (ili.count <= POOL_LINES)
+    self->line_index = parser_line_index_pool;
+#else
+  self->line_index = HEAP_MALLOC (HEAP_SITE_LINE_INDEX, 
+    (ili.count ? ili.count : 1) * sizeof (LineIndexEntry));
+#endif
   if (self->line_index)
     {
-    ILI ili;
-    ili.error = 0;
-    ili.self = self;
+    ili.count = 0;
     basicprogram_iterate_lines (self->bp, 
        parser_iterate_lines_for_index, &ili);
-
-    if (ili.error == 0)
-      ret = TRUE;
-    else
-      *err_code = ili.error;
+    self->line_index_length = ili.count;
+    ret = TRUE;
     }
   else
     *err_code = BASIC_ERR_NOMEM;
@@ -186,6 +329,284 @@ static BOOL parser_index_lines (Parser *self,
   return ret;
   }
 
+/*===========================================================================
+  parser_new_tokenizer
+  The program might not be in RAM, in which case the tokenizer has to
+    read it through the program's fetch function
+===========================================================================*/
+static Tokenizer *parser_new_tokenizer (const Parser *self)
+  {
+  const void *source;
+  TokenizerFetch fetch = basicprogram_get_fetch (self->bp, &source);
+  if (fetch)
+    return tokenizer_new_fetch (fetch, source);
+  return tokenizer_new (basicprogram_c_str (self->bp));
+  }
+
+/*===========================================================================
+  parser_scan_loops
+  Go through the program, pairing each WEND with the last WHILE before
+    it that is not already paired, and return the number of WHILEs.
+    If index is not NULL, it is filled in as well. If the loops don't 
+    pair up, the error is set, and current_line is the line where the 
+    problem is. When the WHILEs that are left over at the end were 
+    opened, there was no other WHILE open, so the first of them is the
+    outermost.
+===========================================================================*/
+static int parser_scan_loops (Parser *self, LoopIndexEntry *index, 
+              uint8_t *err_code)
+  {
+  int count = 0;
+  int open = 0;
+  VARTYPE open_line = 0;
+  uint8_t error = 0;
+  Tokenizer *t = parser_new_tokenizer (self);
+  tokenizer_set_line_pos (t, 0);
+  tokenizer_next (t, &error);
+  while (!tokenizer_finished (t) && !*err_code)
+    {
+    uint8_t keyword = tokenizer_get_keyword (t);
+    if (error || keyword == STRING_INDEX_REM)
+      {
+      // A line that can't be tokenized will stop the program when it
+      //   runs, so there's no need to report it now
+      error = 0;
+      tokenizer_skip_line (t);
+      }
+    else if (keyword == STRING_INDEX_WHILE)
+      {
+      if (open++ == 0) open_line = tokenizer_get_line (t);
+      if (index)
+        {
+        index[count].start = tokenizer_get_pos (t);
+        index[count].end = 0;
+        }
+      count++;
+      }
+    else if (keyword == STRING_INDEX_WEND)
+      {
+      if (open == 0)
+        {
+        self->current_line = tokenizer_get_line (t);
+        *err_code = BASIC_ERR_WEND_WITHOUT_WHILE;
+        }
+      else
+        {
+        open--;
+        if (index)
+          {
+          int i = count - 1;
+          while (index[i].end) i--;
+          index[i].end = tokenizer_get_pos (t);
+          }
+        }
+      }
+    tokenizer_next (t, &error);
+    }
+  tokenizer_destroy (t);
+  if (open > 0 && !*err_code)
+    {
+    self->current_line = open_line;
+    *err_code = BASIC_ERR_WHILE_WITHOUT_WEND;
+    }
+  return count;
+  }
+
+/*===========================================================================
+  parser_index_loops
+  Pair up the WHILEs and WENDs, once, before the program runs. Going 
+    round a loop then needs no searching at all -- a WEND knows where its
+    WHILE is from the loop stack, and where it is itself -- and the 
+    index is only looked at when a WHILE's condition is false to begin 
+    with.
+===========================================================================*/
+static BOOL parser_index_loops (Parser *self, uint8_t *err_code)
+  {
+  int count = parser_scan_loops (self, NULL, err_code);
+  if (*err_code || count == 0) return *err_code == 0;
+
+#ifdef STATIC_POOLS
+  if (count <= POOL_LOOPS)
+    self->loop_index = parser_loop_index_pool;
+#else
+  self->loop_index = HEAP_MALLOC (HEAP_SITE_LINE_INDEX, 
+    count * sizeof (LoopIndexEntry));
+#endif
+  if (!self->loop_index)
+    {
+    *err_code = BASIC_ERR_NOMEM;
+    return FALSE;
+    }
+  parser_scan_loops (self, self->loop_index, err_code);
+  self->loop_index_length = count;
+  return TRUE;
+  }
+
+/*===========================================================================
+  parser_loop_end
+  Find the end of the WHILE loop whose condition starts at pos. The 
+    index is in program order, so this is a binary search.
+===========================================================================*/
+static BOOL parser_loop_end (const Parser *self, TokenizerPos pos, 
+              TokenizerPos *end)
+  {
+  int lo = 0;
+  int hi = self->loop_index_length - 1;
+  while (lo <= hi)
+    {
+    int mid = (lo + hi) / 2;
+    const LoopIndexEntry *lie = &self->loop_index [mid];
+    if (lie->start == pos)
+      {
+      *end = lie->end;
+      return TRUE;
+      }
+    if (lie->start < pos)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+    }
+  return FALSE;
+  }
+
+/*===========================================================================
+  parser_find_function
+  Returns NULL if there is no function called name
+===========================================================================*/
+static const FunctionIndexEntry *parser_find_function (const Parser *self, 
+              const char *name, uint8_t len)
+  {
+  for (int i = 0; i < self->function_index_length; i++)
+    {
+    const FunctionIndexEntry *fie = &self->function_index [i];
+    if (fie->len == len && memcmp (fie->name, name, len) == 0) 
+      return fie;
+    }
+  return NULL;
+  }
+
+/*===========================================================================
+  parser_scan_function
+  On entry, the tokenizer is over a DEF. Check that FN, the name and 
+    the '(' follow it, and fill in the entry, if there is one.
+===========================================================================*/
+static void parser_scan_function (Tokenizer *t, FunctionIndexEntry *fie,
+              uint8_t *error)
+  {
+  tokenizer_next (t, error); // Skip DEF
+  if (*error) return;
+  if (!tokenizer_is_keyword (t, STRING_INDEX_FN))
+    {
+    *error = BASIC_ERR_SYNTAX;
+    return;
+    }
+  tokenizer_next (t, error); // Skip FN
+  if (*error) return;
+  if (!tokenizer_is_word (t))
+    {
+    *error = BASIC_ERR_KW_NO_VAR;
+    return;
+    }
+  uint8_t len;
+  const char *name = tokenizer_get_word (t, &len);
+  if (len > MAX_VARIABLE_NAME)
+    {
+    *error = BASIC_ERR_NAME_TOO_LONG;
+    return;
+    }
+  if (name[len - 1] == '$')
+    {
+    *error = BASIC_ERR_TYPE_MISMATCH;
+    return;
+    }
+  if (fie)
+    {
+    memcpy (fie->name, name, len);
+    fie->name[len] = 0;
+    fie->len = len;
+    }
+  tokenizer_next (t, error); // Skip the name
+  if (*error) return;
+  if (!tokenizer_is_symbol (t, '('))
+    {
+    *error = BASIC_ERR_UNEXPECTED_TOKEN;
+    return;
+    }
+  if (fie) fie->params = tokenizer_get_pos (t);
+  }
+
+/*===========================================================================
+  parser_scan_functions
+  Go through the program, finding the DEF FN functions, and return the 
+    number of them. If there is an index, fill it in, and check that 
+    no function is defined twice. If there is an error, current_line is
+    the line where it is.
+===========================================================================*/
+static int parser_scan_functions (Parser *self, FunctionIndexEntry *index,
+              uint8_t *err_code)
+  {
+  int count = 0;
+  uint8_t error = 0;
+  Tokenizer *t = parser_new_tokenizer (self);
+  tokenizer_set_line_pos (t, 0);
+  tokenizer_next (t, &error);
+  while (!tokenizer_finished (t) && !*err_code)
+    {
+    uint8_t keyword = tokenizer_get_keyword (t);
+    if (error || keyword == STRING_INDEX_REM)
+      {
+      error = 0;
+      tokenizer_skip_line (t);
+      }
+    else if (keyword == STRING_INDEX_DEF)
+      {
+      VARTYPE line = tokenizer_get_line (t);
+      FunctionIndexEntry *fie = index ? &index[count] : NULL;
+      parser_scan_function (t, fie, err_code);
+      if (!*err_code && fie && parser_find_function (self, fie->name, 
+            fie->len))
+        *err_code = BASIC_ERR_FN_DEFINED;
+      if (*err_code) 
+        self->current_line = line;
+      else if (index) 
+        self->function_index_length = ++count;
+      else
+        count++;
+      }
+    tokenizer_next (t, &error);
+    }
+  tokenizer_destroy (t);
+  return count;
+  }
+
+/*===========================================================================
+  parser_index_functions
+  Find all the DEF FN functions, once, before the program runs, so 
+    that an FN can go straight to the body of its function.
+===========================================================================*/
+static BOOL parser_index_functions (Parser *self, uint8_t *err_code)
+  {
+  int count = parser_scan_functions (self, NULL, err_code);
+  if (*err_code || count == 0) return *err_code == 0;
+
+#ifdef STATIC_POOLS
+  if (count <= POOL_FUNCTIONS)
+    self->function_index = parser_function_index_pool;
+#else
+  self->function_index = HEAP_MALLOC (HEAP_SITE_LINE_INDEX, 
+    count * sizeof (FunctionIndexEntry));
+#endif
+  if (!self->function_index)
+    {
+    *err_code = BASIC_ERR_NOMEM;
+    return FALSE;
+    }
+  // The entries are counted in as they are filled in, so that each 
+  //   new one can be checked against the ones before it
+  parser_scan_functions (self, self->function_index, err_code);
+  return *err_code == 0;
+  }
+
 /*===========================================================================
   parser_emit_if_error
 ===========================================================================*/
@@ -197,11 +618,18 @@ void parser_emit_if_error (const Parser *self,
     strings_output_string (error);
     interface_output_string (", line: ");
     interface_output_number (self->current_line);
-    const char *word = tokenizer_get_word (t);
-    if (word[0])
+    uint8_t len;
+    const char *word = tokenizer_get_word (t, &len);
+    uint8_t keyword = tokenizer_get_keyword (t);
+    if (keyword)
       {
       interface_output_string (" near: ");
-      interface_output_string (word);
+      strings_output_string (keyword);
+      }
+    else if (len)
+      {
+      interface_output_string (" near: ");
+      interface_output_chars (word, len);
       }
     interface_output_endl();
     }
@@ -212,15 +640,20 @@ void parser_emit_if_error (const Parser *self,
 ===========================================================================*/
 BOOL parser_set_program (Parser *self, const BasicProgram *bp)
   {
-  static char buff[30];
   self->bp = bp;
   self->current_line = 0;
   uint8_t err_code = 0;
-  parser_index_lines (self, &err_code);
+  if (parser_index_lines (self, &err_code)
+      && parser_index_loops (self, &err_code))
+    parser_index_functions (self, &err_code);
   if (err_code)
     {
-    strings_get (err_code + STRINGS_FIRST_ERR_CODE, buff, MAX_LINE);  
-    interface_output_string (buff);
+    strings_output_string (err_code + STRINGS_FIRST_ERR_CODE);
+    if (self->current_line)
+      {
+      interface_output_string (", line: ");
+      interface_output_number (self->current_line);
+      }
     interface_output_endl();
     }
   return (err_code == 0);
@@ -256,16 +689,36 @@ static VARTYPE parser_branch_term (Parser *self,
     tokenizer_next (t, error);
     VARTYPE t2 = parser_branch_factor (self, t, error);
     if (*error) return 0;
+    STATS_COUNT_OPERATOR (op);
+    // The arithmetic is done unsigned, so that overflow is defined,
+    //   and wraps around at the current width
     switch (op)
       {
-      case '*': t1 *= t2; break; 
+      case '*': 
+#ifdef FIXED_POINT
+        if (FIXEDPOINT_ON)
+          t1 = fixedpoint_mul (t1, t2);
+        else
+#endif
+          t1 = NUMWIDTH_WRAP ((UVARTYPE)t1 * (UVARTYPE)t2); 
+        break; 
       case '/': 
         if (t2 == 0)
           {
           *error = BASIC_ERR_DIV_ZERO;
           return 0;
           }
-        t1 /= t2;
+#ifdef FIXED_POINT
+        if (FIXEDPOINT_ON)
+          t1 = fixedpoint_div (t1, t2);
+        else
+#endif
+        // The most negative number divided by -1 overflows, which C
+        //   does not allow
+        if (t2 == -1)
+          t1 = NUMWIDTH_WRAP (0 - (UVARTYPE)t1);
+        else
+          t1 /= t2;
         break;
       case '%': 
         if (t2 == 0)
@@ -273,7 +726,10 @@ static VARTYPE parser_branch_term (Parser *self,
           *error = BASIC_ERR_DIV_ZERO;
           return 0;
           }
-        t1 %= t2;
+        if (t2 == -1)
+          t1 = 0;
+        else
+          t1 %= t2;
         break;
       }
     op = tokenizer_get_sym (t);
@@ -287,31 +743,31 @@ static VARTYPE parser_branch_term (Parser *self,
 static VARTYPE parser_branch_expr (Parser *self, 
          Tokenizer *t, uint8_t *error)
   {
-  if (tokenizer_is_word (t))
+  if (tokenizer_is_keyword (t, STRING_INDEX_NOT))
     {
-    const char *word = tokenizer_get_word (t);
-    if (strings_compare_index (word, STRING_INDEX_NOT))
-      {
-      tokenizer_next (t, error);
-      return !parser_branch_expr (self, t, error); 
-      }
+    tokenizer_next (t, error);
+    STATS_COUNT_UNARY (STATS_OP_NOT);
+    return FIXEDPOINT_FROM_INT (!parser_branch_expr (self, t, error)); 
     }
 
   VARTYPE t1 = parser_branch_term (self, t, error); 
+  if (*error) return 0;
   char op = tokenizer_get_sym (t);
   while (op == '+' || op == '-' || op == '&' || op == '|' || op == '<' 
           || op == '>' || op == '=') 
     {
     tokenizer_next (t, error);
     VARTYPE t2 = parser_branch_term (self, t, error);
+    if (*error) return 0;
+    STATS_COUNT_OPERATOR (op);
     switch (op)
        {
-       case '+': t1 += t2; break;
-       case '-': t1 -= t2; break;
+       case '+': t1 = NUMWIDTH_WRAP ((UVARTYPE)t1 + (UVARTYPE)t2); break;
+       case '-': t1 = NUMWIDTH_WRAP ((UVARTYPE)t1 - (UVARTYPE)t2); break;
        case '&': t1 &= t2; break;
-       case '<': t1 = (t1 < t2); break;
-       case '>': t1 = (t1 > t2); break;
-       case '=': t1 = (t1 == t2); break;
+       case '<': t1 = FIXEDPOINT_FROM_INT (t1 < t2); break;
+       case '>': t1 = FIXEDPOINT_FROM_INT (t1 > t2); break;
+       case '=': t1 = FIXEDPOINT_FROM_INT (t1 == t2); break;
        case '|': t1 |= t2; break;
        } 
     op = tokenizer_get_sym (t);
@@ -320,101 +776,948 @@ static VARTYPE parser_branch_expr (Parser *self,
   }
 
 /*===========================================================================
-  parser_branch_factor
+  parser_branch_int_expr
+  Evaluate an expression that must be a whole number, such as a line
+    number or a subscript. In fixed-point mode, the fraction is dropped.
 ===========================================================================*/
-static VARTYPE parser_branch_factor (Parser *self, 
+static VARTYPE parser_branch_int_expr (Parser *self, 
          Tokenizer *t, uint8_t *error)
   {
-  if (tokenizer_is_number (t))
-    {
-    VARTYPE r = tokenizer_get_number_value (t);
-    tokenizer_next (t, error);
-    return r;
-    }
-  else if (tokenizer_is_symbol (t, '-'))
-    {
-    tokenizer_next (t, error);
-    return -parser_branch_factor (self, t, error);
-    }
-  else if (tokenizer_is_symbol (t, '('))
+  VARTYPE r = parser_branch_expr (self, t, error);
+  return FIXEDPOINT_TO_INT (r);
+  }
+
+/*===========================================================================
+  parser_branch_array
+  On entry, the tokenizer should be over the name of an array. Returns
+    its elements, and sets its bound, or returns NULL if there is an
+    error.
+===========================================================================*/
+static VARTYPE *parser_branch_array (Parser *self, 
+         Tokenizer *t, UVARTYPE *bound, uint8_t *error)
+  {
+  if (!tokenizer_is_word (t))
     {
-    tokenizer_next (t, error);
-    if (*error) return 0;
-    VARTYPE r = parser_branch_expr (self, t, error);
-    parser_accept_symbol (self, t, ')', error);
-    if (*error) return 0;
-    return r;
+    *error = BASIC_ERR_SYNTAX;
+    return NULL;
     }
-  else if (tokenizer_is_word (t))
-    {
-    VARTYPE r = 0;
-    if (!variabletable_get_number (self->vt, tokenizer_get_word (t), &r))
-      {
-      strings_output_string (BASIC_ERR_UNDEFINED_VAR);
-      interface_output_string (": ");
-      interface_output_string (": ");
-      interface_output_string (tokenizer_get_word (t));
-      interface_output_endl ();
-      *error = BASIC_ERR_UNDEFINED_VAR; 
-      }
-    tokenizer_next (t, error);
-    return r;
-    } 
-  else
+  uint8_t len;
+  const char *word = tokenizer_get_word (t, &len);
+  VARTYPE *elements = variabletable_get_array (self->vt, word, len, bound);
+  if (!elements)
     {
-    *error = BASIC_ERR_SYNTAX;
-    return 0;;
+    *error = BASIC_ERR_UNDEFINED_ARRAY;
+    return NULL;
     }
+  tokenizer_next (t, error); // Skip the name 
+  if (*error) return NULL;
+  return elements;
   }
 
 /*===========================================================================
-  parser_skip_to_next_line
+  parser_branch_element
+  On entry, the tokenizer is over the name of an array, and the next
+    character is the (. Returns the element, having checked the 
+    subscript, or NULL if there is an error.
 ===========================================================================*/
-static void parser_skip_to_next_line (Parser *self, 
+static VARTYPE *parser_branch_element (Parser *self, 
          Tokenizer *t, uint8_t *error)
   {
-  (void)self;
-  do
-    {
-    tokenizer_next (t, error);
-    } while (!tokenizer_is_eol (t)); 
-  // Don't skip the \n -- the main parser loop always advances one
-  //  token after the numbered-statement branch. This skips the \n, so
-  //  if we skip here as well, we'll skip the line number
-  //tokenizer_next (t, error);
+  UVARTYPE bound;
+  VARTYPE *elements = parser_branch_array (self, t, &bound, error);
+  if (*error) return NULL;
+  tokenizer_next (t, error); // Skip (
+  if (*error) return NULL;
+  VARTYPE i = parser_branch_int_expr (self, t, error);
+  if (*error) return NULL;
+  parser_accept_symbol (self, t, ')', error);
+  if (*error) return NULL;
+  // A negative subscript becomes a very large one, so one test 
+  //   checks both ends of the range
+  if ((UVARTYPE)i > bound)
+    {
+    *error = BASIC_ERR_BAD_SUBSCRIPT;
+    return NULL;
+    }
+  return elements + i;
   }
 
 /*===========================================================================
-  parser_branch_print_statement
+  parser_is_string_name
+  String variables have names that end in $
 ===========================================================================*/
-static void parser_branch_print_statement (Parser *self, 
-         Tokenizer *t, uint8_t *error)
+static BOOL parser_is_string_name (const char *name, uint8_t len)
   {
-  tokenizer_next (t, error);
-  if (*error) return;
+  return len > 0 && name[len - 1] == '$';
+  }
 
-  if (tokenizer_is_eol (t)) 
+/*===========================================================================
+  parser_is_string_start
+  Test whether the current token starts a string expression
+===========================================================================*/
+static BOOL parser_is_string_start (const Tokenizer *t)
+  {
+  if (tokenizer_is_string (t)) return TRUE;
+  if (tokenizer_is_word (t))
     {
-    interface_output_endl();
-    return;
+    uint8_t len;
+    const char *word = tokenizer_get_word (t, &len);
+    return parser_is_string_name (word, len);
     }
+  uint8_t keyword = tokenizer_get_keyword (t);
+  return keyword == STRING_INDEX_LEFT || keyword == STRING_INDEX_RIGHT
+    || keyword == STRING_INDEX_MID;
+  }
 
-  BOOL no_newline = FALSE;
- 
-  // PRINT prints all its arguments, and doesn't know in advance
-  //  how many. So what if it comes across ELSE? Most keywords will
-  //  just cause a stop. But ELSE is legitimate in situations like
-  //  IF foo THEN print 1 2 3 ELSE... So, lacking any better ideas,
-  //  the program just skips to the end of line on an ELSE.
-  do
+/*===========================================================================
+  parser_clamp
+  Limit a count or position given in the program to the range 0-max
+===========================================================================*/
+static uint16_t parser_clamp (VARTYPE n, uint16_t max)
+  {
+  if (n < 0) return 0;
+  if ((UVARTYPE)n > max) return max;
+  return (uint16_t)n;
+  }
+
+/*===========================================================================
+  parser_branch_string_literal
+  Returns TRUE if the literal had to be copied into a new value
+===========================================================================*/
+static BOOL parser_branch_string_literal (Parser *self, 
+         Tokenizer *t, StringView *out, uint8_t *error)
+  {
+  StringHeap *heap = variabletable_get_string_heap (self->vt);
+  uint8_t len;
+  const char *s = tokenizer_get_string (t, &len);
+  BOOL fresh = FALSE;
+  if (tokenizer_text_is_stable (t) && !memchr (s, '\"', len))
+    {
+    // The usual case: just point to the text in the program
+    out->data = s;
+    out->length = len;
+    }
+  else
     {
-    if (tokenizer_is_string (t))
+    // Escaped quotes have to be decoded, and text that the tokenizer
+    //   has fetched is replaced by the next token, so make a copy
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < len; i++, n++)
+      if (s[i] == '\"') i++;
+    char *text = stringheap_new_value (heap, out, n, error);
+    if (!text) return FALSE;
+    for (uint8_t i = 0; i < len; i++)
       {
-      const char *string = tokenizer_get_string (t);
-      interface_output_string (string);
-      tokenizer_next (t, error);
+      *text++ = s[i];
+      if (s[i] == '\"') i++;
       }
-    else if (tokenizer_is_symbol (t, ','))
+    fresh = TRUE;
+    }
+  stringheap_protect (heap, out, error);
+  if (*error) return FALSE;
+  tokenizer_next (t, error);
+  return fresh;
+  }
+
+/*===========================================================================
+  parser_branch_string_function
+  LEFT$(s, n)
+  RIGHT$(s, n)
+  MID$(s, start [, n])
+  The result is a view of part of s, so nothing is copied. Returns TRUE 
+    if the result is the start of a new value.
+===========================================================================*/
+static BOOL parser_branch_string_function (Parser *self, 
+         Tokenizer *t, uint8_t keyword, StringView *out, uint8_t *error)
+  {
+  tokenizer_next (t, error); // Skip the keyword
+  if (*error) return FALSE;
+  parser_accept_symbol (self, t, '(', error);
+  if (*error) return FALSE;
+  BOOL fresh = parser_branch_string_expr (self, t, NULL, out, error);
+  if (*error) return FALSE;
+  parser_accept_symbol (self, t, ',', error);
+  if (*error) return FALSE;
+  VARTYPE n = parser_branch_int_expr (self, t, error);
+  if (*error) return FALSE;
+  VARTYPE count = out->length;
+  if (keyword == STRING_INDEX_MID && tokenizer_is_symbol (t, ','))
+    {
+    tokenizer_next (t, error);
+    if (*error) return FALSE;
+    count = parser_branch_int_expr (self, t, error);
+    if (*error) return FALSE;
+    }
+  parser_accept_symbol (self, t, ')', error);
+  if (*error) return FALSE;
+
+  uint16_t start = 0;
+  uint16_t length = out->length;
+  switch (keyword)
+    {
+    case STRING_INDEX_LEFT:
+      length = parser_clamp (n, length);
+      break;
+    case STRING_INDEX_RIGHT:
+      length = parser_clamp (n, length);
+      start = out->length - length;
+      break;
+    default:
+      // Positions in MID$ count from 1
+      start = parser_clamp (n - 1, length);
+      length = parser_clamp (count, length - start);
+    }
+  if (start) out->data += start;
+  out->length = length;
+  return fresh && start == 0;
+  }
+
+/*===========================================================================
+  parser_branch_string_term
+  Evaluate a single string -- a literal, a variable, or a function -- 
+    into out, which is protected. Returns TRUE if out is the start of a
+    new value, which can be added to without copying it.
+===========================================================================*/
+static BOOL parser_branch_string_term (Parser *self, 
+         Tokenizer *t, StringView *out, uint8_t *error)
+  {
+  if (tokenizer_is_string (t))
+    return parser_branch_string_literal (self, t, out, error);
+
+  uint8_t keyword = tokenizer_get_keyword (t);
+  if (keyword == STRING_INDEX_LEFT || keyword == STRING_INDEX_RIGHT
+       || keyword == STRING_INDEX_MID)
+    return parser_branch_string_function (self, t, keyword, out, error);
+
+  uint8_t len;
+  const char *word = tokenizer_get_word (t, &len);
+  if (!tokenizer_is_word (t) || !parser_is_string_name (word, len))
+    {
+    *error = BASIC_ERR_TYPE_MISMATCH;
+    return FALSE;
+    }
+  const StringHandle *handle = variabletable_get_string (self->vt, word, len);
+  if (!handle)
+    {
+    *error = BASIC_ERR_UNDEFINED_VAR;
+    return FALSE;
+    }
+  StringHeap *heap = variabletable_get_string_heap (self->vt);
+  stringheap_get (heap, *handle, out);
+  stringheap_protect (heap, out, error);
+  if (*error) return FALSE;
+  tokenizer_next (t, error);
+  return FALSE;
+  }
+
+/*===========================================================================
+  parser_branch_string_expr
+  Evaluate a string expression, which is one or more strings joined by
+    +, into out, which is protected. If target is not NULL, it is the
+    variable that the result will be assigned to. Returns TRUE if out is
+    a new value, or target's own value extended in place, that can be 
+    committed to target without copying it.
+===========================================================================*/
+static BOOL parser_branch_string_expr (Parser *self, Tokenizer *t, 
+         const StringHandle *target, StringView *out, uint8_t *error)
+  {
+  BOOL fresh = parser_branch_string_term (self, t, out, error);
+  if (*error || !tokenizer_is_symbol (t, '+')) return fresh;
+
+  StringHeap *heap = variabletable_get_string_heap (self->vt);
+  if (!fresh)
+    {
+    stringheap_begin (heap, out, target, error);
+    if (*error) return FALSE;
+    }
+  while (tokenizer_is_symbol (t, '+'))
+    {
+    tokenizer_next (t, error);
+    if (*error) return FALSE;
+    uint8_t mark = stringheap_mark (heap);
+    StringView piece;
+    parser_branch_string_term (self, t, &piece, error);
+    if (!*error) stringheap_append (heap, out, &piece, error);
+    stringheap_release (heap, mark);
+    if (*error) return FALSE;
+    }
+  return TRUE;
+  }
+
+/*===========================================================================
+  parser_compare_strings
+===========================================================================*/
+static int parser_compare_strings (const StringView *a, const StringView *b)
+  {
+  uint16_t n = a->length < b->length ? a->length : b->length;
+  int c = n ? memcmp (a->data, b->data, n) : 0;
+  if (c == 0) c = (int)a->length - (int)b->length;
+  return c;
+  }
+
+/*===========================================================================
+  parser_branch_string_compare
+  a$ = b$, a$ < b$, a$ > b$, which are numbers, like any other comparison
+===========================================================================*/
+static VARTYPE parser_branch_string_compare (Parser *self, 
+         Tokenizer *t, uint8_t *error)
+  {
+  StringHeap *heap = variabletable_get_string_heap (self->vt);
+  uint8_t mark = stringheap_mark (heap);
+  StringView a, b;
+  VARTYPE r = 0;
+  parser_branch_string_expr (self, t, NULL, &a, error);
+  char op = tokenizer_get_sym (t);
+  if (*error)
+    ;
+  else if (op == '=' || op == '<' || op == '>')
+    {
+    tokenizer_next (t, error);
+    if (!*error)
+      parser_branch_string_expr (self, t, NULL, &b, error);
+    if (!*error)
+      {
+      STATS_COUNT_OPERATOR (op);
+      int c = parser_compare_strings (&a, &b);
+      r = FIXEDPOINT_FROM_INT ((op == '=') ? (c == 0) 
+        : (op == '<') ? (c < 0) : (c > 0));
+      }
+    }
+  else
+    *error = BASIC_ERR_TYPE_MISMATCH;
+  stringheap_release (heap, mark);
+  return r;
+  }
+
+/*===========================================================================
+  parser_branch_len
+  LEN(s)
+===========================================================================*/
+static VARTYPE parser_branch_len (Parser *self, 
+         Tokenizer *t, uint8_t *error)
+  {
+  tokenizer_next (t, error); // Skip LEN
+  if (*error) return 0;
+  parser_accept_symbol (self, t, '(', error);
+  if (*error) return 0;
+  StringHeap *heap = variabletable_get_string_heap (self->vt);
+  uint8_t mark = stringheap_mark (heap);
+  StringView s;
+  parser_branch_string_expr (self, t, NULL, &s, error);
+  stringheap_release (heap, mark);
+  if (*error) return 0;
+  parser_accept_symbol (self, t, ')', error);
+  return FIXEDPOINT_FROM_INT (s.length);
+  }
+
+/*===========================================================================
+  Functions
+  Each function gets its arguments, already evaluated, in args. The
+    functions are numbered: first the keywords from ABS to RND, in the
+    order of the string table, and then MILLIS and PEEK, which are
+    also statements. The number is the index into parser_functions,
+    so calling a function is just a look-up, however many there are.
+===========================================================================*/
+typedef VARTYPE (*ParserFunction) (Parser *self, const VARTYPE *args,
+         uint8_t *error);
+
+typedef struct _ParserFunctionDef
+  {
+  ParserFunction function;
+  uint8_t args; // The number of arguments, all of which are required
+  } ParserFunctionDef;
+
+#define PARSER_MAX_ARGS 2
+// The largest number of arguments that a DEF FN can take
+#define PARSER_MAX_FN_ARGS 4
+#define PARSER_FN_MILLIS (STRING_INDEX_RND - STRING_INDEX_ABS + 1)
+#define PARSER_FN_PEEK (PARSER_FN_MILLIS + 1)
+#define PARSER_FN_NONE 0xFF
+
+/*===========================================================================
+  parser_fn_abs
+  The most negative number has no positive counterpart, and stays as
+    it is, like -x
+===========================================================================*/
+static VARTYPE parser_fn_abs (Parser *self, const VARTYPE *args,
+         uint8_t *error)
+  {
+  (void)self;
+  (void)error;
+  return args[0] < 0 ? NUMWIDTH_WRAP (0 - (UVARTYPE)args[0]) : args[0];
+  }
+
+/*===========================================================================
+  parser_fn_min
+===========================================================================*/
+static VARTYPE parser_fn_min (Parser *self, const VARTYPE *args,
+         uint8_t *error)
+  {
+  (void)self;
+  (void)error;
+  return args[0] < args[1] ? args[0] : args[1];
+  }
+
+/*===========================================================================
+  parser_fn_max
+===========================================================================*/
+static VARTYPE parser_fn_max (Parser *self, const VARTYPE *args,
+         uint8_t *error)
+  {
+  (void)self;
+  (void)error;
+  return args[0] > args[1] ? args[0] : args[1];
+  }
+
+/*===========================================================================
+  parser_fn_sgn
+===========================================================================*/
+static VARTYPE parser_fn_sgn (Parser *self, const VARTYPE *args,
+         uint8_t *error)
+  {
+  (void)self;
+  (void)error;
+  return FIXEDPOINT_FROM_INT ((args[0] > 0) - (args[0] < 0));
+  }
+
+/*===========================================================================
+  parser_fn_sqr
+  The square root, rounded down, worked out two bits of the argument at
+    a time, with only shifts, adds, and compares: each step decides
+    one more bit of the root. In fixed-point mode, the root of n
+    1/65536ths is the root of n * 65536 in 1/65536ths, so the
+    argument is continued with FIXEDPOINT_BITS zero bits. The
+    remainder is never more than twice the root, so it can't overflow.
+===========================================================================*/
+static VARTYPE parser_fn_sqr (Parser *self, const VARTYPE *args,
+         uint8_t *error)
+  {
+  (void)self;
+  if (args[0] < 0)
+    {
+    *error = BASIC_ERR_BAD_ARGUMENT;
+    return 0;
+    }
+  UVARTYPE n = (UVARTYPE)args[0];
+  UVARTYPE root = 0;
+  UVARTYPE rem = 0;
+  uint8_t steps = (VARTYPE_BITS + (FIXEDPOINT_ON ? FIXEDPOINT_BITS : 0)) / 2;
+  for (uint8_t i = 0; i < steps; i++)
+    {
+    rem = (rem << 2) | (n >> (VARTYPE_BITS - 2));
+    n <<= 2;
+    root <<= 1;
+    UVARTYPE trial = (root << 1) | 1;
+    if (rem >= trial)
+      {
+      rem -= trial;
+      root |= 1;
+      }
+    }
+  return (VARTYPE)root;
+  }
+
+/*===========================================================================
+  parser_shift_count
+  Get the number of places to shift by, which is always a whole number.
+    Returns -1, having set error, if it is negative.
+===========================================================================*/
+static VARTYPE parser_shift_count (VARTYPE n, uint8_t *error)
+  {
+  n = FIXEDPOINT_TO_INT (n);
+  if (n < 0)
+    {
+    *error = BASIC_ERR_BAD_ARGUMENT;
+    return -1;
+    }
+  return n;
+  }
+
+/*===========================================================================
+  parser_fn_shl
+  SHL(x, n) shifts the bits of x left by n places, which wraps like
+    any other overflow
+===========================================================================*/
+static VARTYPE parser_fn_shl (Parser *self, const VARTYPE *args,
+         uint8_t *error)
+  {
+  (void)self;
+  VARTYPE n = parser_shift_count (args[1], error);
+  if (n < 0) return 0;
+  if (n >= NUMWIDTH_BITS) return 0;
+  return NUMWIDTH_WRAP ((UVARTYPE)args[0] << n);
+  }
+
+/*===========================================================================
+  parser_fn_shr
+  SHR(x, n) shifts the bits of x right by n places, copying the sign
+    bit, so it divides by a power of two, rounding down
+===========================================================================*/
+static VARTYPE parser_fn_shr (Parser *self, const VARTYPE *args,
+         uint8_t *error)
+  {
+  (void)self;
+  VARTYPE n = parser_shift_count (args[1], error);
+  if (n < 0) return 0;
+  if (n >= NUMWIDTH_BITS) return args[0] < 0 ? -1 : 0;
+  return args[0] >> n;
+  }
+
+/*===========================================================================
+  parser_fn_rnd
+  RND(n) is a random number from 0 up to, but not including, n, from
+    a xorshift generator, which needs nothing more than shifts and
+    exclusive-ors. In fixed-point mode, it need not be a whole number.
+    RND of a negative number starts the sequence again, from a seed
+    that depends on the number, and gives 0; so does RND(0), without
+    changing anything.
+===========================================================================*/
+static VARTYPE parser_fn_rnd (Parser *self, const VARTYPE *args,
+         uint8_t *error)
+  {
+  (void)error;
+  VARTYPE n = args[0];
+  if (n < 0)
+    {
+    // Multiplying by an odd number spreads the bits of a small seed,
+    //   and never gives zero
+    self->rnd_state = (0 - (UVARTYPE)n) * PARSER_RND_SEED;
+    return 0;
+    }
+  if (n == 0) return 0;
+  UVARTYPE x = self->rnd_state;
+#if VARTYPE_BITS == 64
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+#elif VARTYPE_BITS == 32
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+#else
+  x ^= x << 7;
+  x ^= x >> 9;
+  x ^= x << 8;
+#endif
+  self->rnd_state = x;
+  return (VARTYPE)(x % (UVARTYPE)n);
+  }
+
+/*===========================================================================
+  parser_fn_millis
+===========================================================================*/
+static VARTYPE parser_fn_millis (Parser *self, const VARTYPE *args,
+         uint8_t *error)
+  {
+  (void)self;
+  (void)args;
+  (void)error;
+  return FIXEDPOINT_FROM_INT (NUMWIDTH_WRAP (interface_millis ()));
+  }
+
+/*===========================================================================
+  parser_fn_peek
+===========================================================================*/
+static VARTYPE parser_fn_peek (Parser *self, const VARTYPE *args,
+         uint8_t *error)
+  {
+  (void)self;
+  (void)error;
+  return FIXEDPOINT_FROM_INT (interface_peek (FIXEDPOINT_TO_INT (args[0])));
+  }
+
+static const ParserFunctionDef parser_functions [] PROGMEM =
+  {
+  { parser_fn_abs, 1 },
+  { parser_fn_min, 2 },
+  { parser_fn_max, 2 },
+  { parser_fn_sgn, 1 },
+  { parser_fn_sqr, 1 },
+  { parser_fn_shl, 2 },
+  { parser_fn_shr, 2 },
+  { parser_fn_rnd, 1 },
+  { parser_fn_millis, 0 },
+  { parser_fn_peek, 1 },
+  };
+
+/*===========================================================================
+  parser_function_number
+  Get the number of the function that a keyword names, or 
+    PARSER_FN_NONE
+===========================================================================*/
+static uint8_t parser_function_number (uint8_t keyword)
+  {
+  if (keyword >= STRING_INDEX_ABS && keyword <= STRING_INDEX_RND)
+    return keyword - STRING_INDEX_ABS;
+  if (keyword == STRING_INDEX_MILLIS) return PARSER_FN_MILLIS;
+  if (keyword == STRING_INDEX_PEEK) return PARSER_FN_PEEK;
+  return PARSER_FN_NONE;
+  }
+
+/*===========================================================================
+  parser_branch_function
+  On entry, the tokenizer is over the name of the function, whose
+    number is n
+===========================================================================*/
+static VARTYPE parser_branch_function (Parser *self, 
+         Tokenizer *t, uint8_t n, uint8_t *error)
+  {
+  tokenizer_next (t, error); // Skip the name
+  if (*error) return 0;
+  parser_accept_symbol (self, t, '(', error);
+  if (*error) return 0;
+  VARTYPE args [PARSER_MAX_ARGS];
+  uint8_t num_args = PARSER_READ_BYTE (&parser_functions[n].args);
+  for (uint8_t i = 0; i < num_args; i++)
+    {
+    if (i > 0)
+      {
+      parser_accept_symbol (self, t, ',', error);
+      if (*error) return 0;
+      }
+    args[i] = parser_branch_expr (self, t, error);
+    if (*error) return 0;
+    }
+  parser_accept_symbol (self, t, ')', error);
+  if (*error) return 0;
+  ParserFunction function = 
+    PARSER_READ_FUNCTION (&parser_functions[n].function);
+  return function (self, args, error);
+  }
+
+/*===========================================================================
+  parser_branch_factor
+===========================================================================*/
+static VARTYPE parser_branch_factor (Parser *self, 
+         Tokenizer *t, uint8_t *error)
+  {
+  if (tokenizer_is_number (t))
+    {
+    VARTYPE r = tokenizer_get_number_value (t);
+    tokenizer_next (t, error);
+    return r;
+    }
+  else if (tokenizer_is_symbol (t, '-'))
+    {
+    tokenizer_next (t, error);
+    STATS_COUNT_UNARY (STATS_OP_NEG);
+    VARTYPE r = parser_branch_factor (self, t, error);
+    return NUMWIDTH_WRAP (0 - (UVARTYPE)r);
+    }
+  else if (tokenizer_is_symbol (t, '('))
+    {
+    tokenizer_next (t, error);
+    if (*error) return 0;
+    VARTYPE r = parser_branch_expr (self, t, error);
+    if (*error) return 0;
+    parser_accept_symbol (self, t, ')', error);
+    if (*error) return 0;
+    return r;
+    }
+  else if (tokenizer_is_keyword (t, STRING_INDEX_LEN))
+    {
+    return parser_branch_len (self, t, error);
+    }
+  else if (parser_is_string_start (t))
+    {
+    return parser_branch_string_compare (self, t, error);
+    }
+  else if (tokenizer_is_word (t))
+    {
+    if (tokenizer_peek_char (t) == '(')
+      {
+      VARTYPE *element = parser_branch_element (self, t, error);
+      return element ? *element : 0;
+      }
+    VARTYPE r = 0;
+    uint8_t len;
+    const char *word = tokenizer_get_word (t, &len);
+    if (!variabletable_get_number (self->vt, word, len, &r))
+      {
+      strings_output_string (BASIC_ERR_UNDEFINED_VAR);
+      interface_output_string (": ");
+      interface_output_string (": ");
+      interface_output_chars (word, len);
+      interface_output_endl ();
+      *error = BASIC_ERR_UNDEFINED_VAR; 
+      }
+    tokenizer_next (t, error);
+    return r;
+    } 
+  else
+    {
+    uint8_t keyword = tokenizer_get_keyword (t);
+    if (keyword == STRING_INDEX_FN)
+      return parser_branch_fn (self, t, error);
+    uint8_t n = parser_function_number (keyword);
+    if (n != PARSER_FN_NONE)
+      return parser_branch_function (self, t, n, error);
+    *error = BASIC_ERR_SYNTAX;
+    return 0;
+    }
+  }
+
+/*===========================================================================
+  parser_skip_to_next_line
+===========================================================================*/
+static void parser_skip_to_next_line (Parser *self, 
+         Tokenizer *t, uint8_t *error)
+  {
+  (void)self;
+  (void)error;
+  tokenizer_skip_line (t);
+  // Don't skip the \n -- the main parser loop always advances one
+  //  token after the numbered-statement branch. This skips the \n, so
+  //  if we skip here as well, we'll skip the line number
+  //tokenizer_next (t, error);
+  }
+
+/*===========================================================================
+  parser_is_statement_end
+  A statement ends at the end of the line, at a ':' that separates it 
+    from the next one, or at an ELSE
+===========================================================================*/
+static BOOL parser_is_statement_end (const Tokenizer *t)
+  {
+  return tokenizer_is_eol (t) || tokenizer_is_symbol (t, ':')
+    || tokenizer_is_keyword (t, STRING_INDEX_ELSE);
+  }
+
+/*===========================================================================
+  parser_branch_fn_body
+  On entry, the tokenizer is just after the '(' of a DEF FN. Each 
+    parameter is given the value of its argument while the body is evaluated, and
+    then gets its own value back. 
+===========================================================================*/
+static VARTYPE parser_branch_fn_body (Parser *self, Tokenizer *t, 
+         const VARTYPE *args, uint8_t num_args, uint8_t *error)
+  {
+  Variable *params [PARSER_MAX_FN_ARGS];
+  uint8_t num_params = 0;
+  while (!*error && !tokenizer_is_symbol (t, ')'))
+    {
+    if (num_params > 0)
+      {
+      parser_accept_symbol (self, t, ',', error);
+      if (*error) return 0;
+      }
+    if (!tokenizer_is_word (t))
+      {
+      *error = BASIC_ERR_KW_NO_VAR;
+      return 0;
+      }
+    uint8_t len;
+    const char *word = tokenizer_get_word (t, &len);
+    if (parser_is_string_name (word, len))
+      {
+      *error = BASIC_ERR_TYPE_MISMATCH;
+      return 0;
+      }
+    if (num_params == num_args)
+      {
+      *error = BASIC_ERR_BAD_ARGUMENT;
+      return 0;
+      }
+    Variable *var = variabletable_get_variable (self->vt, word, len);
+    if (!var)
+      {
+      variabletable_set_number (self->vt, word, len, 0, error);
+      if (*error) return 0;
+      var = variabletable_get_variable (self->vt, word, len);
+      }
+    params [num_params++] = var;
+    tokenizer_next (t, error);
+    }
+  if (*error) return 0;
+  if (num_params != num_args)
+    {
+    *error = BASIC_ERR_BAD_ARGUMENT;
+    return 0;
+    }
+  tokenizer_next (t, error); // Skip )
+  if (*error) return 0;
+  parser_accept_symbol (self, t, '=', error);
+  if (*error) return 0;
+
+  VARTYPE saved [PARSER_MAX_FN_ARGS];
+  for (uint8_t i = 0; i < num_params; i++)
+    {
+    saved[i] = variable_get_number (params[i]);
+    variable_set_number (params[i], args[i]);
+    }
+  VARTYPE r = parser_branch_expr (self, t, error);
+  if (!*error && !parser_is_statement_end (t)) 
+    *error = BASIC_ERR_SYNTAX;
+  // Backwards, in case a parameter is named twice
+  for (uint8_t i = num_params; i > 0; i--)
+    variable_set_number (params[i - 1], saved[i - 1]);
+  return r;
+  }
+
+/*===========================================================================
+  parser_branch_fn
+  FN name (arg, arg, ...)
+  The body of the function is evaluated where it is, in the DEF: the 
+    tokenizer goes there, and then comes back to carry on after the 
+    call. Nothing is pushed, and no line has to be looked up.
+===========================================================================*/
+static VARTYPE parser_branch_fn (Parser *self, 
+         Tokenizer *t, uint8_t *error)
+  {
+  if (self->immediate)
+    {
+    // The tokenizer is not reading the program
+    *error = BASIC_ERR_UNSUP_IMMEDIATE;
+    return 0;
+    }
+  tokenizer_next (t, error); // Skip FN
+  if (*error) return 0;
+  if (!tokenizer_is_word (t))
+    {
+    *error = BASIC_ERR_SYNTAX;
+    return 0;
+    }
+  uint8_t len;
+  const char *name = tokenizer_get_word (t, &len);
+  const FunctionIndexEntry *fie = parser_find_function (self, name, len);
+  if (!fie)
+    {
+    *error = BASIC_ERR_UNDEFINED_FN;
+    return 0;
+    }
+  if (self->fn_depth >= MAX_FN_DEPTH)
+    {
+    *error = BASIC_ERR_FN_DEPTH;
+    return 0;
+    }
+  tokenizer_next (t, error); // Skip the name
+  if (*error) return 0;
+  parser_accept_symbol (self, t, '(', error);
+  if (*error) return 0;
+
+  VARTYPE args [PARSER_MAX_FN_ARGS];
+  uint8_t num_args = 0;
+  self->fn_depth++;
+  while (!*error && !tokenizer_is_symbol (t, ')'))
+    {
+    if (num_args > 0) parser_accept_symbol (self, t, ',', error);
+    if (!*error && num_args == PARSER_MAX_FN_ARGS) 
+      *error = BASIC_ERR_BAD_ARGUMENT;
+    if (!*error) args [num_args++] = parser_branch_expr (self, t, error);
+    }
+  VARTYPE r = 0;
+  if (!*error)
+    {
+    // Where to come back to is just after the ')'
+    TokenizerPos back = tokenizer_get_pos (t);
+    tokenizer_resume (t, fie->params, error);
+    if (!*error) 
+      r = parser_branch_fn_body (self, t, args, num_args, error);
+    if (!*error) tokenizer_resume (t, back, error);
+    }
+  self->fn_depth--;
+  return r;
+  }
+
+/*===========================================================================
+  parser_branch_def_statement
+  The functions were all found before the program started, so a DEF 
+    is just skipped when it is reached
+===========================================================================*/
+static void parser_branch_def_statement (Parser *self, 
+         Tokenizer *t, uint8_t *error)
+  {
+  if (self->immediate)
+    {
+    *error = BASIC_ERR_UNSUP_IMMEDIATE;
+    return;
+    }
+  while (!*error && !parser_is_statement_end (t))
+    tokenizer_next (t, error);
+  }
+
+/*===========================================================================
+  parser_output_number
+  Output a number, in whatever form numbers have at present
+===========================================================================*/
+static void parser_output_number (VARTYPE n)
+  {
+#ifdef FIXED_POINT
+  if (FIXEDPOINT_ON)
+    {
+    fixedpoint_output (n);
+    return;
+    }
+#endif
+  interface_output_number (n);
+  }
+
+/*===========================================================================
+  parser_output_string
+  Output the text of a string token, in which each escaped quote is
+    still two quotes. Only the second of each pair is skipped, so the 
+    text can be output in pieces, without copying it.
+===========================================================================*/
+static void parser_output_string (const char *s, uint8_t len)
+  {
+  uint8_t start = 0;
+  for (uint8_t i = 0; i < len; i++)
+    {
+    if (s[i] == '\"')
+      {
+      interface_output_chars (s + start, i + 1 - start);
+      i++;
+      start = i + 1;
+      }
+    }
+  if (start < len)
+    interface_output_chars (s + start, len - start);
+  }
+
+/*===========================================================================
+  parser_branch_print_statement
+===========================================================================*/
+static void parser_branch_print_statement (Parser *self, 
+         Tokenizer *t, uint8_t *error)
+  {
+  tokenizer_next (t, error);
+  if (*error) return;
+
+  if (parser_is_statement_end (t)) 
+    {
+    interface_output_endl();
+    return;
+    }
+
+  BOOL no_newline = FALSE;
+ 
+  // PRINT prints all its arguments, and doesn't know in advance
+  //  how many, so it carries on to the end of the statement. That
+  //  might be an ELSE, as in IF foo THEN print 1 2 3 ELSE... 
+  do
+    {
+    // A string on its own is printed straight from the program, which
+    //   saves evaluating it. There is never a space before the + that
+    //   would make it part of a string expression
+    if (tokenizer_is_string (t) && tokenizer_peek_char (t) != '+')
+      {
+      uint8_t len;
+      const char *string = tokenizer_get_string (t, &len);
+      parser_output_string (string, len);
+      tokenizer_next (t, error);
+      }
+    else if (parser_is_string_start (t))
+      {
+      StringHeap *heap = variabletable_get_string_heap (self->vt);
+      uint8_t mark = stringheap_mark (heap);
+      StringView s;
+      parser_branch_string_expr (self, t, NULL, &s, error);
+      if (!*error)
+        interface_output_chars (s.data, s.length);
+      stringheap_release (heap, mark);
+      if (*error) return;
+      }
+    else if (tokenizer_is_symbol (t, ','))
       {
       interface_output_string (" ");
       tokenizer_next (t, error);
@@ -430,41 +1733,37 @@ static void parser_branch_print_statement (Parser *self,
       {
       VARTYPE r = parser_branch_expr (self, t, error); 
       if (!*error)
-        interface_output_number (r);  
+        parser_output_number (r);  
       else
         return;
       }
-    else if (tokenizer_is_word (t))
+    else if (tokenizer_is_word (t) || tokenizer_is_keyword (t, STRING_INDEX_NOT)
+             || tokenizer_is_keyword (t, STRING_INDEX_LEN)
+             || tokenizer_is_keyword (t, STRING_INDEX_FN)
+             || parser_function_number (tokenizer_get_keyword (t)) 
+                  != PARSER_FN_NONE)
       {
-      const char *word = tokenizer_get_word (t);
-      if (strings_compare_index (word, STRING_INDEX_ELSE))
-        {
-        parser_skip_to_next_line (self, t, error);
-        if (*error) return;
-        }
+      VARTYPE r = parser_branch_expr (self, t, error); 
+      if (!*error)
+        parser_output_number (r);  
       else
-        {
-        VARTYPE r = parser_branch_expr (self, t, error); 
-        if (!*error)
-          interface_output_number (r);  
-        else
-          return;
-        }
+        return;
       }
     else 
       {
       *error = BASIC_ERR_UNPRINTABLE_TOKEN;
       strings_output_string (BASIC_ERR_UNPRINTABLE_TOKEN); 
-      const char *word = tokenizer_get_word (t);
-      if (word[0])
+      uint8_t len;
+      const char *word = tokenizer_get_word (t, &len);
+      if (len)
         {
         interface_output_string (": ");
-        interface_output_string (word);
+        interface_output_chars (word, len);
         }
       interface_output_endl ();
       return;
       }
-    } while (!tokenizer_is_eol (t)); 
+    } while (!parser_is_statement_end (t)); 
 
   if (!no_newline)
     interface_output_endl();
@@ -477,13 +1776,13 @@ static void parser_branch_goto_statement (Parser *self,
          Tokenizer *t, uint8_t *error)
   {
   tokenizer_next (t, error); // Slurp GOTO 
-  VARTYPE l = parser_branch_expr (self, t, error);
+  VARTYPE l = parser_branch_int_expr (self, t, error);
   if (!*error)
     {
     int b, e;
     if (basicprogram_get_line_offsets (self->bp, l, &b, &e))
       {
-      tokenizer_set_pos (t, basicprogram_c_str(self->bp) + b); 
+      tokenizer_set_line_pos (t, b); 
       }
     else
       {
@@ -498,38 +1797,49 @@ static void parser_branch_goto_statement (Parser *self,
 
 /*===========================================================================
   parser_branch_gosub_statement
+  GOSUB line [(arg, arg, ...)]
+  The arguments go on the call stack, where LOCAL picks them up
 ===========================================================================*/
 static void parser_branch_gosub_statement (Parser *self, 
          Tokenizer *t, uint8_t *error)
   {
   tokenizer_next (t, error); // Slurp GOSUB
 
-  VARTYPE l = parser_branch_expr (self, t, error);
+  VARTYPE l = parser_branch_int_expr (self, t, error);
   if (*error) return;
 
-
-  // Check the stack
-  if (self->gosub_stack_ptr < MAX_GOSUB_STACK_DEPTH - 1)
+  uint8_t num_args = 0;
+  if (tokenizer_is_symbol (t, '('))
     {
-    int b, e;
-    if (basicprogram_get_line_offsets (self->bp, l, &b, &e))
-      {
-      self->gosub_stack [self->gosub_stack_ptr] = tokenizer_get_pos (t);
-      tokenizer_set_pos (t, basicprogram_c_str (self->bp) + b); 
-      self->gosub_stack_ptr++;
-      }
-    else
-      {
-      strings_output_string (BASIC_ERR_UNKNOWN_LINE);
-      interface_output_string (": ");
-      interface_output_number (l);
-      interface_output_endl ();
-      *error = BASIC_ERR_UNKNOWN_LINE; 
-      }
+    do
+      {
+      tokenizer_next (t, error); // Skip ( or comma
+      if (*error) return;
+      VARTYPE v = parser_branch_expr (self, t, error);
+      if (*error) return;
+      callstack_push_arg (self->calls, v, error);
+      if (*error) return;
+      num_args++;
+      } while (tokenizer_is_symbol (t, ','));
+    parser_accept_symbol (self, t, ')', error);
+    if (*error) return;
+    }
+
+  int b, e;
+  if (basicprogram_get_line_offsets (self->bp, l, &b, &e))
+    {
+    callstack_push (self->calls, tokenizer_get_pos (t), self->current_line,
+      num_args, error);
+    if (*error) return;
+    tokenizer_set_line_pos (t, b); 
     }
   else
     {
-    *error = BASIC_ERR_GOSUB_DEPTH;
+    strings_output_string (BASIC_ERR_UNKNOWN_LINE);
+    interface_output_string (": ");
+    interface_output_number (l);
+    interface_output_endl ();
+    *error = BASIC_ERR_UNKNOWN_LINE; 
     }
   }
 
@@ -540,10 +1850,9 @@ static void parser_branch_return_statement (Parser *self,
          Tokenizer *t, uint8_t *error)
   {
   tokenizer_next (t, error); // Slurp RETURN
-  if (self->gosub_stack_ptr > 0)
+  TokenizerPos pos;
+  if (callstack_pop (self->calls, &pos, &self->current_line))
     {
-    self->gosub_stack_ptr--;
-    const char *pos = self->gosub_stack [self->gosub_stack_ptr];
     tokenizer_set_pos (t, pos);
     }
   else
@@ -552,6 +1861,45 @@ static void parser_branch_return_statement (Parser *self,
     }
   }
 
+/*===========================================================================
+  parser_branch_local_statement
+  LOCAL a, b, ...
+  Each variable takes the next argument of the GOSUB, or zero, and gets
+    its old value back on RETURN
+===========================================================================*/
+static void parser_branch_local_statement (Parser *self, 
+         Tokenizer *t, uint8_t *error)
+  {
+  tokenizer_next (t, error); // Skip LOCAL
+  while (!*error)
+    {
+    if (!tokenizer_is_word (t))
+      {
+      *error = BASIC_ERR_KW_NO_VAR;
+      return;
+      }
+    uint8_t len;
+    const char *word = tokenizer_get_word (t, &len);
+    if (parser_is_string_name (word, len))
+      {
+      *error = BASIC_ERR_TYPE_MISMATCH;
+      return;
+      }
+    Variable *var = variabletable_get_variable (self->vt, word, len);
+    if (!var)
+      {
+      variabletable_set_number (self->vt, word, len, 0, error);
+      if (*error) return;
+      var = variabletable_get_variable (self->vt, word, len);
+      }
+    callstack_local (self->calls, var, error);
+    if (*error) return;
+    tokenizer_next (t, error);
+    if (*error || !tokenizer_is_symbol (t, ',')) return;
+    tokenizer_next (t, error); // Skip comma
+    }
+  }
+
 /*===========================================================================
   parser_branch_if_statement
 ===========================================================================*/
@@ -564,29 +1912,27 @@ static void parser_branch_if_statement (Parser *self,
 
   tokenizer_next (t, error); // Skip THEN 
 
+  // Everything after THEN, up to an ELSE, is run if the condition 
+  //   holds, including any further statements after a ':'
   if (condition)
     {
     parser_branch_statement (self, t, error);
     }
   else
     {
-    const char *word; 
     do
       {
       tokenizer_next (t, error);
-      word = tokenizer_get_word (t);
       if (*error) return;
       } while (!tokenizer_is_eol (t) 
-          && !strings_compare_index (word, STRING_INDEX_ELSE) && !*error);
-    if (strings_compare_index (word, STRING_INDEX_ELSE))
+          && !tokenizer_is_keyword (t, STRING_INDEX_ELSE));
+    if (tokenizer_is_keyword (t, STRING_INDEX_ELSE))
       {
       tokenizer_next (t, error);
       parser_branch_statement (self, t, error);
       }
-    else if (tokenizer_is_eol (t))
-      {
-      tokenizer_next (t, error);
-      }
+    // Otherwise, we're at the end of the line, and the main loop will
+    //   step over the EOL
     }
   }
 
@@ -599,6 +1945,24 @@ static void parser_branch_rem_statement (Parser *self,
   parser_skip_to_next_line (self, t, error);
   }
 
+/*===========================================================================
+  parser_copy_var_name
+  Copy a variable name into a buffer of MAX_VARIABLE_NAME + 1 bytes.
+    Returns FALSE, and sets the error, if the name is too long.
+===========================================================================*/
+static BOOL parser_copy_var_name (char *buff, const char *name, 
+         uint8_t len, uint8_t *error)
+  {
+  if (len > MAX_VARIABLE_NAME)
+    {
+    *error = BASIC_ERR_NAME_TOO_LONG;
+    return FALSE;
+    }
+  memcpy (buff, name, len);
+  buff[len] = 0;
+  return TRUE;
+  }
+
 /*===========================================================================
   parser_branch_for_statement
 ===========================================================================*/
@@ -613,6 +1977,81 @@ static void parser_branch_for_statement (Parser *self,
 
   tokenizer_next (t, error); // Skip FOR
 
+  // The name goes straight into the next free FOR stack entry, which
+  //   only becomes live when for_stack_ptr is incremented at the end
+  ForState *fs = &self->for_stack[self->for_stack_ptr];
+  char *var_name = fs->var_name;
+  if (tokenizer_is_word (t))
+    {
+    const char *word = tokenizer_get_word (t, &fs->var_len);
+    if (!parser_copy_var_name (var_name, word, fs->var_len, error))
+      return;
+    tokenizer_next (t, error);
+    }
+  else
+    {
+    *error = BASIC_ERR_NO_FOR_VAR;
+    return;
+    }
+
+  if (tokenizer_is_symbol (t, '='))
+    {
+    tokenizer_next (t, error);
+    }
+  else
+    {
+    *error = BASIC_ERR_NO_FOR_EQ;
+    return;
+    }
+
+  VARTYPE start = parser_branch_expr (self, t, error);
+  if (*error) 
+    return;
+
+  variabletable_set_number (self->vt, var_name, fs->var_len, start, error);
+  if (*error) 
+    return;
+
+  if (tokenizer_is_keyword (t, STRING_INDEX_TO))
+    {
+    tokenizer_next (t, error);
+    }
+  else
+    {
+    *error = BASIC_ERR_NO_FOR_TO;
+    return;
+    }
+
+  VARTYPE end = parser_branch_expr (self, t, error);
+  if (*error) 
+    return;
+
+  uint8_t p = self->for_stack_ptr;
+  self->for_stack[p].back_pos = tokenizer_get_pos (t); 
+  self->for_stack[p].line = self->current_line;
+  self->for_stack[p].keyword = STRING_INDEX_FOR;
+  self->for_stack[p].to = end;
+  self->for_stack_ptr++;
+  }
+
+/*===========================================================================
+  parser_branch_next_statement
+===========================================================================*/
+static void parser_branch_next_statement (Parser *self, 
+         Tokenizer *t, uint8_t *error)
+  {
+  int p = self->for_stack_ptr;
+
+  if (p == 0 || self->for_stack[p - 1].keyword != STRING_INDEX_FOR)
+    {
+    *error = BASIC_ERR_NEXT_WITHOUT_FOR;
+    return;
+    }
+
+  tokenizer_next (t, error); // Skip NEXT
+
+  /*
+  // We aren't accepting a loop variable after NEXT at present.
   char *var_name = NULL;
   if (tokenizer_is_word (t))
     {
@@ -621,180 +2060,478 @@ static void parser_branch_for_statement (Parser *self,
     }
   else
     {
-    *error = BASIC_ERR_NO_FOR_VAR;
+    strings_output_string (STRING_INDEX_NO_NEXT_VAR);
+    interface_output_endl(); 
+    *error = BASIC_ERR_SYNTAX;
     free (var_name);
     return;
     }
+  */
+
+  // Find the variable in the for stack, if it's there
+  // TODO TODO TODO we're only looking at the top of the stack
+
+  char *var_name = self->for_stack[p - 1].var_name; 
+  uint8_t var_len = self->for_stack[p - 1].var_len; 
+  VARTYPE to = self->for_stack[p - 1].to;
+  TokenizerPos pos = self->for_stack[p - 1].back_pos;
+  VARTYPE count;
+  if (variabletable_get_number (self->vt, var_name, var_len, &count))
+    {
+    // We shouldn't need to check the variable exists, since it's come
+    //  off the stack.
+    }
+
+  // In fixed-point mode, the end need not be a whole number of steps
+  //   from the start, so the loop also ends if another step would pass it
+  if (count == to || (FIXEDPOINT_ON 
+       && count > NUMWIDTH_WRAP ((UVARTYPE)to - FIXEDPOINT_ONE)))
+    {
+    // We're done -- unwind the stack, and don't jump back
+    self->for_stack_ptr--;
+    }
+  else
+    {
+    // Not done -- increment the count and jump back
+    variabletable_set_number (self->vt, var_name, var_len, 
+      NUMWIDTH_WRAP ((UVARTYPE)count + FIXEDPOINT_ONE), error);
+    if (!*error)
+      {
+      self->current_line = self->for_stack[p - 1].line;
+      tokenizer_set_pos (t, pos);
+      }
+    }
+  }
+
+/*===========================================================================
+  parser_branch_while_statement
+===========================================================================*/
+static void parser_branch_while_statement (Parser *self, 
+         Tokenizer *t, uint8_t *error)
+  {
+  // The loop index only covers the program
+  if (self->immediate)
+    {
+    *error = BASIC_ERR_UNSUP_IMMEDIATE;
+    return;
+    }
+
+  TokenizerPos pos = tokenizer_get_pos (t);
+  tokenizer_next (t, error); // Skip WHILE
+  if (*error) return;
+
+  VARTYPE condition = parser_branch_expr (self, t, error);
+  if (*error) return;
+
+  if (condition)
+    {
+    if (self->for_stack_ptr >= MAX_FOR_STACK_DEPTH)
+      {
+      *error = BASIC_ERR_FOR_DEPTH;
+      return;
+      }
+    ForState *fs = &self->for_stack[self->for_stack_ptr];
+    fs->back_pos = pos;
+    fs->line = self->current_line;
+    fs->keyword = STRING_INDEX_WHILE;
+    self->for_stack_ptr++;
+    }
+  else
+    {
+    // Carry on from just after the matching WEND
+    TokenizerPos end;
+    if (parser_loop_end (self, pos, &end))
+      tokenizer_set_pos (t, end);
+    else
+      *error = BASIC_ERR_WHILE_WITHOUT_WEND;
+    }
+  }
+
+/*===========================================================================
+  parser_branch_wend_statement
+  Go back and test the WHILE's condition again. If it still holds, the
+    tokenizer is left at the end of the condition, and the body runs 
+    again; otherwise, the program carries on from here. 
+===========================================================================*/
+static void parser_branch_wend_statement (Parser *self, 
+         Tokenizer *t, uint8_t *error)
+  {
+  int p = self->for_stack_ptr;
+
+  if (p == 0 || self->for_stack[p - 1].keyword != STRING_INDEX_WHILE)
+    {
+    *error = BASIC_ERR_WEND_WITHOUT_WHILE;
+    return;
+    }
+
+  const ForState *fs = &self->for_stack[p - 1];
+  TokenizerPos end = tokenizer_get_pos (t);
+  VARTYPE line = self->current_line;
+  self->current_line = fs->line;
+  tokenizer_set_pos (t, fs->back_pos);
+  tokenizer_next (t, error);
+  if (*error) return;
+
+  VARTYPE condition = parser_branch_expr (self, t, error);
+  if (*error) return;
+
+  if (!condition)
+    {
+    self->for_stack_ptr--;
+    self->current_line = line;
+    tokenizer_set_pos (t, end);
+    }
+  }
+
+/*===========================================================================
+  parser_branch_repeat_statement
+===========================================================================*/
+static void parser_branch_repeat_statement (Parser *self, 
+         Tokenizer *t, uint8_t *error)
+  {
+  if (self->for_stack_ptr >= MAX_FOR_STACK_DEPTH)
+    {
+    *error = BASIC_ERR_FOR_DEPTH;
+    return;
+    }
+
+  ForState *fs = &self->for_stack[self->for_stack_ptr];
+  fs->back_pos = tokenizer_get_pos (t);
+  fs->line = self->current_line;
+  fs->keyword = STRING_INDEX_REPEAT;
+  self->for_stack_ptr++;
+  tokenizer_next (t, error); // Skip REPEAT
+  }
+
+/*===========================================================================
+  parser_branch_until_statement
+===========================================================================*/
+static void parser_branch_until_statement (Parser *self, 
+         Tokenizer *t, uint8_t *error)
+  {
+  int p = self->for_stack_ptr;
+
+  if (p == 0 || self->for_stack[p - 1].keyword != STRING_INDEX_REPEAT)
+    {
+    *error = BASIC_ERR_UNTIL_WITHOUT_REPEAT;
+    return;
+    }
+
+  tokenizer_next (t, error); // Skip UNTIL
+  if (*error) return;
+
+  VARTYPE condition = parser_branch_expr (self, t, error);
+  if (*error) return;
+
+  if (condition)
+    {
+    self->for_stack_ptr--;
+    }
+  else
+    {
+    const ForState *fs = &self->for_stack[p - 1];
+    self->current_line = fs->line;
+    tokenizer_set_pos (t, fs->back_pos);
+    }
+  }
+
+/*===========================================================================
+  parser_branch_string_assignment
+===========================================================================*/
+static void parser_branch_string_assignment (Parser *self, 
+         Tokenizer *t, uint8_t *error)
+  {
+  // As for numbers, the name has to be copied if the variable does not
+  //   exist yet. If it does, it is passed as the target of the 
+  //   expression, so that a$ = a$ + ... can add to a$ where it is
+  uint8_t len;
+  const char *word = tokenizer_get_word (t, &len);
+  StringHandle *target = variabletable_get_string (self->vt, word, len);
+  char var_name [MAX_VARIABLE_NAME + 1];
+  if (!target && !parser_copy_var_name (var_name, word, len, error))
+    return;
+  tokenizer_next (t, error);
+  if (*error) return;
+  if (!tokenizer_is_symbol (t, '='))
+    {
+    *error = BASIC_ERR_VAR_NO_EQ;
+    return;
+    }
+  tokenizer_next (t, error);
+  if (*error) return;
+
+  StringHeap *heap = variabletable_get_string_heap (self->vt);
+  uint8_t mark = stringheap_mark (heap);
+  StringView value;
+  BOOL fresh = parser_branch_string_expr (self, t, target, &value, error);
+  if (!*error && !target)
+    target = variabletable_new_string (self->vt, var_name, len, error);
+  if (!*error)
+    {
+    if (fresh)
+      stringheap_commit (heap, target, &value);
+    else
+      stringheap_assign (heap, target, &value, error);
+    }
+  stringheap_release (heap, mark);
+  }
+
+/*===========================================================================
+  parser_branch_assignment
+===========================================================================*/
+static void parser_branch_assignment (Parser *self, 
+         Tokenizer *t, uint8_t *error)
+  {
+  uint8_t len;
+  const char *word = tokenizer_get_word (t, &len);
+  if (parser_is_string_name (word, len))
+    {
+    parser_branch_string_assignment (self, t, error);
+    return;
+    }
+
+  if (tokenizer_peek_char (t) == '(')
+    {
+    // An array element. The elements never move, so it's safe to 
+    //   hold on to it while the expression is evaluated
+    VARTYPE *element = parser_branch_element (self, t, error);
+    if (*error) return;
+    if (!tokenizer_is_symbol (t, '='))
+      {
+      *error = BASIC_ERR_VAR_NO_EQ;
+      return;
+      }
+    tokenizer_next (t, error);
+    if (*error) return;
+    VARTYPE v = parser_branch_expr (self, t, error);
+    if (!*error) *element = v;
+    return;
+    }
+
+  // On entry, tokenizer will be over the name, if there is one. If
+  //   the variable exists, we can keep hold of it; variables never 
+  //   move. Otherwise we need a copy of the name to create it with, 
+  //   because the name is gone when the tokenizer moves on
+  Variable *var = variabletable_get_variable (self->vt, word, len);
+  char var_name [MAX_VARIABLE_NAME + 1];
+  if (!var && !parser_copy_var_name (var_name, word, len, error))
+    return;
+  tokenizer_next (t, error);
+  if (*error) return;
 
   if (tokenizer_is_symbol (t, '='))
     {
     tokenizer_next (t, error);
+    if (*error) return;
+    VARTYPE v = parser_branch_expr (self, t, error);
+    if (*error) return;
+    if (var)
+      variable_set_number (var, v);
+    else
+      variabletable_set_number (self->vt, var_name, len, v, error);
     }
   else
     {
-    *error = BASIC_ERR_NO_FOR_EQ;
-    free (var_name);
-    return;
-    }
-
-  VARTYPE start = parser_branch_expr (self, t, error);
-  if (*error) 
-    {
-    free (var_name);
-    return;
-    }
-
-  variabletable_set_number (self->vt, var_name, start, error);
-  if (*error) 
-    {
-    free (var_name);
-    return;
+    *error = BASIC_ERR_VAR_NO_EQ;
     }
+  }
 
-  if (tokenizer_is_word (t))
+/*===========================================================================
+  parser_branch_dim_statement
+  DIM a(n), b(m), ...
+===========================================================================*/
+static void parser_branch_dim_statement (Parser *self, 
+         Tokenizer *t, uint8_t *error)
+  {
+  tokenizer_next (t, error); // Skip DIM
+  while (!*error)
     {
-    const char *word = tokenizer_get_word(t);
-    if (strings_compare_index (word, STRING_INDEX_TO))
+    if (!tokenizer_is_word (t))
       {
-      tokenizer_next (t, error);
+      *error = BASIC_ERR_KW_NO_VAR;
+      return;
       }
-    else
+    // The name is needed after the bound has been evaluated, by which
+    //   time the tokenizer has moved on
+    uint8_t len;
+    const char *word = tokenizer_get_word (t, &len);
+    if (parser_is_string_name (word, len))
       {
-      *error = BASIC_ERR_NO_FOR_TO;
-      free (var_name);
+      // There are no arrays of strings
+      *error = BASIC_ERR_TYPE_MISMATCH;
       return;
       }
+    char var_name [MAX_VARIABLE_NAME + 1];
+    if (!parser_copy_var_name (var_name, word, len, error)) return;
+    tokenizer_next (t, error);
+    if (*error) return;
+    parser_accept_symbol (self, t, '(', error);
+    if (*error) return;
+    VARTYPE bound = parser_branch_int_expr (self, t, error);
+    if (*error) return;
+    parser_accept_symbol (self, t, ')', error);
+    if (*error) return;
+    variabletable_dim_array (self->vt, var_name, len, bound, error);
+    if (*error || !tokenizer_is_symbol (t, ',')) return;
+    tokenizer_next (t, error); // Skip comma
     }
-  else
-    {
-    *error = BASIC_ERR_NO_FOR_TO;
-    free (var_name);
-    return;
-    }
+  }
 
-  VARTYPE end = parser_branch_expr (self, t, error);
-  if (*error) 
+/*===========================================================================
+  parser_branch_mat_operand
+  Get the next array in a MAT statement, which must be the same size
+    as the first
+===========================================================================*/
+static VARTYPE *parser_branch_mat_operand (Parser *self, 
+         Tokenizer *t, UVARTYPE bound, uint8_t *error)
+  {
+  UVARTYPE b;
+  VARTYPE *elements = parser_branch_array (self, t, &b, error);
+  if (*error) return NULL;
+  if (b != bound)
     {
-    free (var_name);
-    return;
+    *error = BASIC_ERR_ARRAY_SIZE;
+    return NULL;
     }
-
-  uint8_t p = self->for_stack_ptr;
-  self->for_stack[p].var_name = var_name;
-  self->for_stack[p].back_pos = tokenizer_get_pos (t); 
-  self->for_stack[p].to = end;
-  self->for_stack_ptr++;
+  return elements;
   }
 
 /*===========================================================================
-  parser_branch_next_statement
+  parser_branch_mat_reduce
+  MAT SUM s = a
+  MAT DOT s = a, b
 ===========================================================================*/
-static void parser_branch_next_statement (Parser *self, 
-         Tokenizer *t, uint8_t *error)
+static void parser_branch_mat_reduce (Parser *self, 
+         Tokenizer *t, BOOL dot, uint8_t *error)
   {
-  int p = self->for_stack_ptr;
-
-  if (p == 0)
+  tokenizer_next (t, error); // Skip SUM or DOT
+  if (*error) return;
+  if (!tokenizer_is_word (t))
     {
-    *error = BASIC_ERR_NEXT_WITHOUT_FOR;
+    *error = BASIC_ERR_KW_NO_VAR;
     return;
     }
-
-  tokenizer_next (t, error); // Skip NEXT
-
-  /*
-  // We aren't accepting a loop variable after NEXT at present.
-  char *var_name = NULL;
-  if (tokenizer_is_word (t))
-    {
-    var_name = strdup (tokenizer_get_word(t));
-    tokenizer_next (t, error);
-    }
-  else
+  uint8_t len;
+  const char *word = tokenizer_get_word (t, &len);
+  char var_name [MAX_VARIABLE_NAME + 1];
+  if (!parser_copy_var_name (var_name, word, len, error)) return;
+  tokenizer_next (t, error);
+  if (*error) return;
+  if (!tokenizer_is_symbol (t, '='))
     {
-    strings_output_string (STRING_INDEX_NO_NEXT_VAR);
-    interface_output_endl(); 
-    *error = BASIC_ERR_SYNTAX;
-    free (var_name);
+    *error = BASIC_ERR_VAR_NO_EQ;
     return;
     }
-  */
-
-  // Find the variable in the for stack, if it's there
-  // TODO TODO TODO we're only looking at the top of the stack
-
-  char *var_name = self->for_stack[p - 1].var_name; 
-  VARTYPE to = self->for_stack[p - 1].to;
-  const char *pos = self->for_stack[p - 1].back_pos;
-  VARTYPE count;
-  if (variabletable_get_number (self->vt, var_name, &count))
-    {
-    // We shouldn't need to check the variable exists, since it's come
-    //  off the stack.
-    }
+  tokenizer_next (t, error);
+  if (*error) return;
 
-  if (count == to)
+  UVARTYPE bound;
+  VARTYPE *a = parser_branch_array (self, t, &bound, error);
+  if (*error) return;
+  VARTYPE result;
+  if (dot)
     {
-    // We're done -- unwind the stack, and don't jump back
-    free (self->for_stack[p - 1].var_name);
-    self->for_stack_ptr--;
+    parser_accept_symbol (self, t, ',', error);
+    if (*error) return;
+    VARTYPE *b = parser_branch_mat_operand (self, t, bound, error);
+    if (*error) return;
+    result = mat_dot (a, b, (size_t)bound + 1);
     }
   else
-    {
-    // Not done -- increment the count and jump back
-    variabletable_set_number (self->vt, var_name, count + 1, error);
-    if (!*error)
-      {
-      tokenizer_set_pos (t, pos);
-      }
-    }
+    result = mat_sum (a, (size_t)bound + 1);
+  variabletable_set_number (self->vt, var_name, len, result, error);
   }
 
 /*===========================================================================
-  parser_branch_assignment
+  parser_branch_mat_statement
+  MAT c = a
+  MAT c = a + b
+  MAT c = a - b
+  MAT c = a * k
+  The arrays must all be the same size, but need not be different.
 ===========================================================================*/
-static void parser_branch_assignment (Parser *self, 
+static void parser_branch_mat_statement (Parser *self, 
          Tokenizer *t, uint8_t *error)
   {
-  // On entry, tokenizer will be over the name, if there is one
-  const char *var_name = tokenizer_get_word (t);
-  char *var_name_2 = strdup (var_name);
-  tokenizer_next (t, error);
+  tokenizer_next (t, error); // Skip MAT
   if (*error) return;
 
-  if (tokenizer_is_symbol (t, '='))
+  // SUM or DOT, unless it is the name of the array being assigned
+  if (tokenizer_is_word (t) && tokenizer_peek_char (t) != '=')
     {
-    tokenizer_next (t, error);
-    if (*error) 
+    uint8_t len;
+    const char *word = tokenizer_get_word (t, &len);
+    if (strings_compare_index_n (word, len, STRING_INDEX_SUM))
       {
-      free (var_name_2);
+      parser_branch_mat_reduce (self, t, FALSE, error);
       return;
       }
-    VARTYPE v = parser_branch_expr (self, t, error);
-    if (*error) 
+    if (strings_compare_index_n (word, len, STRING_INDEX_DOT))
       {
-      free (var_name_2);
+      parser_branch_mat_reduce (self, t, TRUE, error);
       return;
       }
-    variabletable_set_number (self->vt, var_name_2, v, error);
-    free (var_name_2);
     }
-  else
+
+  UVARTYPE bound;
+  VARTYPE *c = parser_branch_array (self, t, &bound, error);
+  if (*error) return;
+  if (!tokenizer_is_symbol (t, '='))
     {
     *error = BASIC_ERR_VAR_NO_EQ;
+    return;
+    }
+  tokenizer_next (t, error);
+  if (*error) return;
+  VARTYPE *a = parser_branch_mat_operand (self, t, bound, error);
+  if (*error) return;
+
+  size_t n = (size_t)bound + 1;
+  char op = tokenizer_get_sym (t);
+  if (op == '+' || op == '-')
+    {
+    tokenizer_next (t, error);
+    if (*error) return;
+    VARTYPE *b = parser_branch_mat_operand (self, t, bound, error);
+    if (*error) return;
+    if (op == '+')
+      mat_add (c, a, b, n);
+    else
+      mat_sub (c, a, b, n);
+    }
+  else if (op == '*')
+    {
+    tokenizer_next (t, error);
+    if (*error) return;
+    VARTYPE k = parser_branch_expr (self, t, error);
+    if (*error) return;
+    mat_scale (c, a, k, n);
     }
+  else if (c != a)
+    memcpy (c, a, n * sizeof (VARTYPE));
   }
 
-/*============================================================================
- * parser_parse_number
- * =========================================================================*/
-VARTYPE parser_parse_number (const char *s, uint8_t *conv)
+/*===========================================================================
+  parser_input_string
+  INPUT a$ reads a whole line
+===========================================================================*/
+static void parser_input_string (Parser *self, const char *name,
+         uint8_t len, uint8_t *error)
   {
-  // TODO -- I really need to unify all the number conversion functions
-  //  that are scattered throughout this code.
-  VARTYPE r;
-  *conv = basicprogram_get_line_number (s, &r);
-  return r;
+  char line [MAX_LINE];
+  interface_readstring (line, sizeof (line), error);
+  if (*error) return;
+  StringHandle *handle = variabletable_get_string (self->vt, name, len);
+  if (!handle)
+    handle = variabletable_new_string (self->vt, name, len, error);
+  if (*error) return;
+  // The line is not in the string heap, so the view need not be 
+  //   protected
+  StringView view;
+  view.data = line;
+  view.length = strlen (line);
+  stringheap_assign (variabletable_get_string_heap (self->vt), handle, 
+    &view, error);
   }
 
 /*===========================================================================
@@ -810,15 +2547,22 @@ static void parser_branch_input_statement (Parser *self,
 
   if (tokenizer_is_word (t))
     {
-    const char *word = tokenizer_get_word (t);
-    char s_num [MAX_NUMBER + 1];
+    uint8_t len;
+    const char *word = tokenizer_get_word (t, &len);
+    if (parser_is_string_name (word, len))
+      {
+      parser_input_string (self, word, len, error);
+      if (!*error) tokenizer_next (t, error);
+      return;
+      }
+    char s_num [MAX_NUMBER + FIXEDPOINT_FRACTION_CHARS + 1];
 
     uint8_t e = 0;
     // readstring can report various errors, which we need to handle.
     // As well as reporting that the input is too long for the buffer,
     //   we also have to handle a situation where the user hits ctrl+c
     //   in the middle of input
-    interface_readstring (s_num, MAX_NUMBER, &e);
+    interface_readstring (s_num, sizeof (s_num), &e);
     // Since we're entering a number, turn the "input too long"
     //   message into a more meaningful "number too long"
     if (e == BASIC_ERR_INPUT_TOO_LONG)
@@ -827,11 +2571,15 @@ static void parser_branch_input_statement (Parser *self,
       }
     if (e == 0)
       {
-      uint8_t converted = 0;
-      VARTYPE val = parser_parse_number (s_num, &converted);
-      if (converted > 0)
+      uint8_t digits;
+      VARTYPE val;
+      if (!numparse_number_prefix (s_num, &digits, &val))
+        {
+        *error = BASIC_ERR_NUMBER_TOO_LONG;
+        }
+      else if (digits > 0)
         {
-        variabletable_set_number (self->vt, word, val, error);
+        variabletable_set_number (self->vt, word, len, val, error);
         tokenizer_next (t, error);
         }
       else
@@ -859,9 +2607,10 @@ static void parser_branch_millis_statement (Parser *self,
 
   if (tokenizer_is_word (t))
     {
-    const char *word = tokenizer_get_word (t);
-    VARTYPE val = interface_millis();
-    variabletable_set_number (self->vt, word, val, error);
+    uint8_t len;
+    const char *word = tokenizer_get_word (t, &len);
+    VARTYPE val = FIXEDPOINT_FROM_INT (NUMWIDTH_WRAP (interface_millis()));
+    variabletable_set_number (self->vt, word, len, val, error);
     tokenizer_next (t, error);
     }
   else
@@ -881,7 +2630,7 @@ static void parser_branch_peek_statement (Parser *self,
   tokenizer_next (t, error); // Skip PEEK 
   if (*error) return;
 
-  VARTYPE address = parser_branch_expr (self, t, error);
+  VARTYPE address = parser_branch_int_expr (self, t, error);
   if (*error) return;
 
   if (!tokenizer_is_symbol (t, ','))
@@ -895,9 +2644,10 @@ static void parser_branch_peek_statement (Parser *self,
 
   if (tokenizer_is_word (t))
     {
-    const char *word = tokenizer_get_word (t);
-    VARTYPE val = interface_peek (address);
-    variabletable_set_number (self->vt, word, val, error);
+    uint8_t len;
+    const char *word = tokenizer_get_word (t, &len);
+    VARTYPE val = FIXEDPOINT_FROM_INT (interface_peek (address));
+    variabletable_set_number (self->vt, word, len, val, error);
     tokenizer_next (t, error);
     }
   else
@@ -915,7 +2665,7 @@ static void parser_branch_digitalwrite_statement (Parser *self,
   tokenizer_next (t, error); // Skip SETPIN
   if (*error) return;
 
-  VARTYPE pin = parser_branch_expr (self, t, error);
+  VARTYPE pin = parser_branch_int_expr (self, t, error);
   if (*error) return;
 
   if (!tokenizer_is_symbol (t, ','))
@@ -927,7 +2677,7 @@ static void parser_branch_digitalwrite_statement (Parser *self,
   tokenizer_next (t, error);
   if (*error) return;
 
-  VARTYPE value = parser_branch_expr (self, t, error);
+  VARTYPE value = parser_branch_int_expr (self, t, error);
   if (*error) return;
 
   interface_digitalwrite (pin, value);
@@ -942,7 +2692,7 @@ static void parser_branch_analogwrite_statement (Parser *self,
   tokenizer_next (t, error); // Skip SETPIN
   if (*error) return;
 
-  VARTYPE pin = parser_branch_expr (self, t, error);
+  VARTYPE pin = parser_branch_int_expr (self, t, error);
   if (*error) return;
 
   if (!tokenizer_is_symbol (t, ','))
@@ -954,7 +2704,7 @@ static void parser_branch_analogwrite_statement (Parser *self,
   tokenizer_next (t, error);
   if (*error) return;
 
-  VARTYPE value = parser_branch_expr (self, t, error);
+  VARTYPE value = parser_branch_int_expr (self, t, error);
   if (*error) return;
 
   interface_analogwrite (pin, value);
@@ -969,7 +2719,7 @@ static void parser_branch_poke_statement (Parser *self,
   tokenizer_next (t, error); // Skip POKE
   if (*error) return;
 
-  VARTYPE addr = parser_branch_expr (self, t, error);
+  VARTYPE addr = parser_branch_int_expr (self, t, error);
   if (*error) return;
 
   if (!tokenizer_is_symbol (t, ','))
@@ -981,7 +2731,7 @@ static void parser_branch_poke_statement (Parser *self,
   tokenizer_next (t, error);
   if (*error) return;
 
-  VARTYPE value = parser_branch_expr (self, t, error);
+  VARTYPE value = parser_branch_int_expr (self, t, error);
   if (*error) return;
 
   interface_poke (addr, value);
@@ -996,7 +2746,7 @@ static void parser_branch_pinmode_statement (Parser *self,
   tokenizer_next (t, error); // Skip SETPIN
   if (*error) return;
 
-  VARTYPE pin = parser_branch_expr (self, t, error);
+  VARTYPE pin = parser_branch_int_expr (self, t, error);
   if (*error) return;
 
   if (!tokenizer_is_symbol (t, ','))
@@ -1008,7 +2758,7 @@ static void parser_branch_pinmode_statement (Parser *self,
   tokenizer_next (t, error);
   if (*error) return;
 
-  VARTYPE value = parser_branch_expr (self, t, error);
+  VARTYPE value = parser_branch_int_expr (self, t, error);
   if (*error) return;
 
   interface_pinmode (pin, value);
@@ -1023,7 +2773,7 @@ static void parser_branch_analogread_statement (Parser *self,
   tokenizer_next (t, error); // Skip GETPIN
   if (*error) return;
 
-  VARTYPE address = parser_branch_expr (self, t, error);
+  VARTYPE address = parser_branch_int_expr (self, t, error);
   if (*error) return;
 
   if (!tokenizer_is_symbol (t, ','))
@@ -1037,9 +2787,10 @@ static void parser_branch_analogread_statement (Parser *self,
 
   if (tokenizer_is_word (t))
     {
-    const char *word = tokenizer_get_word (t);
-    VARTYPE val = interface_analogread (address);
-    variabletable_set_number (self->vt, word, val, error);
+    uint8_t len;
+    const char *word = tokenizer_get_word (t, &len);
+    VARTYPE val = FIXEDPOINT_FROM_INT (interface_analogread (address));
+    variabletable_set_number (self->vt, word, len, val, error);
     tokenizer_next (t, error);
     }
   else
@@ -1057,7 +2808,7 @@ static void parser_branch_digitalread_statement (Parser *self,
   tokenizer_next (t, error); // Skip GETPIN
   if (*error) return;
 
-  VARTYPE address = parser_branch_expr (self, t, error);
+  VARTYPE address = parser_branch_int_expr (self, t, error);
   if (*error) return;
 
   if (!tokenizer_is_symbol (t, ','))
@@ -1071,9 +2822,10 @@ static void parser_branch_digitalread_statement (Parser *self,
 
   if (tokenizer_is_word (t))
     {
-    const char *word = tokenizer_get_word (t);
-    VARTYPE val = interface_digitalread (address);
-    variabletable_set_number (self->vt, word, val, error);
+    uint8_t len;
+    const char *word = tokenizer_get_word (t, &len);
+    VARTYPE val = FIXEDPOINT_FROM_INT (interface_digitalread (address));
+    variabletable_set_number (self->vt, word, len, val, error);
     tokenizer_next (t, error);
     }
   else
@@ -1091,14 +2843,14 @@ static void parser_branch_delay_statement (Parser *self,
   tokenizer_next (t, error); // Skip DELAY 
   if (*error) return;
 
-  VARTYPE d = parser_branch_expr (self, t, error);
+  VARTYPE d = parser_branch_int_expr (self, t, error);
   interface_delay (d);
   }
 
 /*===========================================================================
-  parser_branch_statement
+  parser_branch_single_statement
 ===========================================================================*/
-static void parser_branch_statement (Parser *self, 
+static void parser_branch_single_statement (Parser *self, 
          Tokenizer *t, uint8_t *error)
   {
   if (interface_check_stop ())
@@ -1107,112 +2859,173 @@ static void parser_branch_statement (Parser *self,
     return;
     }
 
-  if (tokenizer_is_word (t))
+  uint8_t keyword = tokenizer_get_keyword (t);
+  switch (keyword)
     {
-    const char *word = tokenizer_get_word (t);
-    if (strings_compare_index (word, STRING_INDEX_PRINT))
-      {
-      parser_branch_print_statement (self, t, error); 
-      }
-    else if (strcmp (word, "?") == 0)
-      {
+    case STRING_INDEX_PRINT:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_PRINT);
       parser_branch_print_statement (self, t, error); 
-      }
-    else if (strings_compare_index (word, STRING_INDEX_IF))
-      {
+      break;
+    case STRING_INDEX_IF:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_IF);
       parser_branch_if_statement (self, t, error); 
-      }
-    else if (strings_compare_index (word, STRING_INDEX_GOTO))
-      {
+      break;
+    case STRING_INDEX_GOTO:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_GOTO);
       parser_branch_goto_statement (self, t, error); 
-      }
-    else if (strings_compare_index (word, STRING_INDEX_GOSUB))
-      {
+      break;
+    case STRING_INDEX_GOSUB:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_GOSUB);
       parser_branch_gosub_statement (self, t, error); 
-      }
-    else if (strings_compare_index (word, STRING_INDEX_END))
-      {
+      break;
+    case STRING_INDEX_END:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_END);
       tokenizer_next (t, error);
       self->ended = TRUE;
-      }
-    else if (strings_compare_index (word, STRING_INDEX_RETURN))
-      {
+      break;
+    case STRING_INDEX_RETURN:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_RETURN);
       parser_branch_return_statement (self, t, error); 
-      }
-    else if (strings_compare_index (word, STRING_INDEX_REM))
-      {
+      break;
+    case STRING_INDEX_DEF:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_DEF);
+      parser_branch_def_statement (self, t, error); 
+      break;
+    case STRING_INDEX_LOCAL:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_LOCAL);
+      parser_branch_local_statement (self, t, error); 
+      break;
+    case STRING_INDEX_REM:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_REM);
       parser_branch_rem_statement (self, t, error); 
-      }
-    else if (strings_compare_index (word, STRING_INDEX_FOR))
-      {
+      break;
+    case STRING_INDEX_FOR:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_FOR);
       parser_branch_for_statement (self, t, error); 
-      }
-    else if (strings_compare_index (word, STRING_INDEX_NEXT))
-      {
+      break;
+    case STRING_INDEX_NEXT:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_NEXT);
       parser_branch_next_statement (self, t, error); 
-      }
-    else if (strings_compare_index (word, STRING_INDEX_INPUT))
-      {
+      break;
+    case STRING_INDEX_WHILE:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_WHILE);
+      parser_branch_while_statement (self, t, error); 
+      break;
+    case STRING_INDEX_WEND:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_WEND);
+      parser_branch_wend_statement (self, t, error); 
+      break;
+    case STRING_INDEX_REPEAT:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_REPEAT);
+      parser_branch_repeat_statement (self, t, error); 
+      break;
+    case STRING_INDEX_UNTIL:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_UNTIL);
+      parser_branch_until_statement (self, t, error); 
+      break;
+    case STRING_INDEX_INPUT:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_INPUT);
       parser_branch_input_statement (self, t, error); 
-      }
-    else if (strings_compare_index (word, STRING_INDEX_LET))
-      {
+      break;
+    case STRING_INDEX_LET:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_LET);
       tokenizer_next (t, error);
       if (*error) return;
       parser_branch_assignment (self, t, error);      
-      }
-    else if (strings_compare_index (word, STRING_INDEX_MILLIS))
-      {
+      break;
+    case STRING_INDEX_MILLIS:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_MILLIS);
       parser_branch_millis_statement (self, t, error); 
-      }
-    else if (strings_compare_index (word, STRING_INDEX_PEEK))
-      {
+      break;
+    case STRING_INDEX_PEEK:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_PEEK);
       parser_branch_peek_statement (self, t, error); 
-      }
-    else if (strings_compare_index (word, STRING_INDEX_DIGITALREAD))
-      {
+      break;
+    case STRING_INDEX_DIGITALREAD:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_DIGITALREAD);
       parser_branch_digitalread_statement (self, t, error); 
-      }
-    else if (strings_compare_index (word, STRING_INDEX_ANALOGREAD))
-      {
+      break;
+    case STRING_INDEX_ANALOGREAD:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_ANALOGREAD);
       parser_branch_analogread_statement (self, t, error); 
-      }
-    else if (strings_compare_index (word, STRING_INDEX_ANALOGWRITE))
-      {
+      break;
+    case STRING_INDEX_ANALOGWRITE:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_ANALOGWRITE);
       parser_branch_analogwrite_statement (self, t, error); 
-      }
-    else if (strings_compare_index (word, STRING_INDEX_DIGITALWRITE))
-      {
+      break;
+    case STRING_INDEX_DIGITALWRITE:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_DIGITALWRITE);
       parser_branch_digitalwrite_statement (self, t, error); 
-      }
-    else if (strings_compare_index (word, STRING_INDEX_PINMODE))
-      {
+      break;
+    case STRING_INDEX_PINMODE:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_PINMODE);
       parser_branch_pinmode_statement (self, t, error); 
-      }
-    else if (strings_compare_index (word, STRING_INDEX_POKE))
-      {
+      break;
+    case STRING_INDEX_POKE:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_POKE);
       parser_branch_poke_statement (self, t, error); 
-      }
-    else if (strings_compare_index (word, STRING_INDEX_DELAY))
-      {
+      break;
+    case STRING_INDEX_DIM:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_DIM);
+      parser_branch_dim_statement (self, t, error); 
+      break;
+    case STRING_INDEX_MAT:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_MAT);
+      parser_branch_mat_statement (self, t, error); 
+      break;
+    case STRING_INDEX_DELAY:
+      PARSER_BEGIN_STATEMENT (STRING_INDEX_DELAY);
       parser_branch_delay_statement (self, t, error); 
       // TODO: arduino bits 
-      }
-    else
-      {
-      // It's a word, but not a keyword. It might be "foo = 2"
-      parser_branch_assignment (self, t, error);      
-      }
-    } 
-  else
+      break;
+    case 0:
+      if (tokenizer_is_word (t))
+        {
+        // It's a word, but not a keyword. It might be "foo = 2"
+        PARSER_BEGIN_STATEMENT (STRING_INDEX_LET);
+        parser_branch_assignment (self, t, error);      
+        }
+      else
+        {
+        // Not a keyword or a variable
+        *error = BASIC_ERR_SYNTAX;
+        }
+      break;
+    default:
+      // A keyword that can't start a statement, like THEN
+      *error = BASIC_ERR_SYNTAX;
+    }
+  }
+
+/*===========================================================================
+  parser_branch_statement
+  Run a statement, and any more that follow it on the line, separated 
+    by ':'. A statement that jumps leaves the tokenizer at the end of a
+    line, so the ones after it don't run. The statements after an ELSE 
+    are only for when an IF's condition does not hold, so when one is
+    reached here, the rest of the line is skipped.
+===========================================================================*/
+static void parser_branch_statement (Parser *self, 
+         Tokenizer *t, uint8_t *error)
+  {
+  for (;;)
     {
-    // Not a keyword or a variable
-    *error = BASIC_ERR_SYNTAX;
+    parser_branch_single_statement (self, t, error);
+    // Most statements are the last on their line
+    if (*error || tokenizer_is_eol (t) || self->ended) return;
+    if (!tokenizer_is_symbol (t, ':')) break;
+    tokenizer_next (t, error);
+    if (*error) return;
     }
+  if (tokenizer_is_keyword (t, STRING_INDEX_ELSE))
+    tokenizer_skip_line (t);
   }
 
 /*===========================================================================
   parser_numbered_statement
+  A jump can come back to the middle of a line: to the start of a
+    statement, or to the ':' at the end of one. current_line is then 
+    already set by the statement that jumped.
 ===========================================================================*/
 static void parser_branch_numbered_statement (Parser *self, 
          Tokenizer *t, uint8_t *error)
@@ -1221,26 +3034,37 @@ static void parser_branch_numbered_statement (Parser *self,
     {
     VARTYPE r = tokenizer_get_number_value (t);
     self->current_line = r;
+    self->current_statement = 0;
+    self->line_hook (self, r);
     tokenizer_next (t, error);
     if (*error) return;
-    parser_branch_statement (self, t, error);
     }
-  else
+  else if (tokenizer_is_symbol (t, ':'))
     {
-    *error = BASIC_ERR_NO_LINE_NUM;
+    tokenizer_next (t, error);
+    if (*error) return;
     }
+  parser_branch_statement (self, t, error);
   }
 
 /*===========================================================================
   parser_run_from_pos
 ===========================================================================*/
-static void parser_run_from_pos (Parser *self, const char *pos)
+static void parser_run_from_pos (Parser *self, TokenizerPos pos)
   {
-  Tokenizer *t = tokenizer_new (pos);
+  Tokenizer *t = parser_new_tokenizer (self);
+  tokenizer_set_line_pos (t, pos);
 
-  self->gosub_stack_ptr = 0;
+  callstack_clear (self->calls);
   self->for_stack_ptr = 0;
+  self->current_statement = 0;
   self->ended = FALSE;
+  // A program that stopped with an error may have left string views
+  //   protected, which are no longer valid
+  stringheap_release (variabletable_get_string_heap (self->vt), 0);
+#ifdef SAMPLER
+  parser_active = self;
+#endif
   uint8_t error = 0;
   tokenizer_next (t, &error); 
   // TODO handle error 
@@ -1257,13 +3081,12 @@ static void parser_run_from_pos (Parser *self, const char *pos)
       }
     } while (!error && !tokenizer_finished (t) && !self->ended);
 
+#ifdef SAMPLER
+  parser_active = NULL;
+#endif
   tokenizer_destroy (t);
   // Clear FOR stack in case the program did not do enough
   //  NEXTs
-  for (int i = 0; i < self->for_stack_ptr; i++)
-    {
-    free (self->for_stack[i].var_name);
-    }
   self->for_stack_ptr = 0;
   }
 
@@ -1272,10 +3095,73 @@ static void parser_run_from_pos (Parser *self, const char *pos)
 ===========================================================================*/
 void parser_run (Parser *self)
   {
-  self->gosub_stack_ptr = 0;
-  parser_run_from_pos (self, basicprogram_c_str (self->bp));
+#ifdef STATS
+  stats_clear ();
+#endif
+  parser_run_from_pos (self, 0);
   }
 
+#ifdef PROFILER
+/*===========================================================================
+  parser_line_hook_profile
+===========================================================================*/
+static void parser_line_hook_profile (Parser *self, VARTYPE line)
+  {
+  profiler_enter_line (self->profiler, line);
+  }
+
+/*===========================================================================
+  parser_run_profiled
+===========================================================================*/
+void parser_run_profiled (Parser *self)
+  {
+  int l = self->line_index_length;
+  self->profiler = profiler_new (l);
+  if (!self->profiler)
+    {
+    strings_output_string (BASIC_ERR_NOMEM);
+    interface_output_endl();
+    return;
+    }
+  for (int i = 0; i < l; i++)
+    {
+    const LineIndexEntry *lie = &self->line_index [i];
+    profiler_set_line (self->profiler, i, lie->n);
+    }
+
+  self->line_hook = parser_line_hook_profile;
+  parser_run (self);
+  self->line_hook = parser_line_hook_none;
+
+  profiler_report (self->profiler);
+  profiler_destroy (self->profiler);
+  self->profiler = NULL;
+  }
+#endif
+
+#ifdef SAMPLER
+/*===========================================================================
+  parser_sample_active
+  This is called from a signal handler, so it must not do anything 
+    except copy data. The data may be slightly inconsistent, if the
+    signal arrives in the middle of a GOSUB or RETURN, but that's
+    the nature of sampling.
+===========================================================================*/
+BOOL parser_sample_active (ParserSample *sample)
+  {
+  const Parser *self = parser_active;
+  if (!self) return FALSE;
+  int depth = callstack_depth (self->calls);
+  if (depth > PARSER_SAMPLE_DEPTH) depth = PARSER_SAMPLE_DEPTH;
+  sample->line = self->current_line;
+  sample->statement = self->current_statement;
+  sample->depth = (uint8_t)depth;
+  for (uint8_t i = 0; i < depth; i++)
+    sample->gosub_lines[i] = callstack_line (self->calls, i);
+  return TRUE;
+  }
+#endif
+
 /*===========================================================================
   parser_set_variable_table
 ===========================================================================*/
@@ -1286,18 +3172,33 @@ void parser_set_variable_table (Parser *self, VariableTable *vt)
 
 /*===========================================================================
   parser_run_line
-  // Line must end in \n
+  // Line must end in \n, and have been crunched by tokenizer_crunch()
 ===========================================================================*/
 void parser_run_line (Parser *self, const char *line)
   {
-  self->gosub_stack_ptr = 0;
+  callstack_clear (self->calls);
+  // Loops started by an earlier line can't be gone back to
+  self->for_stack_ptr = 0;
+  self->immediate = TRUE;
+  stringheap_release (variabletable_get_string_heap (self->vt), 0);
   Tokenizer *t = tokenizer_new (line);
+  self->ended = FALSE;
   uint8_t error = 0;
   tokenizer_next (t, &error);
-  if (error == 0)
-    parser_branch_statement (self, t, &error);
+  // A loop on the line jumps back to an earlier statement on it, and 
+  //   carries on from there, as parser_run_from_pos() does
+  while (!error && !self->ended && !tokenizer_finished (t))
+    {
+    if (tokenizer_is_symbol (t, ':'))
+      tokenizer_next (t, &error);
+    if (!error)
+      parser_branch_statement (self, t, &error);
+    if (!error)
+      tokenizer_next (t, &error);
+    }
   parser_emit_if_error (self, t, error); 
   tokenizer_destroy (t);
+  self->immediate = FALSE;
   }
 
 /*===========================================================================
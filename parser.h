@@ -18,6 +18,23 @@
 struct _Parser;
 typedef struct _Parser Parser;
 
+#ifdef SAMPLER
+// The number of GOSUB lines that a sample records. Deeper calls are
+//   reported as if they came from the last of these
+#define PARSER_SAMPLE_DEPTH 10
+
+// A snapshot of where the running program is, for the sampling profiler.
+//   statement is the string table index of the statement's keyword,
+//   or zero if no statement has started yet.
+typedef struct _ParserSample
+  {
+  VARTYPE line;
+  uint8_t statement;
+  uint8_t depth;
+  VARTYPE gosub_lines [PARSER_SAMPLE_DEPTH];
+  } ParserSample;
+#endif
+
 BEGIN_DECLS
 
 extern Parser     *parser_new (void);
@@ -26,9 +43,21 @@ extern void        parser_destroy (Parser *self);
 extern BOOL        parser_set_program (Parser *self, const BasicProgram *bp);
 extern void        parser_set_variable_table (Parser *self, VariableTable *vt);
 extern void        parser_run (Parser *self);
+#ifdef PROFILER
+/** Run the program, as parser_run(), and then write a report of the 
+ *    execution count and time of each line. */
+extern void        parser_run_profiled (Parser *self);
+#endif
 
 extern void        parser_run_line (Parser *self, const char *line);
 extern void        parser_clear_variables (Parser *self);
 
+#ifdef SAMPLER
+/** Take a snapshot of the program that is running, if there is one. This
+ *    is safe to call from a signal handler. Returns FALSE if no program
+ *    is running. */
+extern BOOL        parser_sample_active (ParserSample *sample);
+#endif
+
 END_DECLS
 
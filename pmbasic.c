@@ -24,6 +24,12 @@
 #include "strings.h"
 #include "variabletable.h"
 #include "tokenizer.h"
+#include "stats.h"
+#include "heap.h"
+#include "eeprom.h"
+#include "numparse.h"
+#include "numwidth.h"
+#include "fixedpoint.h"
 
 static char line [MAX_LINE];
 
@@ -42,41 +48,27 @@ typedef struct
  * =========================================================================*/
 #define LID ((ListIteratorData*) user_data)
 static BOOL pmbasic_list_line_iterator (const BasicProgram *bp,
-                 const char *b, const char *e, void *user_data)
+                 VARTYPE line_num, TokenizerPos b, TokenizerPos e, 
+                 void *user_data)
   {
-  (void)bp;
-  VARTYPE line_num;
-  if (basicprogram_get_line_number (b, &line_num))
+  if (line_num >= LID->from)
     {
-    if (line_num >= LID->from)
+    if  ( (LID->n < LID->count) || (LID->count == 0) )
       {
-      if  ( (LID->n < LID->count) || (LID->count == 0) )
-        {
-        int n = e - b;
-        strncpy (line, b, MAX_LINE);
-        line [n] = 0;
-        interface_output_string (line);
-        interface_output_endl();
-        LID->n++;
-        }
+      const char *str = basicprogram_c_str (bp);
+      interface_output_number (line_num);
+      interface_output_string (" ");
+      tokenizer_expand (str + b + BASICPROGRAM_HEADER_SIZE, str + e, 
+        line, sizeof (line));
+      interface_output_string (line);
+      interface_output_endl();
+      LID->n++;
       }
     }
 
   return TRUE;
   }
 
-/*============================================================================
- * pmbasic_parse_number
- * =========================================================================*/
-VARTYPE pmbasic_parse_number (const char *s, uint8_t *conv)
-  {
-  // TODO -- I really need to unify all the number conversion functions
-  //  that are scattered throughout this code.
-  VARTYPE r;
-  *conv = basicprogram_get_line_number (s, &r);
-  return r;
-  }
-
 /*============================================================================
  * pmbasic_list
  * =========================================================================*/
@@ -85,12 +77,13 @@ static void pmbasic_list (const BasicProgram *bp, int argc, char **argv)
   int from = 0;
   int count = 0;
 
-  uint8_t conv;
-  if (argc > 1)
-    from = pmbasic_parse_number (argv[1], &conv);
-  if (argc > 2)
-    count = pmbasic_parse_number (argv[2], &conv);
+  uint8_t digits;
+  VARTYPE n;
   // TODO check conversion errors
+  if (argc > 1 && numparse_prefix (argv[1], &digits, &n))
+    from = n;
+  if (argc > 2 && numparse_prefix (argv[2], &digits, &n))
+    count = n;
 
   ListIteratorData ild;
   ild.from = from;
@@ -107,7 +100,7 @@ static void pmbasic_save (const BasicProgram *bp, int argc, char **argv)
   {
   (void)argc;
   (void)argv;
-  interface_save (bp);
+  eeprom_save (bp);
   }
 
 /*============================================================================
@@ -117,7 +110,7 @@ static void pmbasic_load (BasicProgram *bp, int argc, char **argv)
   {
   (void)argc;
   (void)argv;
-  interface_load (bp);
+  eeprom_load (bp);
   }
 
 /*============================================================================
@@ -128,6 +121,14 @@ static void pmbasic_info (const BasicProgram *bp, int argc, char **argv)
   (void)bp;
   (void)argc;
   (void)argv;
+
+#ifdef STATS
+  if (argc > 1 && strings_compare_index (argv[1], STRING_INDEX_STATS))
+    {
+    stats_report ();
+    return;
+    }
+#endif
   
   strings_output_string (STRING_INDEX_VERSION);
   interface_output_endl ();
@@ -136,9 +137,122 @@ static void pmbasic_info (const BasicProgram *bp, int argc, char **argv)
   interface_output_string (" ");
   strings_output_string (STRING_INDEX_BYTES);
   interface_output_endl ();
+  strings_output_string (STRING_INDEX_WIDTH_TEXT);
+  interface_output_number (NUMWIDTH_BITS);
+  interface_output_string (" ");
+  strings_output_string (STRING_INDEX_BITS);
+  interface_output_endl ();
+#ifdef FIXED_POINT
+  strings_output_string (STRING_INDEX_FIXED_TEXT);
+  strings_output_string (FIXEDPOINT_ON ? STRING_INDEX_ON : STRING_INDEX_OFF);
+  interface_output_endl ();
+#endif
 
   interface_info ();
+#ifdef STATIC_POOLS
+  strings_output_string (STRING_INDEX_POOL_VARIABLES);
+  interface_output_number (VARIABLE_ARENA_SIZE);
+  interface_output_string (" ");
+  strings_output_string (STRING_INDEX_BYTES);
+  interface_output_endl ();
+  strings_output_string (STRING_INDEX_POOL_LINES);
+  interface_output_number (POOL_LINES);
+  interface_output_endl ();
+  strings_output_string (STRING_INDEX_POOL_LOOPS);
+  interface_output_number (POOL_LOOPS);
+  interface_output_endl ();
+  strings_output_string (STRING_INDEX_POOL_FUNCTIONS);
+  interface_output_number (POOL_FUNCTIONS);
+  interface_output_endl ();
+  strings_output_string (STRING_INDEX_POOL_LOCALS);
+  interface_output_number (POOL_LOCALS);
+  interface_output_endl ();
+  strings_output_string (STRING_INDEX_POOL_ARRAYS);
+  interface_output_number (POOL_ARRAYS);
+  interface_output_string (" ");
+  strings_output_string (STRING_INDEX_BYTES);
+  interface_output_endl ();
+  strings_output_string (STRING_INDEX_POOL_STRINGS);
+  interface_output_number (POOL_STRINGS);
+  interface_output_string (" ");
+  strings_output_string (STRING_INDEX_BYTES);
+  interface_output_endl ();
+#endif
+#ifdef HEAPSTATS
+  heap_report ();
+#endif
+  }
+
+#ifdef RUNTIME_WIDTH
+/*============================================================================
+ * pmbasic_width
+ * Changing the width clears the variables, which might hold numbers
+ *   that are too large for the new one.
+ * =========================================================================*/
+static void pmbasic_width (Parser *parser, int argc, char **argv)
+  {
+  if (argc < 2)
+    {
+    strings_output_string (STRING_INDEX_WIDTH_TEXT);
+    interface_output_number (NUMWIDTH_BITS);
+    interface_output_string (" ");
+    strings_output_string (STRING_INDEX_BITS);
+    interface_output_endl ();
+    return;
+    }
+  uint8_t digits;
+  VARTYPE n;
+  if (!numparse_prefix (argv[1], &digits, &n) || n <= 0 || n > 64) 
+    n = 0;
+  if (FIXEDPOINT_ON && n > 0 && n < 32)
+    {
+    strings_output_string (BASIC_ERR_FIXED_WIDTH); 
+    interface_output_endl();
+    }
+  else if (numwidth_set ((uint8_t)n))
+    {
+    parser_clear_variables (parser);
+    }
+  else
+    {
+    strings_output_string (BASIC_ERR_BAD_WIDTH); 
+    interface_output_endl();
+    }
+  }
+#endif
+
+#ifdef FIXED_POINT
+/*============================================================================
+ * pmbasic_fixed
+ * Switching fixed-point mode on or off clears the variables, whose 
+ *   values would otherwise mean something different.
+ * =========================================================================*/
+static void pmbasic_fixed (Parser *parser, int argc, char **argv)
+  {
+  if (argc < 2)
+    {
+    strings_output_string (STRING_INDEX_FIXED_TEXT);
+    strings_output_string (FIXEDPOINT_ON ? STRING_INDEX_ON : STRING_INDEX_OFF);
+    interface_output_endl ();
+    }
+  else if (strings_compare_index (argv[1], STRING_INDEX_ON)
+       || strings_compare_index (argv[1], STRING_INDEX_OFF))
+    {
+    if (fixedpoint_set (strings_compare_index (argv[1], STRING_INDEX_ON)))
+      parser_clear_variables (parser);
+    else
+      {
+      strings_output_string (BASIC_ERR_FIXED_WIDTH); 
+      interface_output_endl();
+      }
+    }
+  else
+    {
+    strings_output_string (BASIC_ERR_SYNTAX); 
+    interface_output_endl();
+    }
   }
+#endif
 
 /*============================================================================
  * pmbasic_help
@@ -158,17 +272,44 @@ static void pmbasic_help (const BasicProgram *bp, int argc, char **argv)
 
 /*============================================================================
  * pmbasic_run
+ * "RUN EEPROM" runs the saved program where it is, without loading it,
+ *   so the program in memory is left alone.
  * =========================================================================*/
 static void pmbasic_run (Parser* parser, const BasicProgram *bp, 
                int argc, char **argv)
   {
+  if (argc > 1 && strings_compare_index (argv[1], STRING_INDEX_EEPROM))
+    {
+    BasicProgram *ebp = eeprom_program_new ();
+    if (ebp)
+      {
+      if (parser_set_program (parser, ebp))
+        parser_run (parser);
+      parser_set_program (parser, bp);
+      basicprogram_destroy (ebp);
+      }
+    }
+  else if (parser_set_program (parser, bp))
+    {
+    parser_run (parser); // Reports its own erors
+    }
+  }
+
+#ifdef PROFILER
+/*============================================================================
+ * pmbasic_profile
+ * =========================================================================*/
+static void pmbasic_profile (Parser* parser, const BasicProgram *bp, 
+               int argc, char **argv)
+  {
   (void)argc;
   (void)argv;
   if (parser_set_program (parser, bp))
     {
-    parser_run (parser); // Reports its own erors
+    parser_run_profiled (parser); 
     }
   }
+#endif
 
 /*===========================================================================
   pmbasic_do_immediate
@@ -181,7 +322,9 @@ static void pmbasic_do_immediate (BasicProgram *bp, Parser *parser,
   strncpy (iline2, line, MAX_LINE - 1);
   int argc = 0;
   char *tok = strtok (iline2, " \t");
-  while (tok)
+  // Only commands have arguments, and none has more than MAX_ARGC
+  //   words; anything else is a statement, and is run from line
+  while (tok && argc < MAX_ARGC)
     {
     argv [argc] = tok;
     tok = strtok ((char *)0, " \t");
@@ -215,6 +358,7 @@ static void pmbasic_do_immediate (BasicProgram *bp, Parser *parser,
   else if (strings_compare_index (argv[0], STRING_INDEX_NEW))
     {
     basicprogram_clear (bp);
+    parser_clear_variables (parser);
     }
   else if (strings_compare_index (argv[0], STRING_INDEX_HELP))
     {
@@ -224,6 +368,24 @@ static void pmbasic_do_immediate (BasicProgram *bp, Parser *parser,
     {
     parser_clear_variables (parser);
     }
+#ifdef PROFILER
+  else if (strings_compare_index (argv[0], STRING_INDEX_PROFILE))
+    {
+    pmbasic_profile (parser, bp, argc, argv);
+    }
+#endif
+#ifdef RUNTIME_WIDTH
+  else if (strings_compare_index (argv[0], STRING_INDEX_WIDTH))
+    {
+    pmbasic_width (parser, argc, argv);
+    }
+#endif
+#ifdef FIXED_POINT
+  else if (strings_compare_index (argv[0], STRING_INDEX_FIXED))
+    {
+    pmbasic_fixed (parser, argc, argv);
+    }
+#endif
   else if (strings_compare_index (argv[0], STRING_INDEX_GOTO))
     {
     strings_output_string (BASIC_ERR_UNSUP_IMMEDIATE); 
@@ -238,6 +400,7 @@ static void pmbasic_do_immediate (BasicProgram *bp, Parser *parser,
     {
     strncpy (iline2, line, MAX_LINE - 1);
     strcat (iline2, "\n");
+    tokenizer_crunch (iline2, iline2);
     parser_run_line (parser, iline2);
     }
 
@@ -260,6 +423,11 @@ static void pmbasic_process_line (BasicProgram *bp, const char *line)
       interface_output_endl();
       break;
 
+    case BASICPROGRAM_NOMEM:
+      strings_output_string (BASIC_ERR_NOMEM); 
+      interface_output_endl();
+      break;
+
     case BASICPROGRAM_LINE_DELETED:
       strings_output_string (STRING_INDEX_LINE_DELETED);
       interface_output_endl();
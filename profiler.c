@@ -0,0 +1,172 @@
+/*===========================================================================
+
+  pmbasic
+
+  profiler.c
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#include <stdlib.h>
+#include "config.h"
+#include "defs.h"
+#include "profiler.h"
+#include "heap.h"
+#include "interface.h"
+#include "strings.h"
+
+#ifdef PROFILER
+
+typedef struct _ProfileEntry
+  {
+  VARTYPE n;
+  uint32_t count;
+  uint32_t usec;
+  } ProfileEntry;
+
+/*===========================================================================
+  Profiler
+===========================================================================*/
+struct _Profiler
+  {
+  ProfileEntry *entries;
+  int lines;
+  // The entry for the line currently executing, if any, and the time
+  //   at which it started
+  ProfileEntry *current;
+  uint32_t start;
+  };
+
+/*===========================================================================
+  profiler_new
+===========================================================================*/
+Profiler *profiler_new (int lines)
+  {
+  Profiler *self = HEAP_MALLOC (HEAP_SITE_PROFILER, sizeof (Profiler));
+  if (self)
+    {
+    self->entries = HEAP_CALLOC (HEAP_SITE_PROFILER, lines > 0 ? lines : 1,
+      sizeof (ProfileEntry));
+    if (!self->entries)
+      {
+      HEAP_FREE (HEAP_SITE_PROFILER, self);
+      return NULL;
+      }
+    self->lines = lines;
+    self->current = NULL;
+    self->start = 0;
+    }
+  return self;
+  }
+
+/*===========================================================================
+  profiler_destroy
+===========================================================================*/
+void profiler_destroy (Profiler *self)
+  {
+  if (self)
+    {
+    HEAP_FREE (HEAP_SITE_PROFILER, self->entries);
+    HEAP_FREE (HEAP_SITE_PROFILER, self);
+    }
+  }
+
+/*===========================================================================
+  profiler_set_line
+===========================================================================*/
+void profiler_set_line (Profiler *self, int i, VARTYPE n)
+  {
+  if (i >= 0 && i < self->lines)
+    self->entries[i].n = n;
+  }
+
+/*===========================================================================
+  profiler_find_line
+  Lines are stored in ascending order, so we can do a binary search
+===========================================================================*/
+static ProfileEntry *profiler_find_line (Profiler *self, VARTYPE n)
+  {
+  int lo = 0;
+  int hi = self->lines - 1;
+  while (lo <= hi)
+    {
+    int mid = (lo + hi) / 2;
+    VARTYPE m = self->entries[mid].n;
+    if (m == n) return &self->entries[mid];
+    if (m < n)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+    }
+  return NULL;
+  }
+
+/*===========================================================================
+  profiler_stop
+===========================================================================*/
+void profiler_stop (Profiler *self)
+  {
+  if (self->current)
+    {
+    self->current->usec += interface_micros() - self->start;
+    self->current = NULL;
+    }
+  }
+
+/*===========================================================================
+  profiler_enter_line
+===========================================================================*/
+void profiler_enter_line (Profiler *self, VARTYPE n)
+  {
+  uint32_t now = interface_micros();
+  if (self->current)
+    self->current->usec += now - self->start;
+  self->current = profiler_find_line (self, n);
+  if (self->current)
+    self->current->count++;
+  self->start = now;
+  }
+
+/*===========================================================================
+  profiler_compare_hottest
+===========================================================================*/
+static int profiler_compare_hottest (const void *p1, const void *p2)
+  {
+  const ProfileEntry *e1 = p1;
+  const ProfileEntry *e2 = p2;
+  if (e1->usec != e2->usec) return e1->usec < e2->usec ? 1 : -1;
+  if (e1->count != e2->count) return e1->count < e2->count ? 1 : -1;
+  return e1->n < e2->n ? -1 : 1;
+  }
+
+/*===========================================================================
+  profiler_report
+  Note that the entries are sorted in place, so the profiler can't
+    be used again after this.
+===========================================================================*/
+void profiler_report (Profiler *self)
+  {
+  profiler_stop (self);
+  qsort (self->entries, self->lines, sizeof (ProfileEntry),
+    profiler_compare_hottest);
+  self->current = NULL;
+
+  strings_output_string (STRING_INDEX_PROFILE_HEADER);
+  interface_output_endl ();
+  for (int i = 0; i < self->lines; i++)
+    {
+    const ProfileEntry *e = &self->entries[i];
+    if (e->count == 0) continue;
+    interface_output_number (e->n);
+    interface_output_string ("\t");
+    interface_output_number (e->count);
+    interface_output_string ("\t");
+    interface_output_number (e->usec);
+    interface_output_string ("\t");
+    interface_output_number ((uint64_t)e->usec * 1000 / e->count);
+    interface_output_endl ();
+    }
+  }
+
+#endif
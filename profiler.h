@@ -0,0 +1,47 @@
+/*===========================================================================
+
+  pmbasic
+
+  profiler.h
+
+  This class collects per-line execution counts and times, for the
+  PROFILE command. The parser calls profiler_enter_line() every time it
+  starts a numbered line; the time between one call and the next is
+  charged to the line that was being executed.
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#pragma once
+
+#include "defs.h"
+#include "config.h"
+
+struct _Profiler;
+typedef struct _Profiler Profiler;
+
+BEGIN_DECLS
+
+/** Create a profiler with space for the specified number of lines. The
+ *    line numbers must then be supplied, in ascending order, using
+ *    profiler_set_line(). Returns NULL if there is not enough memory. */
+extern Profiler *profiler_new (int lines);
+extern void      profiler_destroy (Profiler *self);
+
+extern void      profiler_set_line (Profiler *self, int i, VARTYPE n);
+
+/** Note that line n is starting. Lines that were not registered using
+ *    profiler_set_line() are silently ignored. */
+extern void      profiler_enter_line (Profiler *self, VARTYPE n);
+
+/** Charge any outstanding time to the line that was last entered. Call
+ *    this when the program stops. */
+extern void      profiler_stop (Profiler *self);
+
+/** Write the results, hottest line first, using the interface_output
+ *    functions. Lines that were never executed are not shown. */
+extern void      profiler_report (Profiler *self);
+
+END_DECLS
+
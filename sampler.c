@@ -0,0 +1,222 @@
+/*===========================================================================
+
+  pmbasic
+
+  sampler.c
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+#include "config.h"
+#include "defs.h"
+#include "sampler.h"
+#include "heap.h"
+#include "parser.h"
+#include "strings.h"
+
+#ifdef SAMPLER
+
+// Size of the ring buffer, in samples. Must be a power of two
+#define SAMPLER_RING_SIZE 16384
+
+typedef struct _SamplerStack
+  {
+  ParserSample sample;
+  uint32_t count;
+  } SamplerStack;
+
+volatile int sampler_drain_wanted = 0;
+
+// The ring buffer. Only the signal handler writes ring_head, and only
+//   sampler_drain() writes ring_tail, so no locking is needed.
+static ParserSample ring [SAMPLER_RING_SIZE];
+static volatile uint32_t ring_head = 0;
+static volatile uint32_t ring_tail = 0;
+static volatile uint32_t dropped = 0;
+
+// Aggregated samples: an open-addressing hash table of distinct stacks
+static SamplerStack *stacks = NULL;
+static uint32_t stacks_size = 0;
+static uint32_t stacks_used = 0;
+
+static const char *output_filename = NULL;
+
+/*===========================================================================
+  sampler_signal_handler
+===========================================================================*/
+static void sampler_signal_handler (int sig)
+  {
+  (void)sig;
+  uint32_t head = ring_head;
+  uint32_t tail = __atomic_load_n (&ring_tail, __ATOMIC_ACQUIRE);
+  if (head - tail >= SAMPLER_RING_SIZE)
+    {
+    dropped++;
+    return;
+    }
+  if (parser_sample_active (&ring [head & (SAMPLER_RING_SIZE - 1)]))
+    {
+    __atomic_store_n (&ring_head, head + 1, __ATOMIC_RELEASE);
+    if (head + 1 - tail >= SAMPLER_RING_SIZE / 2)
+      sampler_drain_wanted = 1;
+    }
+  }
+
+/*===========================================================================
+  sampler_hash
+===========================================================================*/
+static uint32_t sampler_hash (const ParserSample *s)
+  {
+  uint32_t h = 2166136261u;
+  h = (h ^ (uint32_t)s->line) * 16777619u;
+  h = (h ^ s->statement) * 16777619u;
+  h = (h ^ s->depth) * 16777619u;
+  for (uint8_t i = 0; i < s->depth; i++)
+    h = (h ^ (uint32_t)s->gosub_lines[i]) * 16777619u;
+  return h;
+  }
+
+/*===========================================================================
+  sampler_same_stack
+===========================================================================*/
+static BOOL sampler_same_stack (const ParserSample *s1,
+              const ParserSample *s2)
+  {
+  if (s1->line != s2->line || s1->statement != s2->statement
+       || s1->depth != s2->depth)
+    return FALSE;
+  for (uint8_t i = 0; i < s1->depth; i++)
+    if (s1->gosub_lines[i] != s2->gosub_lines[i]) return FALSE;
+  return TRUE;
+  }
+
+/*===========================================================================
+  sampler_insert
+===========================================================================*/
+static void sampler_insert (SamplerStack *table, uint32_t size,
+               const ParserSample *s, uint32_t count)
+  {
+  uint32_t i = sampler_hash (s) & (size - 1);
+  while (table[i].count && !sampler_same_stack (&table[i].sample, s))
+    i = (i + 1) & (size - 1);
+  if (table[i].count == 0)
+    {
+    table[i].sample = *s;
+    stacks_used++;
+    }
+  table[i].count += count;
+  }
+
+/*===========================================================================
+  sampler_grow
+===========================================================================*/
+static BOOL sampler_grow (void)
+  {
+  uint32_t new_size = stacks_size ? stacks_size * 2 : 256;
+  SamplerStack *new_stacks = HEAP_CALLOC (HEAP_SITE_PROFILER, new_size, sizeof (SamplerStack));
+  if (!new_stacks) return FALSE;
+  stacks_used = 0;
+  for (uint32_t i = 0; i < stacks_size; i++)
+    {
+    if (stacks[i].count)
+      sampler_insert (new_stacks, new_size, &stacks[i].sample,
+        stacks[i].count);
+    }
+  HEAP_FREE (HEAP_SITE_PROFILER, stacks);
+  stacks = new_stacks;
+  stacks_size = new_size;
+  return TRUE;
+  }
+
+/*===========================================================================
+  sampler_drain
+===========================================================================*/
+void sampler_drain (void)
+  {
+  sampler_drain_wanted = 0;
+  uint32_t head = __atomic_load_n (&ring_head, __ATOMIC_ACQUIRE);
+  uint32_t tail = ring_tail;
+  while (tail != head)
+    {
+    if ((stacks_used + 1) * 4 >= stacks_size * 3)
+      {
+      if (!sampler_grow ()) break;
+      }
+    sampler_insert (stacks, stacks_size,
+      &ring [tail & (SAMPLER_RING_SIZE - 1)], 1);
+    tail++;
+    }
+  __atomic_store_n (&ring_tail, tail, __ATOMIC_RELEASE);
+  }
+
+/*===========================================================================
+  sampler_write
+===========================================================================*/
+static void sampler_write (void)
+  {
+  // Stop the timer before we start writing
+  struct itimerval it;
+  memset (&it, 0, sizeof (it));
+  setitimer (ITIMER_PROF, &it, NULL);
+
+  sampler_drain ();
+
+  FILE *f = fopen (output_filename, "w");
+  if (!f)
+    {
+    perror (output_filename);
+    return;
+    }
+
+  char buff [TOKEN_MAX_LENGTH + 1];
+  for (uint32_t i = 0; i < stacks_size; i++)
+    {
+    const SamplerStack *st = &stacks[i];
+    if (st->count == 0) continue;
+    for (uint8_t j = 0; j < st->sample.depth; j++)
+      fprintf (f, "%ld;", (long)st->sample.gosub_lines[j]);
+    if (st->sample.statement)
+      strings_get (st->sample.statement, buff, sizeof (buff));
+    else
+      strcpy (buff, "?");
+    fprintf (f, "%ld:%s %u\n", (long)st->sample.line, buff,
+      (unsigned)st->count);
+    }
+  fclose (f);
+
+  if (dropped)
+    fprintf (stderr, "Sampler dropped %u samples\n", (unsigned)dropped);
+  }
+
+/*===========================================================================
+  sampler_start
+===========================================================================*/
+BOOL sampler_start (const char *filename, int hz)
+  {
+  if (hz <= 0 || hz > 1000000) return FALSE;
+  output_filename = filename;
+
+  struct sigaction sa;
+  memset (&sa, 0, sizeof (sa));
+  sa.sa_handler = sampler_signal_handler;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset (&sa.sa_mask);
+  if (sigaction (SIGPROF, &sa, NULL) != 0) return FALSE;
+
+  struct itimerval it;
+  it.it_interval.tv_sec = 0;
+  it.it_interval.tv_usec = 1000000 / hz;
+  it.it_value = it.it_interval;
+  if (setitimer (ITIMER_PROF, &it, NULL) != 0) return FALSE;
+
+  atexit (sampler_write);
+  return TRUE;
+  }
+
+#endif
@@ -0,0 +1,46 @@
+/*===========================================================================
+
+  pmbasic
+
+  sampler.h
+
+  A sampling profiler for the Linux build. An ITIMER_PROF timer raises
+  SIGPROF at regular intervals of CPU time, and the signal handler
+  records the line and statement that the interpreter is executing,
+  along with the GOSUB stack, in a ring buffer. The samples are
+  aggregated outside the signal handler, and written when the program
+  exits, in the 'collapsed stack' format used by flamegraph tools:
+
+    [gosub line];[gosub line];[line]:[statement] [count]
+
+  Unlike PROFILE, this does not add any work to each statement, so it
+  doesn't distort the timings of very tight loops.
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#pragma once
+
+#include "defs.h"
+#include "config.h"
+
+BEGIN_DECLS
+
+/** Set by the signal handler when the ring buffer is half full. The
+ *    interpreter should call sampler_drain() when it sees this. */
+extern volatile int sampler_drain_wanted;
+
+/** Start sampling at the specified rate, writing the results to the
+ *    specified file at exit. Returns FALSE if the timer could not be
+ *    started. */
+extern BOOL sampler_start (const char *filename, int hz);
+
+/** Move samples from the ring buffer into the aggregated results. This
+ *    must not be called from a signal handler. It is called at exit, but
+ *    calling it from time to time prevents the ring buffer filling
+ *    up when programs run for a long time. */
+extern void sampler_drain (void);
+
+END_DECLS
+
@@ -0,0 +1,122 @@
+/*===========================================================================
+
+  pmbasic
+
+  stats.c
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#include <string.h>
+#include "config.h"
+#include "defs.h"
+#include "stats.h"
+#include "strings.h"
+#include "interface.h"
+
+#ifdef STATS
+
+uint32_t stats_statements [STRINGS_NUM_KEYWORDS];
+uint32_t stats_operators [STATS_NUM_OPS];
+
+/*===========================================================================
+  stats_count_operator
+===========================================================================*/
+void stats_count_operator (char op)
+  {
+  const char *p = strchr (STATS_OPERATORS, op);
+  if (p && op) stats_operators[p - STATS_OPERATORS]++;
+  }
+
+/*===========================================================================
+  stats_clear
+===========================================================================*/
+void stats_clear (void)
+  {
+  memset (stats_statements, 0, sizeof (stats_statements));
+  memset (stats_operators, 0, sizeof (stats_operators));
+  }
+
+/*===========================================================================
+  stats_get_total_statements
+===========================================================================*/
+uint32_t stats_get_total_statements (void)
+  {
+  uint32_t total = 0;
+  for (int i = 0; i < STRINGS_NUM_KEYWORDS; i++)
+    total += stats_statements[i];
+  return total;
+  }
+
+/*===========================================================================
+  stats_get_operator_name
+===========================================================================*/
+static const char *stats_get_operator_name (uint8_t i, char *buff)
+  {
+  if (i == STATS_OP_NEG) return "neg";
+  if (i == STATS_OP_NOT) return "not";
+  buff[0] = STATS_OPERATORS[i];
+  buff[1] = 0;
+  return buff;
+  }
+
+/*===========================================================================
+  stats_report
+===========================================================================*/
+void stats_report (void)
+  {
+  char buff [TOKEN_MAX_LENGTH + 1];
+  strings_output_string (STRING_INDEX_STATEMENTS);
+  interface_output_endl ();
+  for (uint8_t i = 0; i < STRINGS_NUM_KEYWORDS; i++)
+    {
+    if (stats_statements[i] == 0) continue;
+    interface_output_string ("  ");
+    strings_output_string (STRINGS_FIRST_KEYWORD + i);
+    interface_output_string (" ");
+    interface_output_number (stats_statements[i]);
+    interface_output_endl ();
+    }
+  strings_output_string (STRING_INDEX_OPERATORS);
+  interface_output_endl ();
+  for (uint8_t i = 0; i < STATS_NUM_OPS; i++)
+    {
+    if (stats_operators[i] == 0) continue;
+    interface_output_string ("  ");
+    interface_output_string (stats_get_operator_name (i, buff));
+    interface_output_string (" ");
+    interface_output_number (stats_operators[i]);
+    interface_output_endl ();
+    }
+  }
+
+#ifndef ARDUINO
+/*===========================================================================
+  stats_write_json
+===========================================================================*/
+void stats_write_json (FILE *f)
+  {
+  char buff [TOKEN_MAX_LENGTH + 1];
+  fprintf (f, "{\"total_statements\":%u,\"statements\":{",
+    (unsigned)stats_get_total_statements());
+  BOOL first = TRUE;
+  for (uint8_t i = 0; i < STRINGS_NUM_KEYWORDS; i++)
+    {
+    strings_get (STRINGS_FIRST_KEYWORD + i, buff, sizeof (buff));
+    if (!buff[0]) continue;
+    fprintf (f, "%s\"%s\":%u", first ? "" : ",", buff,
+      (unsigned)stats_statements[i]);
+    first = FALSE;
+    }
+  fprintf (f, "},\"operators\":{");
+  for (uint8_t i = 0; i < STATS_NUM_OPS; i++)
+    {
+    fprintf (f, "%s\"%s\":%u", i == 0 ? "" : ",",
+      stats_get_operator_name (i, buff), (unsigned)stats_operators[i]);
+    }
+  fprintf (f, "}}\n");
+  }
+#endif
+
+#endif
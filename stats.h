@@ -0,0 +1,69 @@
+/*===========================================================================
+
+  pmbasic
+
+  stats.h
+
+  Counters for the number of statements of each kind that have been
+  executed, and the number of times each arithmetic operator has been
+  evaluated. Statements are identified by the string-table index of
+  their keyword (assignments are counted as LET).
+
+  The parser uses the STATS_COUNT_ macros, which expand to nothing
+  unless STATS is defined in config.h, so there is no cost at all
+  when the counters are not built.
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#pragma once
+
+#include "defs.h"
+#include "config.h"
+#include "strings.h"
+
+// Operators are counted in the order they appear in this string. Unary
+//   minus and NOT come after them.
+#define STATS_OPERATORS "+-*/%&|<>="
+#define STATS_OP_NEG    (sizeof (STATS_OPERATORS) - 1)
+#define STATS_OP_NOT    (STATS_OP_NEG + 1)
+#define STATS_NUM_OPS   (STATS_OP_NOT + 1)
+
+#ifdef STATS
+
+#define STATS_COUNT_STATEMENT(index) \
+  stats_statements[(index) - STRINGS_FIRST_KEYWORD]++
+#define STATS_COUNT_OPERATOR(op) stats_count_operator (op)
+#define STATS_COUNT_UNARY(n) stats_operators[n]++
+
+BEGIN_DECLS
+
+extern uint32_t stats_statements [STRINGS_NUM_KEYWORDS];
+extern uint32_t stats_operators [STATS_NUM_OPS];
+
+extern void     stats_count_operator (char op);
+extern void     stats_clear (void);
+
+/** Get the total number of statements executed since the last clear. */
+extern uint32_t stats_get_total_statements (void);
+
+/** Write the non-zero counters using the interface_output functions. */
+extern void     stats_report (void);
+
+#ifndef ARDUINO
+#include <stdio.h>
+/** Write all the counters as a JSON object. */
+extern void     stats_write_json (FILE *f);
+#endif
+
+END_DECLS
+
+#else
+
+#define STATS_COUNT_STATEMENT(index)
+#define STATS_COUNT_OPERATOR(op)
+#define STATS_COUNT_UNARY(n)
+
+#endif
+
@@ -0,0 +1,402 @@
+/*===========================================================================
+
+  pmbasic
+
+  stringheap.c
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#include <string.h>
+#include <stdint.h>
+#include "config.h"
+#include "defs.h"
+#include "stringheap.h"
+#include "heap.h"
+#include "errcodes.h"
+
+/*===========================================================================
+  StringBlock
+  Each value in the heap is one of these, followed by its text. Blocks
+  are placed one after another, so the capacity is always a multiple
+  of STRINGHEAP_ALIGN, to keep the next header aligned.
+===========================================================================*/
+typedef struct _StringBlock
+  {
+  StringHandle *owner; // The variable whose value this is, or NULL
+  uint16_t capacity; // Bytes of text the block can hold
+  uint16_t length; // Bytes of text in use, if there is an owner
+  } StringBlock;
+
+#define STRINGHEAP_ALIGN sizeof (void *)
+#define STRINGHEAP_ROUND(n) \
+   (((size_t)(n) + STRINGHEAP_ALIGN - 1) / STRINGHEAP_ALIGN * STRINGHEAP_ALIGN)
+
+/*===========================================================================
+  StringHeap
+  New blocks are always taken from the top, the end of the space in use.
+  A block without an owner is a temporary, and is only kept while a
+  protected view points into it; otherwise it is garbage, and goes
+  next time the heap is compacted.
+===========================================================================*/
+struct _StringHeap
+  {
+  char *base;
+  size_t size;
+  size_t top;
+  StringView *roots [MAX_STRING_TEMPS];
+  uint8_t num_roots;
+  };
+
+#ifdef STATIC_POOLS
+static StringHeap stringheap_pool;
+static StringBlock stringheap_pool_data [POOL_STRINGS / sizeof (StringBlock)];
+#endif
+
+/*===========================================================================
+  stringheap_block
+===========================================================================*/
+static StringBlock *stringheap_block (const StringHeap *self,
+         StringHandle handle)
+  {
+  return (StringBlock *)(self->base + handle - 1);
+  }
+
+/*===========================================================================
+  stringheap_text
+===========================================================================*/
+static char *stringheap_text (StringBlock *block)
+  {
+  return (char *)(block + 1);
+  }
+
+/*===========================================================================
+  stringheap_block_of
+  Get the block whose text starts at text
+===========================================================================*/
+static StringBlock *stringheap_block_of (const char *text)
+  {
+  return (StringBlock *)text - 1;
+  }
+
+/*===========================================================================
+  stringheap_new
+===========================================================================*/
+StringHeap *stringheap_new (void)
+  {
+#ifdef STATIC_POOLS
+  StringHeap *self = &stringheap_pool;
+  self->base = (char *)stringheap_pool_data;
+  self->size = sizeof (stringheap_pool_data);
+#else
+  // The heap itself is not allocated until the first string is, so
+  //   a program that has no string variables does not pay for it
+  StringHeap *self = HEAP_MALLOC (HEAP_SITE_STRING, sizeof (StringHeap));
+  if (!self) return NULL;
+  self->base = NULL;
+  self->size = 0;
+#endif
+  stringheap_clear (self);
+  return self;
+  }
+
+/*===========================================================================
+  stringheap_destroy
+===========================================================================*/
+void stringheap_destroy (StringHeap *self)
+  {
+#ifndef STATIC_POOLS
+  HEAP_FREE (HEAP_SITE_STRING, self->base);
+  HEAP_FREE (HEAP_SITE_STRING, self);
+#else
+  (void)self;
+#endif
+  }
+
+/*===========================================================================
+  stringheap_clear
+===========================================================================*/
+void stringheap_clear (StringHeap *self)
+  {
+  self->top = 0;
+  self->num_roots = 0;
+  }
+
+/*===========================================================================
+  stringheap_rooted
+  Test whether any protected view points into the text of a block. A
+    view can point just past the end, if it is empty.
+===========================================================================*/
+static BOOL stringheap_rooted (const StringHeap *self, StringBlock *block)
+  {
+  const char *text = stringheap_text (block);
+  for (uint8_t i = 0; i < self->num_roots; i++)
+    {
+    const char *p = self->roots[i]->data;
+    if (p >= text && p <= text + block->capacity) return TRUE;
+    }
+  return FALSE;
+  }
+
+/*===========================================================================
+  stringheap_compact
+  Move all the blocks that are still wanted to the start of dest, which
+    is either the heap itself, or a larger heap that will replace it,
+    and update everything that points to them. When compacting in
+    place, blocks only ever move down, so a view that has been updated
+    can't be mistaken for one that points into a later block.
+===========================================================================*/
+static void stringheap_compact (StringHeap *self, char *dest)
+  {
+  size_t from = 0;
+  size_t to = 0;
+  while (from < self->top)
+    {
+    StringBlock *block = (StringBlock *)(self->base + from);
+    size_t size = sizeof (StringBlock) + block->capacity;
+    if (block->owner || stringheap_rooted (self, block))
+      {
+      const char *text = stringheap_text (block);
+      const char *new_text = dest + to + sizeof (StringBlock);
+      for (uint8_t i = 0; i < self->num_roots; i++)
+        {
+        StringView *view = self->roots[i];
+        if (view->data >= text && view->data <= text + block->capacity)
+          view->data = new_text + (view->data - text);
+        }
+      if (block->owner) *block->owner = to + 1;
+      memmove (dest + to, block, size);
+      to += size;
+      }
+    from += size;
+    }
+  self->top = to;
+  }
+
+#ifndef STATIC_POOLS
+/*===========================================================================
+  stringheap_grow
+  Move the heap to a new block of memory, with at least size bytes free,
+    if possible
+===========================================================================*/
+static void stringheap_grow (StringHeap *self, size_t size)
+  {
+  size_t new_size = self->size ? self->size : POOL_STRINGS;
+  while (new_size - self->top < size) new_size *= 2;
+  char *base = HEAP_MALLOC (HEAP_SITE_STRING, new_size);
+  if (!base) return;
+  stringheap_compact (self, base);
+  HEAP_FREE (HEAP_SITE_STRING, self->base);
+  self->base = base;
+  self->size = new_size;
+  }
+#endif
+
+/*===========================================================================
+  stringheap_alloc
+  Get a new block, with room for at least capacity bytes of text,
+    compacting the heap if necessary. Returns NULL if there is no room.
+===========================================================================*/
+static StringBlock *stringheap_alloc (StringHeap *self, size_t capacity,
+         uint8_t *error)
+  {
+  size_t size = sizeof (StringBlock) + STRINGHEAP_ROUND (capacity);
+  if (self->size - self->top < size)
+    {
+    stringheap_compact (self, self->base);
+#ifndef STATIC_POOLS
+    if (self->size - self->top < size)
+      stringheap_grow (self, size);
+#endif
+    if (self->size - self->top < size)
+      {
+      *error = BASIC_ERR_NOMEM;
+      return NULL;
+      }
+    }
+  StringBlock *block = (StringBlock *)(self->base + self->top);
+  self->top += size;
+  block->owner = NULL;
+  block->capacity = size - sizeof (StringBlock);
+  block->length = 0;
+  return block;
+  }
+
+/*===========================================================================
+  stringheap_get
+===========================================================================*/
+void stringheap_get (const StringHeap *self, StringHandle handle,
+        StringView *view)
+  {
+  if (handle)
+    {
+    StringBlock *block = stringheap_block (self, handle);
+    view->data = stringheap_text (block);
+    view->length = block->length;
+    }
+  else
+    {
+    view->data = NULL;
+    view->length = 0;
+    }
+  }
+
+/*===========================================================================
+  stringheap_protect
+===========================================================================*/
+void stringheap_protect (StringHeap *self, StringView *view, uint8_t *error)
+  {
+  if (self->num_roots >= MAX_STRING_TEMPS)
+    {
+    *error = BASIC_ERR_STRING_COMPLEX;
+    return;
+    }
+  self->roots [self->num_roots++] = view;
+  }
+
+/*===========================================================================
+  stringheap_mark
+===========================================================================*/
+uint8_t stringheap_mark (const StringHeap *self)
+  {
+  return self->num_roots;
+  }
+
+/*===========================================================================
+  stringheap_release
+===========================================================================*/
+void stringheap_release (StringHeap *self, uint8_t mark)
+  {
+  self->num_roots = mark;
+  }
+
+/*===========================================================================
+  stringheap_begin
+===========================================================================*/
+void stringheap_begin (StringHeap *self, StringView *value,
+        const StringHandle *target, uint8_t *error)
+  {
+  if (target && *target)
+    {
+    StringBlock *block = stringheap_block (self, *target);
+    if (value->data == stringheap_text (block)
+         && value->length == block->length)
+      return;
+    }
+  // value is protected, so it is still valid if the heap is compacted
+  StringBlock *block = stringheap_alloc (self, value->length, error);
+  if (!block) return;
+  if (value->length)
+    memcpy (stringheap_text (block), value->data, value->length);
+  value->data = stringheap_text (block);
+  }
+
+/*===========================================================================
+  stringheap_new_value
+===========================================================================*/
+char *stringheap_new_value (StringHeap *self, StringView *value,
+        uint16_t length, uint8_t *error)
+  {
+  if (length > MAX_STRINGLEN)
+    {
+    *error = BASIC_ERR_STRING_TOO_LONG;
+    return NULL;
+    }
+  StringBlock *block = stringheap_alloc (self, length, error);
+  if (!block) return NULL;
+  value->data = stringheap_text (block);
+  value->length = length;
+  return stringheap_text (block);
+  }
+
+/*===========================================================================
+  stringheap_append
+===========================================================================*/
+void stringheap_append (StringHeap *self, StringView *value,
+        const StringView *piece, uint8_t *error)
+  {
+  size_t length = (size_t)value->length + piece->length;
+  if (length > MAX_STRINGLEN)
+    {
+    *error = BASIC_ERR_STRING_TOO_LONG;
+    return;
+    }
+  StringBlock *block = stringheap_block_of (value->data);
+  if (length > block->capacity)
+    {
+    size_t capacity = 2 * (size_t)block->capacity;
+    if (capacity < length) capacity = length;
+    if (capacity > MAX_STRINGLEN) capacity = MAX_STRINGLEN;
+    size_t extra = STRINGHEAP_ROUND (capacity) - block->capacity;
+    size_t needed = STRINGHEAP_ROUND (length) - block->capacity;
+    if (stringheap_text (block) + block->capacity == self->base + self->top
+         && self->size - self->top >= needed)
+      {
+      // The value is the last one in the heap, so it can grow where
+      //   it is -- by less than doubling, if that's all there is room for
+      if (self->size - self->top < extra) extra = needed;
+      block->capacity += extra;
+      self->top += extra;
+      }
+    else
+      {
+      // Both views are protected, so they are still valid if the heap
+      //   is compacted. The old block is left for the owner, if it has
+      //   one, or becomes garbage. If there's no room to double the
+      //   space, try again with just enough
+      StringBlock *new_block = stringheap_alloc (self, capacity, error);
+      if (!new_block && capacity > length)
+        {
+        *error = BASIC_ERR_NONE;
+        new_block = stringheap_alloc (self, length, error);
+        }
+      if (!new_block) return;
+      memcpy (stringheap_text (new_block), value->data, value->length);
+      value->data = stringheap_text (new_block);
+      }
+    }
+  if (piece->length)
+    memmove ((char *)value->data + value->length, piece->data, 
+      piece->length);
+  value->length = length;
+  }
+
+/*===========================================================================
+  stringheap_commit
+===========================================================================*/
+void stringheap_commit (StringHeap *self, StringHandle *handle,
+        const StringView *value)
+  {
+  StringBlock *block = stringheap_block_of (value->data);
+  if (block->owner != handle)
+    {
+    if (*handle) stringheap_block (self, *handle)->owner = NULL;
+    block->owner = handle;
+    *handle = (char *)block - self->base + 1;
+    }
+  block->length = value->length;
+  }
+
+/*===========================================================================
+  stringheap_assign
+===========================================================================*/
+void stringheap_assign (StringHeap *self, StringHandle *handle,
+        const StringView *view, uint8_t *error)
+  {
+  if (!*handle || stringheap_block (self, *handle)->capacity < view->length)
+    {
+    StringBlock *block = stringheap_alloc (self, view->length, error);
+    if (!block) return;
+    // The old value's text stays where it is until the next compaction,
+    //   so it can still be copied from if view points into it
+    if (*handle) stringheap_block (self, *handle)->owner = NULL;
+    block->owner = handle;
+    *handle = (char *)block - self->base + 1;
+    }
+  StringBlock *block = stringheap_block (self, *handle);
+  if (view->length)
+    memmove (stringheap_text (block), view->data, view->length);
+  block->length = view->length;
+  }
+
@@ -0,0 +1,115 @@
+/*===========================================================================
+
+  pmbasic
+
+  stringheap.h
+
+  The values of string variables live in a single block of memory, the
+  string heap. Each value is a block of its own within the heap, with
+  room to grow; a new value is just placed after the last one, and an
+  old value that is no longer wanted is left where it is. When there is
+  no room at the end, the heap is compacted, by sliding the values that
+  are still wanted down over the ones that are not. No string is ever
+  allocated separately with malloc(), so the C heap cannot fragment,
+  however much string handling a program does. With STATIC_POOLS, the
+  heap is a fixed-size static pool; otherwise it doubles in size when
+  compacting it does not make enough room.
+
+  Because values move, a variable does not hold a pointer to its value,
+  but a StringHandle, which the heap updates when it moves the value.
+  While an expression is being evaluated, the parser works with
+  StringViews, which are just a pointer and a length. A view can point
+  to the whole of a value, to part of one (which is how LEFT$ and MID$
+  avoid copying), or to text in the program. Any view that must survive
+  something that could allocate has to be registered with
+  stringheap_protect(), so that it can be updated if the heap is
+  compacted; the values it points to are kept until it is released.
+
+  Some of these functions return error codes -- these values must be
+  one of the constants defined in errcodes.h.
+
+  (c)2021 Kevin Boone, GPLv3.0
+
+===========================================================================*/
+
+#pragma once
+
+#include <stddef.h>
+#include "defs.h"
+#include "config.h"
+
+struct _StringHeap;
+typedef struct _StringHeap StringHeap;
+
+// Identifies a string variable's value in the heap. Zero means that the
+//   variable has no value yet, which reads as an empty string. This is
+//   the same size as VARTYPE, so that a variable can hold either.
+typedef UVARTYPE StringHandle;
+
+typedef struct _StringView
+  {
+  const char *data;
+  uint16_t length;
+  } StringView;
+
+BEGIN_DECLS
+
+extern StringHeap *stringheap_new (void);
+extern void        stringheap_destroy (StringHeap *self);
+
+/** Remove all values at once, as when the variables are cleared. Any
+ *    handles become invalid. */
+extern void        stringheap_clear (StringHeap *self);
+
+/** Get a view of the value identified by handle. The view is valid until
+ *    anything else is allocated, unless it is protected. */
+extern void        stringheap_get (const StringHeap *self,
+                     StringHandle handle, StringView *view);
+
+/** Register a view to be kept up to date if the heap is compacted, and
+ *    the value it points into kept. Views are registered and released in
+ *    stack order: get a mark with stringheap_mark() first, and pass it to
+ *    stringheap_release() when the views are no longer needed. */
+extern void        stringheap_protect (StringHeap *self, StringView *view,
+                     uint8_t *error);
+extern uint8_t     stringheap_mark (const StringHeap *self);
+extern void        stringheap_release (StringHeap *self, uint8_t mark);
+
+/** Make a protected view into a new value that can be added to with
+ *    stringheap_append(), by copying what it points to into a block of
+ *    its own. But if target is not NULL, and the view is the whole of
+ *    target's value, the copy is not needed: the new value is built in
+ *    target's own block, after the existing text. This is what makes
+ *    a$ = a$ + b$ in a loop take time in proportion to the length of
+ *    b$, not of a$. */
+extern void        stringheap_begin (StringHeap *self, StringView *value,
+                     const StringHandle *target, uint8_t *error);
+
+/** Allocate a new value of length bytes, set value to view it, and
+ *    return the text for the caller to fill in, or NULL if there is no
+ *    room. The value can be appended to, as for stringheap_begin(),
+ *    but is not yet protected. */
+extern char       *stringheap_new_value (StringHeap *self,
+                     StringView *value, uint16_t length, uint8_t *error);
+
+/** Add the text of a protected view to the end of a value started by
+ *    stringheap_begin() or stringheap_new_value(). The space for the
+ *    value at least doubles each time it has to grow. */
+extern void        stringheap_append (StringHeap *self, StringView *value,
+                     const StringView *piece, uint8_t *error);
+
+/** Make a value started by stringheap_begin() or stringheap_new_value()
+ *    the value of the variable whose handle is given, without copying
+ *    it. The variable's old value, if any, is discarded. */
+extern void        stringheap_commit (StringHeap *self,
+                     StringHandle *handle, const StringView *value);
+
+/** Set the value of the variable whose handle is given to a copy of the
+ *    text of view, which must be protected. The variable's own block is
+ *    re-used if it is large enough. */
+extern void        stringheap_assign (StringHeap *self,
+                     StringHandle *handle, const StringView *view,
+                     uint8_t *error);
+
+END_DECLS
+
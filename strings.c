@@ -24,8 +24,11 @@
 #include "config.h"
 #include "interface.h"
 
-#ifndef ARDUINO
+#ifdef ARDUINO
+#define STRINGS_READ_BYTE(p) ((char)pgm_read_byte (p))
+#else
 #define PROGMEM
+#define STRINGS_READ_BYTE(p) (*(p))
 #endif
 
 const char STRING_DUMMY[] PROGMEM = "";
@@ -63,6 +66,24 @@ const char ERRMSG_ERR_KW_NO_VAR[] PROGMEM = "Expected variable after keyword";
 const char ERRMSG_ERR_EXPECTED_COMMA[] PROGMEM = "Expected comma";
 const char ERRMSG_ERR_NO_STORED_PROGRAM[] PROGMEM = "No stored program";
 const char ERRMSG_ERR_PROGRAM_TOO_LARGE[] PROGMEM = "Expected comma";
+const char ERRMSG_ERR_NAME_TOO_LONG[] PROGMEM = "Variable name too long";
+const char ERRMSG_ERR_BAD_SUBSCRIPT[] PROGMEM = "Subscript out of range";
+const char ERRMSG_ERR_ARRAY_DEFINED[] PROGMEM = "Array already dimensioned";
+const char ERRMSG_ERR_UNDEFINED_ARRAY[] PROGMEM = "Undefined array";
+const char ERRMSG_ERR_ARRAY_SIZE[] PROGMEM = "Array sizes differ";
+const char ERRMSG_ERR_TYPE_MISMATCH[] PROGMEM = "Type mismatch";
+const char ERRMSG_ERR_STRING_TOO_LONG[] PROGMEM = "String too long";
+const char ERRMSG_ERR_STRING_COMPLEX[] PROGMEM = "String expression too complex";
+const char ERRMSG_ERR_BAD_WIDTH[] PROGMEM = "Width must be 16, 32 or 64";
+const char ERRMSG_ERR_FIXED_WIDTH[] PROGMEM = "Fixed point needs a width of 32 or 64";
+const char ERRMSG_ERR_BAD_ARGUMENT[] PROGMEM = "Bad function argument";
+const char ERRMSG_ERR_WEND_WITHOUT_WHILE[] PROGMEM = "WEND without WHILE";
+const char ERRMSG_ERR_WHILE_WITHOUT_WEND[] PROGMEM = "WHILE without WEND";
+const char ERRMSG_ERR_UNTIL_WITHOUT_REPEAT[] PROGMEM = "UNTIL without REPEAT";
+const char ERRMSG_ERR_LOCAL_WITHOUT_GOSUB[] PROGMEM = "LOCAL outside a subroutine";
+const char ERRMSG_ERR_UNDEFINED_FN[] PROGMEM = "Undefined function";
+const char ERRMSG_ERR_FN_DEFINED[] PROGMEM = "Function defined twice";
+const char ERRMSG_ERR_FN_DEPTH[] PROGMEM = "Too many nested FNs";
 
 const char STRING_PRINT[] PROGMEM = "print";
 const char STRING_IF[] PROGMEM = "if";
@@ -88,14 +109,60 @@ const char STRING_DIGITALWRITE[] PROGMEM = "digitalwrite";
 const char STRING_PINMODE[] PROGMEM = "pinmode";
 const char STRING_ANALOGREAD[] PROGMEM = "analogread";
 const char STRING_ANALOGWRITE[] PROGMEM = "analogwrite";
+const char STRING_DIM[] PROGMEM = "dim";
+const char STRING_MAT[] PROGMEM = "mat";
+const char STRING_LEN[] PROGMEM = "len";
+const char STRING_LEFT[] PROGMEM = "left$";
+const char STRING_RIGHT[] PROGMEM = "right$";
+const char STRING_MID[] PROGMEM = "mid$";
+const char STRING_ABS[] PROGMEM = "abs";
+const char STRING_MIN[] PROGMEM = "min";
+const char STRING_MAX[] PROGMEM = "max";
+const char STRING_SGN[] PROGMEM = "sgn";
+const char STRING_SQR[] PROGMEM = "sqr";
+const char STRING_SHL[] PROGMEM = "shl";
+const char STRING_SHR[] PROGMEM = "shr";
+const char STRING_RND[] PROGMEM = "rnd";
+const char STRING_WHILE[] PROGMEM = "while";
+const char STRING_WEND[] PROGMEM = "wend";
+const char STRING_REPEAT[] PROGMEM = "repeat";
+const char STRING_UNTIL[] PROGMEM = "until";
+const char STRING_LOCAL[] PROGMEM = "local";
+const char STRING_DEF[] PROGMEM = "def";
+const char STRING_FN[] PROGMEM = "fn";
 
+const char STRING_GEN_HEAP_LIVE[] PROGMEM = "Heap in use: "; 
+const char STRING_GEN_HEAP_PEAK[] PROGMEM = "Heap peak: "; 
 const char STRING_GEN_LINE_DELETED[] PROGMEM = "Line deleted";
+const char STRING_GEN_PROFILE_HEADER[] PROGMEM = "line\tcount\tusec\tnsec/exec"; 
+const char STRING_GEN_STATEMENTS[] PROGMEM = "Statements:"; 
+const char STRING_GEN_OPERATORS[] PROGMEM = "Operators:"; 
+const char STRING_GEN_HEAP_FREE_LIST[] PROGMEM = "Heap free list: "; 
+const char STRING_GEN_HEAP_FRAG[] PROGMEM = "Heap fragmentation: "; 
 const char STRING_GEN_PROG_SIZE[] PROGMEM = "Program size: "; 
 const char STRING_GEN_BYTES[] PROGMEM = "bytes"; 
 const char STRING_GEN_TOT_RAM[] PROGMEM = "Total RAM: "; 
 const char STRING_GEN_TOT_EEPROM[] PROGMEM = "Total EEPROM: "; 
 const char STRING_GEN_VERSION[] PROGMEM = "PMBASIC version 0.1"; 
 const char STRING_GEN_FREE_RAM[] PROGMEM = "Free RAM: "; 
+const char STRING_GEN_ALLOCS[] PROGMEM = "allocations"; 
+const char STRING_GEN_POOL_VARIABLES[] PROGMEM = "Variable pool: "; 
+const char STRING_GEN_POOL_LINES[] PROGMEM = "Line index pool: "; 
+const char STRING_GEN_POOL_LOOPS[] PROGMEM = "Loop index pool: "; 
+const char STRING_GEN_POOL_LOCALS[] PROGMEM = "Local pool: "; 
+const char STRING_GEN_POOL_FUNCTIONS[] PROGMEM = "Function pool: "; 
+const char STRING_GEN_EEPROM[] PROGMEM = "eeprom"; 
+const char STRING_GEN_POOL_ARRAYS[] PROGMEM = "Array pool: "; 
+// SUM and DOT are not keywords, so they can still be used as variable
+//   names. They are only recognized straight after MAT
+const char STRING_GEN_SUM[] PROGMEM = "sum"; 
+const char STRING_GEN_DOT[] PROGMEM = "dot"; 
+const char STRING_GEN_POOL_STRINGS[] PROGMEM = "String heap: "; 
+const char STRING_GEN_WIDTH[] PROGMEM = "Arithmetic width: "; 
+const char STRING_GEN_BITS[] PROGMEM = "bits"; 
+const char STRING_GEN_FIXED[] PROGMEM = "Fixed point: "; 
+const char STRING_GEN_ON[] PROGMEM = "on"; 
+const char STRING_GEN_OFF[] PROGMEM = "off"; 
 
 const char STRING_CMD_LIST[] PROGMEM = "list";
 const char STRING_CMD_RUN[] PROGMEM = "run";
@@ -106,6 +173,10 @@ const char STRING_CMD_INFO[] PROGMEM = "info";
 const char STRING_CMD_NEW[] PROGMEM = "new";
 const char STRING_CMD_HELP[] PROGMEM = "help";
 const char STRING_CMD_CLEAR[] PROGMEM = "clear";
+const char STRING_CMD_PROFILE[] PROGMEM = "profile";
+const char STRING_CMD_STATS[] PROGMEM = "stats";
+const char STRING_CMD_WIDTH[] PROGMEM = "width";
+const char STRING_CMD_FIXED[] PROGMEM = "fixed";
 
 const char STRING_H1[] PROGMEM = "Lines beginning with a number are stored as program lines.";
 const char STRING_H2[] PROGMEM = "New lines replace existing lines with the same number.";
@@ -120,6 +191,17 @@ const char STRING_H10[] PROGMEM = "  LOAD : load a program from EEPROM";
 const char STRING_H11[] PROGMEM = "  INFO : show memory sizes, etc";
 const char STRING_H12[] PROGMEM = "  CLEAR : clear global variables";
 
+const char STRING_HEAP_PROGRAM[] PROGMEM = "program";
+const char STRING_HEAP_PARSER[] PROGMEM = "parser";
+const char STRING_HEAP_TOKENIZER[] PROGMEM = "tokenizer";
+const char STRING_HEAP_LIST[] PROGMEM = "lists";
+const char STRING_HEAP_LINE_INDEX[] PROGMEM = "line index";
+const char STRING_HEAP_VARIABLE[] PROGMEM = "variables";
+const char STRING_HEAP_PROFILER[] PROGMEM = "profiler";
+const char STRING_HEAP_ARRAY[] PROGMEM = "arrays";
+const char STRING_HEAP_STRING[] PROGMEM = "strings";
+const char STRING_HEAP_CALLSTACK[] PROGMEM = "GOSUB stack";
+
 const char *const strings[] PROGMEM =
   {
   STRING_OK,
@@ -151,6 +233,26 @@ const char *const strings[] PROGMEM =
   ERRMSG_ERR_EXPECTED_COMMA,
   ERRMSG_ERR_NO_STORED_PROGRAM,
   ERRMSG_ERR_PROGRAM_TOO_LARGE,
+  ERRMSG_ERR_NAME_TOO_LONG,
+  ERRMSG_ERR_BAD_SUBSCRIPT,
+  ERRMSG_ERR_ARRAY_DEFINED,
+  ERRMSG_ERR_UNDEFINED_ARRAY,
+  ERRMSG_ERR_ARRAY_SIZE,
+  ERRMSG_ERR_TYPE_MISMATCH,
+  ERRMSG_ERR_STRING_TOO_LONG,
+  ERRMSG_ERR_STRING_COMPLEX,
+  ERRMSG_ERR_BAD_WIDTH,
+  ERRMSG_ERR_FIXED_WIDTH,
+  ERRMSG_ERR_BAD_ARGUMENT,
+  ERRMSG_ERR_WEND_WITHOUT_WHILE,
+  ERRMSG_ERR_WHILE_WITHOUT_WEND,
+  ERRMSG_ERR_UNTIL_WITHOUT_REPEAT,
+  ERRMSG_ERR_LOCAL_WITHOUT_GOSUB,
+  ERRMSG_ERR_UNDEFINED_FN,
+  ERRMSG_ERR_FN_DEFINED,
+  ERRMSG_ERR_FN_DEPTH,
+  STRING_DUMMY,
+  STRING_DUMMY,
   STRING_DUMMY,
   STRING_PRINT,
   STRING_IF,
@@ -176,6 +278,27 @@ const char *const strings[] PROGMEM =
   STRING_PINMODE,
   STRING_ANALOGREAD,
   STRING_ANALOGWRITE,
+  STRING_DIM,
+  STRING_MAT,
+  STRING_LEN,
+  STRING_LEFT,
+  STRING_RIGHT,
+  STRING_MID,
+  STRING_ABS,
+  STRING_MIN,
+  STRING_MAX,
+  STRING_SGN,
+  STRING_SQR,
+  STRING_SHL,
+  STRING_SHR,
+  STRING_RND,
+  STRING_WHILE,
+  STRING_WEND,
+  STRING_REPEAT,
+  STRING_UNTIL,
+  STRING_LOCAL,
+  STRING_DEF,
+  STRING_FN,
   STRING_DUMMY,
   STRING_DUMMY,
   STRING_DUMMY,
@@ -184,24 +307,43 @@ const char *const strings[] PROGMEM =
   STRING_DUMMY,
   STRING_DUMMY,
   STRING_DUMMY,
-  STRING_GEN_LINE_DELETED,
   STRING_DUMMY,
   STRING_DUMMY,
   STRING_DUMMY,
   STRING_DUMMY,
   STRING_DUMMY,
+  STRING_DUMMY,
+  STRING_DUMMY,
+  STRING_GEN_HEAP_LIVE,
+  STRING_GEN_HEAP_PEAK,
+  STRING_GEN_LINE_DELETED,
+  STRING_GEN_PROFILE_HEADER,
+  STRING_GEN_STATEMENTS,
+  STRING_GEN_OPERATORS,
+  STRING_GEN_HEAP_FREE_LIST,
+  STRING_GEN_HEAP_FRAG,
   STRING_GEN_PROG_SIZE,
   STRING_GEN_BYTES,
   STRING_GEN_TOT_RAM,
   STRING_GEN_TOT_EEPROM,
   STRING_GEN_VERSION,
   STRING_GEN_FREE_RAM,
-  STRING_DUMMY,
-  STRING_DUMMY,
-  STRING_DUMMY,
-  STRING_DUMMY,
-  STRING_DUMMY,
-  STRING_DUMMY,
+  STRING_GEN_ALLOCS,
+  STRING_GEN_POOL_VARIABLES,
+  STRING_GEN_POOL_LINES,
+  STRING_GEN_EEPROM,
+  STRING_GEN_POOL_ARRAYS,
+  STRING_GEN_SUM,
+  STRING_GEN_DOT,
+  STRING_GEN_POOL_STRINGS,
+  STRING_GEN_WIDTH,
+  STRING_GEN_BITS,
+  STRING_GEN_FIXED,
+  STRING_GEN_ON,
+  STRING_GEN_OFF,
+  STRING_GEN_POOL_LOOPS,
+  STRING_GEN_POOL_LOCALS,
+  STRING_GEN_POOL_FUNCTIONS,
   STRING_CMD_LIST,
   STRING_CMD_RUN,
   STRING_CMD_QUIT,
@@ -211,10 +353,10 @@ const char *const strings[] PROGMEM =
   STRING_CMD_NEW,
   STRING_CMD_HELP,
   STRING_CMD_CLEAR,
-  STRING_DUMMY,
-  STRING_DUMMY,
-  STRING_DUMMY,
-  STRING_DUMMY,
+  STRING_CMD_PROFILE,
+  STRING_CMD_STATS,
+  STRING_CMD_WIDTH,
+  STRING_CMD_FIXED,
   STRING_DUMMY,
   STRING_DUMMY,
   STRING_DUMMY,
@@ -234,6 +376,24 @@ const char *const strings[] PROGMEM =
   STRING_H10,
   STRING_H11,
   STRING_H12,
+  STRING_DUMMY,
+  STRING_DUMMY,
+  STRING_DUMMY,
+  STRING_DUMMY,
+  STRING_DUMMY,
+  STRING_DUMMY,
+  STRING_DUMMY,
+  STRING_DUMMY,
+  STRING_HEAP_PROGRAM,
+  STRING_HEAP_PARSER,
+  STRING_HEAP_TOKENIZER,
+  STRING_HEAP_LIST,
+  STRING_HEAP_LINE_INDEX,
+  STRING_HEAP_VARIABLE,
+  STRING_HEAP_PROFILER,
+  STRING_HEAP_ARRAY,
+  STRING_HEAP_STRING,
+  STRING_HEAP_CALLSTACK,
   };
 
 /*===========================================================================
@@ -249,21 +409,33 @@ void strings_get (uint8_t n, char *buff, uint8_t len)
   }
 
 /*===========================================================================
-  strings_compare_index
+  strings_compare_index_n
+  The comparison is made directly against the string in flash, a byte
+    at a time, rather than copying the string into RAM first.
 ===========================================================================*/
-BOOL strings_compare_index (const char *s, uint8_t index)
+BOOL strings_compare_index_n (const char *s, uint8_t len, uint8_t index)
   {
-  char buff [TOKEN_MAX_LENGTH + 1];
-  strings_get (index, buff, TOKEN_MAX_LENGTH);
-  int i = 0;
-  while (s[i] && buff[i])
+#ifdef ARDUINO
+  const char *p = (const char *)pgm_read_word (&strings[index]);
+#else
+  const char *p = strings[index];
+#endif
+  for (uint8_t i = 0; i < len; i++)
     {
-    if (tolower (s[i]) != buff[i]) return FALSE; 
-    i++;
+    char c = STRINGS_READ_BYTE (p + i);
+    if (c == 0 || tolower ((uint8_t)s[i]) != c) return FALSE; 
     }
-  if (s[i] && !buff[i]) return FALSE;
-  if (!s[i] && buff[i]) return FALSE;
-  return TRUE;
+  return STRINGS_READ_BYTE (p + len) == 0;
+  }
+
+/*===========================================================================
+  strings_compare_index
+===========================================================================*/
+BOOL strings_compare_index (const char *s, uint8_t index)
+  {
+  size_t len = strlen (s);
+  if (len > 255) return FALSE;
+  return strings_compare_index_n (s, (uint8_t)len, index);
   }
 
 /*===========================================================================
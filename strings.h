@@ -19,11 +19,15 @@
 //  in the rest of the application a little easier. It's still a drag,
 //  though.
 #define STRINGS_FIRST_ERR_CODE 0
-#define STRINGS_FIRST_KEYWORD  30
-#define STRINGS_FIRST_GEN_TEXT 60 
-#define STRINGS_FIRST_CMD      80
-#define STRINGS_FIRST_HELP     100 
+#define STRINGS_FIRST_KEYWORD  50
+#define STRINGS_FIRST_GEN_TEXT 110 
+#define STRINGS_FIRST_CMD      140
+#define STRINGS_FIRST_HELP     160 
 #define STRINGS_NUM_HELP       12 
+#define STRINGS_FIRST_HEAP_SITE 180
+
+// Number of slots in the table reserved for keywords
+#define STRINGS_NUM_KEYWORDS   (STRINGS_FIRST_GEN_TEXT - STRINGS_FIRST_KEYWORD)
 
 #define STRING_INDEX_PRINT (STRINGS_FIRST_KEYWORD + 0)
 #define STRING_INDEX_IF (STRINGS_FIRST_KEYWORD + 1)
@@ -49,6 +53,29 @@
 #define STRING_INDEX_PINMODE (STRINGS_FIRST_KEYWORD + 21)
 #define STRING_INDEX_ANALOGREAD (STRINGS_FIRST_KEYWORD + 22)
 #define STRING_INDEX_ANALOGWRITE (STRINGS_FIRST_KEYWORD + 23)
+#define STRING_INDEX_DIM (STRINGS_FIRST_KEYWORD + 24)
+#define STRING_INDEX_MAT (STRINGS_FIRST_KEYWORD + 25)
+#define STRING_INDEX_LEN (STRINGS_FIRST_KEYWORD + 26)
+#define STRING_INDEX_LEFT (STRINGS_FIRST_KEYWORD + 27)
+#define STRING_INDEX_RIGHT (STRINGS_FIRST_KEYWORD + 28)
+#define STRING_INDEX_MID (STRINGS_FIRST_KEYWORD + 29)
+// Functions, which are only allowed in expressions. These must stay
+//   together, in this order; see parser.c
+#define STRING_INDEX_ABS (STRINGS_FIRST_KEYWORD + 30)
+#define STRING_INDEX_MIN (STRINGS_FIRST_KEYWORD + 31)
+#define STRING_INDEX_MAX (STRINGS_FIRST_KEYWORD + 32)
+#define STRING_INDEX_SGN (STRINGS_FIRST_KEYWORD + 33)
+#define STRING_INDEX_SQR (STRINGS_FIRST_KEYWORD + 34)
+#define STRING_INDEX_SHL (STRINGS_FIRST_KEYWORD + 35)
+#define STRING_INDEX_SHR (STRINGS_FIRST_KEYWORD + 36)
+#define STRING_INDEX_RND (STRINGS_FIRST_KEYWORD + 37)
+#define STRING_INDEX_WHILE (STRINGS_FIRST_KEYWORD + 38)
+#define STRING_INDEX_WEND (STRINGS_FIRST_KEYWORD + 39)
+#define STRING_INDEX_REPEAT (STRINGS_FIRST_KEYWORD + 40)
+#define STRING_INDEX_UNTIL (STRINGS_FIRST_KEYWORD + 41)
+#define STRING_INDEX_LOCAL (STRINGS_FIRST_KEYWORD + 42)
+#define STRING_INDEX_DEF (STRINGS_FIRST_KEYWORD + 43)
+#define STRING_INDEX_FN (STRINGS_FIRST_KEYWORD + 44)
 
 #define STRING_INDEX_LIST (STRINGS_FIRST_CMD + 0)
 #define STRING_INDEX_RUN (STRINGS_FIRST_CMD + 1)
@@ -59,19 +86,50 @@
 #define STRING_INDEX_NEW (STRINGS_FIRST_CMD + 6)
 #define STRING_INDEX_HELP (STRINGS_FIRST_CMD + 7)
 #define STRING_INDEX_CLEAR (STRINGS_FIRST_CMD + 8)
+#define STRING_INDEX_PROFILE (STRINGS_FIRST_CMD + 9)
+#define STRING_INDEX_STATS (STRINGS_FIRST_CMD + 10)
+#define STRING_INDEX_WIDTH (STRINGS_FIRST_CMD + 11)
+#define STRING_INDEX_FIXED (STRINGS_FIRST_CMD + 12)
 
+#define STRING_INDEX_HEAP_LIVE (STRINGS_FIRST_GEN_TEXT + 0)
+#define STRING_INDEX_HEAP_PEAK (STRINGS_FIRST_GEN_TEXT + 1)
 #define STRING_INDEX_LINE_DELETED (STRINGS_FIRST_GEN_TEXT + 2)
+#define STRING_INDEX_PROFILE_HEADER (STRINGS_FIRST_GEN_TEXT + 3)
+#define STRING_INDEX_STATEMENTS (STRINGS_FIRST_GEN_TEXT + 4)
+#define STRING_INDEX_OPERATORS (STRINGS_FIRST_GEN_TEXT + 5)
+#define STRING_INDEX_HEAP_FREE_LIST (STRINGS_FIRST_GEN_TEXT + 6)
+#define STRING_INDEX_HEAP_FRAG (STRINGS_FIRST_GEN_TEXT + 7)
 #define STRING_INDEX_PROG_SIZE (STRINGS_FIRST_GEN_TEXT + 8)
 #define STRING_INDEX_BYTES (STRINGS_FIRST_GEN_TEXT + 9)
 #define STRING_INDEX_TOT_RAM (STRINGS_FIRST_GEN_TEXT + 10)
 #define STRING_INDEX_TOT_EEPROM (STRINGS_FIRST_GEN_TEXT + 11)
 #define STRING_INDEX_VERSION (STRINGS_FIRST_GEN_TEXT + 12)
 #define STRING_INDEX_FREE_RAM (STRINGS_FIRST_GEN_TEXT + 13)
+#define STRING_INDEX_ALLOCS (STRINGS_FIRST_GEN_TEXT + 14)
+#define STRING_INDEX_POOL_VARIABLES (STRINGS_FIRST_GEN_TEXT + 15)
+#define STRING_INDEX_POOL_LINES (STRINGS_FIRST_GEN_TEXT + 16)
+#define STRING_INDEX_EEPROM (STRINGS_FIRST_GEN_TEXT + 17)
+#define STRING_INDEX_POOL_ARRAYS (STRINGS_FIRST_GEN_TEXT + 18)
+#define STRING_INDEX_SUM (STRINGS_FIRST_GEN_TEXT + 19)
+#define STRING_INDEX_DOT (STRINGS_FIRST_GEN_TEXT + 20)
+#define STRING_INDEX_POOL_STRINGS (STRINGS_FIRST_GEN_TEXT + 21)
+#define STRING_INDEX_WIDTH_TEXT (STRINGS_FIRST_GEN_TEXT + 22)
+#define STRING_INDEX_BITS (STRINGS_FIRST_GEN_TEXT + 23)
+#define STRING_INDEX_FIXED_TEXT (STRINGS_FIRST_GEN_TEXT + 24)
+#define STRING_INDEX_ON (STRINGS_FIRST_GEN_TEXT + 25)
+#define STRING_INDEX_OFF (STRINGS_FIRST_GEN_TEXT + 26)
+#define STRING_INDEX_POOL_LOOPS (STRINGS_FIRST_GEN_TEXT + 27)
+#define STRING_INDEX_POOL_LOCALS (STRINGS_FIRST_GEN_TEXT + 28)
+#define STRING_INDEX_POOL_FUNCTIONS (STRINGS_FIRST_GEN_TEXT + 29)
 
 BEGIN_DECLS
 
 extern void strings_get (uint8_t n, char *buff, uint8_t len);
 extern BOOL strings_compare_index (const char *s, uint8_t index);
+// Compare the first len characters of s, which need not be terminated,
+//   ignoring case. The string table entry must be exactly len long.
+extern BOOL strings_compare_index_n (const char *s, uint8_t len, 
+              uint8_t index);
 extern void strings_output_string (uint8_t index);
 
 END_DECLS
@@ -13,10 +13,18 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <ctype.h>
+#include <string.h>
 #include "config.h"
 #include "defs.h"
 #include "tokenizer.h"
+#include "strings.h"
+#include "basicprogram.h"
+#include "heap.h"
+#include "numparse.h"
+#include "fixedpoint.h"
+#ifdef ARDUINO
+#include <avr/pgmspace.h>
+#endif
 
 /*===========================================================================
   Tokenizer 
@@ -29,6 +37,7 @@ extern TokenType   tokenizer_get_type (const Tokenizer *self);
 #define TOKEN_ERROR_NONE                0
 #define TOKEN_ERROR_TOO_LONG            1
 #define TOKEN_ERROR_INTERNAL            2 
+#define TOKEN_ERROR_NUMBER_TOO_LONG     16 // BASIC_ERR_NUMBER_TOO_LONG
 
 #define TOKEN_TYPE_UNKNOWN        0
 #define TOKEN_TYPE_NUMBER         1
@@ -36,56 +45,161 @@ extern TokenType   tokenizer_get_type (const Tokenizer *self);
 #define TOKEN_TYPE_STRING         3
 #define TOKEN_TYPE_EOL            4
 #define TOKEN_TYPE_SYM            5
+#define TOKEN_TYPE_KEYWORD        6
+
+// Test whether a byte in the program is a keyword token
+#define TOKENIZER_IS_KEYWORD_BYTE(c) ((uint8_t)(c) >= TOKENIZER_KEYWORD_BASE \
+   && (uint8_t)(c) < TOKENIZER_KEYWORD_BASE + STRINGS_NUM_KEYWORDS)
+
+// The token byte for a keyword, given its string table index
+#define TOKENIZER_KEYWORD_BYTE(index) \
+   ((index) - STRINGS_FIRST_KEYWORD + TOKENIZER_KEYWORD_BASE)
 
 
 struct _Tokenizer
   {
-  const char *pos;
+  // The text is read either directly from memory, or with the fetch
+  //   function, if text is NULL
+  const char *text;
+  TokenizerFetch fetch;
+  const void *source;
+  TokenizerPos pos;
   BOOL finished;
-  char current_token [TOKEN_MAX_LENGTH + 1];
-  uint8_t current_token_index;
+  // The text of the current token is not copied: it is the slice of
+  //   token_length characters at token_pos. Only if the text is read 
+  //   with the fetch function is the slice copied into fetched
+  TokenizerPos token_pos;
+  uint8_t token_length;
+  char fetched [TOKEN_MAX_LENGTH + 1];
+  char sym; // The character, if the token is a symbol
   TokenType current_token_type;
   VARTYPE number_value;
+  uint8_t keyword; // String table index, if the token is a keyword
   uint16_t line;
+  BOOL at_line_start; // pos is at the header of a stored line
   };
 
 typedef uint8_t TokenClass;
 
+// Character classes. A character can be in more than one
+#define TOKENIZER_CLASS_WORD_START 0x01 // Letters and ?
+#define TOKENIZER_CLASS_WORD       0x02 // Letters, digits and ?
+#define TOKENIZER_CLASS_DIGIT      0x04 
+#define TOKENIZER_CLASS_HEX        0x08 
+#define TOKENIZER_CLASS_SPACE      0x10 // Space and tab
+#define TOKENIZER_CLASS_SYMBOL     0x20 // All but letters, digits, 0, \n
+
+// The classes of each character. This replaces the C library's 
+//   isalpha(), etc., which depend on the locale, are not defined for
+//   the keyword bytes, and would need several calls to classify a
+//   character. On the Arduino, the table is kept in flash.
+#ifndef ARDUINO
+#define PROGMEM
+#endif
+static const TokenClass tokenizer_classes [256] PROGMEM =
+  {
+  0x00, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // 00
+  0x20, 0x30, 0x00, 0x20, 0x20, 0x20, 0x20, 0x20, // 08
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // 10
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // 18
+  0x30, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // 20
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // 28
+  0x0E, 0x0E, 0x0E, 0x0E, 0x0E, 0x0E, 0x0E, 0x0E, // 30
+  0x0E, 0x0E, 0x20, 0x20, 0x20, 0x20, 0x20, 0x23, // 38
+  0x20, 0x0B, 0x0B, 0x0B, 0x0B, 0x0B, 0x0B, 0x03, // 40
+  0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, // 48
+  0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, // 50
+  0x03, 0x03, 0x03, 0x20, 0x20, 0x20, 0x20, 0x20, // 58
+  0x20, 0x0B, 0x0B, 0x0B, 0x0B, 0x0B, 0x0B, 0x03, // 60
+  0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, // 68
+  0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, // 70
+  0x03, 0x03, 0x03, 0x20, 0x20, 0x20, 0x20, 0x20, // 78
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // 80
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // 88
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // 90
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // 98
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // A0
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // A8
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // B0
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // B8
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // C0
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // C8
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // D0
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // D8
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // E0
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // E8
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // F0
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // F8
+  };
+
+#ifdef ARDUINO
+#define TOKENIZER_CLASS(c) pgm_read_byte (&tokenizer_classes [(uint8_t)(c)])
+#else
+#define TOKENIZER_CLASS(c) (tokenizer_classes [(uint8_t)(c)])
+#endif
+
+// Test whether character c is in the class cls
+#define TOKENIZER_IS(c, cls) (TOKENIZER_CLASS (c) & TOKENIZER_CLASS_##cls)
+
+// Get the character i places on from the current position
+#define TOKENIZER_PEEK(self, i) ((self)->text ? \
+   (self)->text [(self)->pos + (i)] : \
+   (self)->fetch ((self)->source, (self)->pos + (i)))
+
+// The longest word, number, or string (counting each escaped quote as
+//   two characters) that a token may be
+#define TOKENIZER_MAX_SLICE (TOKEN_MAX_LENGTH - 2)
+
+#ifdef STATIC_POOLS
+// There is never more than one tokenizer in use at a time, so with
+//   STATIC_POOLS tokenizer_new() just hands out this one
+static Tokenizer tokenizer_pool;
+#endif
+
 /*===========================================================================
-  tokenizer_new
+  tokenizer_new_fetch
 ===========================================================================*/
-Tokenizer *tokenizer_new (const char *p)
+Tokenizer *tokenizer_new_fetch (TokenizerFetch fetch, const void *source)
   {
-  Tokenizer *self = malloc (sizeof (Tokenizer));
-  self->pos = p;
-  self->current_token_index = 0;
+#ifdef STATIC_POOLS
+  Tokenizer *self = &tokenizer_pool;
+#else
+  Tokenizer *self = HEAP_MALLOC (HEAP_SITE_TOKENIZER, 
+    sizeof (Tokenizer));
+#endif
+  self->text = NULL;
+  self->fetch = fetch;
+  self->source = source;
+  self->pos = 0;
+  self->token_pos = 0;
+  self->token_length = 0;
   self->current_token_type = TOKEN_TYPE_UNKNOWN;
   self->finished = FALSE;
   self->line = 0;
+  self->at_line_start = FALSE;
   return self;
   }
 
 /*===========================================================================
-  tokenizer_destroy
+  tokenizer_new
 ===========================================================================*/
-void tokenizer_destroy (Tokenizer *self)
+Tokenizer *tokenizer_new (const char *p)
   {
-  free (self);
+  Tokenizer *self = tokenizer_new_fetch (NULL, NULL);
+  self->text = p;
+  return self;
   }
 
 /*===========================================================================
-  tokenizer_add_to_token
+  tokenizer_destroy
 ===========================================================================*/
-BOOL tokenizer_add_to_token (Tokenizer *self, char c)
+void tokenizer_destroy (Tokenizer *self)
   {
-  if (self->current_token_index >= TOKEN_MAX_LENGTH - 2)
-    return FALSE;
-
-  self->current_token [self->current_token_index] = c;
-  self->current_token_index++;
-  self->current_token [self->current_token_index] = 0;
-
-  return TRUE;
+#ifdef STATIC_POOLS
+  (void)self;
+#else
+  HEAP_FREE (HEAP_SITE_TOKENIZER, self);
+#endif
   }
 
 /*===========================================================================
@@ -93,15 +207,15 @@ BOOL tokenizer_add_to_token (Tokenizer *self, char c)
 ===========================================================================*/
 static int tokenizer_slurp_string (Tokenizer *self, TokenError *error)
   {
-  const char *p = self->pos;
   int slurped = 0;
   char c;
 
+  // The token is the text between the quotes, with any escaped quotes
+  //   ("") left as they are, to be decoded when the string is printed
   BOOL stop = FALSE;
-  while (!stop && !(*error))
+  while (!stop)
     {
-    c = p[slurped];
-    //printf ("slurpd = %d c = %c\n", slurped, c);
+    c = TOKENIZER_PEEK (self, slurped);
     if (c == '\n') 
       stop = TRUE;
     else if (c == 0) 
@@ -110,99 +224,104 @@ static int tokenizer_slurp_string (Tokenizer *self, TokenError *error)
       {
       // If the " is followed immediately by a ", that's an escaped "
       //   and renders as a single ". Otherwise, it's end of string
-      if (p[slurped + 1] == '\"')
-        {
-        if (!tokenizer_add_to_token (self, '\"'))
-          *error = TOKEN_ERROR_TOO_LONG; 
-	slurped++;
-	}
+      if (TOKENIZER_PEEK (self, slurped + 1) == '\"')
+        slurped += 2;
       else
         stop = TRUE;
-      slurped++;
       }
     else
-      {
-      if (!tokenizer_add_to_token (self, c))
-        *error = TOKEN_ERROR_TOO_LONG; 
       slurped++;
-      }
     }
-  //printf ("slurped string = %d\n", slurped);
+  if (slurped > TOKENIZER_MAX_SLICE)
+    {
+    *error = TOKEN_ERROR_TOO_LONG; 
+    self->token_length = TOKEN_MAX_LENGTH;
+    }
+  else
+    self->token_length = slurped;
+  if (c == '\"') slurped++; // Skip the closing quote
   return slurped;
   }
 
 /*===========================================================================
   tokenizer_slurp_word
+  A word can end with a $, which makes it the name of a string variable
+    or function
 ===========================================================================*/
 static int tokenizer_slurp_word (Tokenizer *self, TokenError *error)
   {
-  const char *p = self->pos;
   int slurped = 0;
   char c;
-  while (c = p[slurped], (isalnum (c) || c == '?') 
-               && slurped < TOKEN_MAX_LENGTH)
+  while (c = TOKENIZER_PEEK (self, slurped), 
+           TOKENIZER_IS (c, WORD) && slurped < TOKEN_MAX_LENGTH)
     {
-    if (!tokenizer_add_to_token (self, c))
-      *error = TOKEN_ERROR_TOO_LONG; 
     slurped++;
     }
-  //printf ("slurped word = %d\n", slurped);
+  if (c == '$') slurped++;
+  if (slurped > TOKENIZER_MAX_SLICE)
+    *error = TOKEN_ERROR_TOO_LONG; 
+  self->token_length = slurped;
   return slurped;
   }
 
 /*===========================================================================
-  tokenizer_slurp_decimal
+  tokenizer_slice
+  Get the first length characters of the current token, copying them
+    into fetched if the text can't be addressed directly
 ===========================================================================*/
-static int tokenizer_slurp_decimal (Tokenizer *self, TokenError *error)
+static const char *tokenizer_slice (Tokenizer *self, uint8_t length)
   {
-  const char *p = self->pos;
-  int slurped = 0;
-  char c = p[slurped];
-  slurped++;
-  VARTYPE total = c - '0'; 
-  tokenizer_add_to_token (self, c);
-  while (c = p[slurped], isdigit (c) && slurped < TOKEN_MAX_LENGTH)
-    {
-    if (!tokenizer_add_to_token (self, c))
-      *error = TOKEN_ERROR_TOO_LONG; 
-    slurped++; 
-    total = 10 * total + (c - '0');
-    }
-  self->number_value = total;
-  //printf ("slurped num = %d\n", slurped);
-  return slurped;
+  if (self->text) return self->text + self->token_pos;
+  for (uint8_t i = 0; i < length; i++)
+    self->fetched[i] = self->fetch (self->source, self->token_pos + i);
+  return self->fetched;
   }
 
 /*===========================================================================
-  tokenizer_hex_digit_val
+  tokenizer_slurp_number
+  Find the extent of a number whose digits are in the class cls, and
+    convert it with numparse
 ===========================================================================*/
-static int tokenizer_hex_digit_val (char c)
+static int tokenizer_slurp_number (Tokenizer *self, TokenClass cls, 
+             TokenError *error)
   {
-  if (c >= '0' && c <= '9') return c - '0';
-  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
-  return c - 'a' + 10;
-  }
-
-/*===========================================================================
-  tokenizer_slurp_hex
-===========================================================================*/
-static int tokenizer_slurp_hex (Tokenizer *self, TokenError *error)
-  {
-  const char *p = self->pos;
-  int slurped = 0;
-  char c = p[slurped];
-  slurped++;
-  VARTYPE total = tokenizer_hex_digit_val (c); 
-  tokenizer_add_to_token (self, c);
-  while (c = p[slurped], isxdigit (c) && slurped < TOKEN_MAX_LENGTH)
+  int slurped = 1;
+  char c;
+  while (c = TOKENIZER_PEEK (self, slurped), 
+           (TOKENIZER_CLASS (c) & cls) && slurped < TOKEN_MAX_LENGTH)
     {
-    if (!tokenizer_add_to_token (self, c))
-      *error = TOKEN_ERROR_TOO_LONG; 
     slurped++; 
-    total = 16 * total + tokenizer_hex_digit_val (c); 
     }
-  self->number_value = total;
-  //printf ("slurped hex num = %d\n", slurped);
+  // In fixed-point mode, a decimal number may have a fraction. A hex
+  //   number never does: it gives the bits of the number directly
+  BOOL fixed = FIXEDPOINT_ON && cls == TOKENIZER_CLASS_DIGIT;
+  if (fixed && TOKENIZER_PEEK (self, slurped) == '.')
+    {
+    slurped++;
+    while (c = TOKENIZER_PEEK (self, slurped), 
+             TOKENIZER_IS (c, DIGIT) && slurped < TOKEN_MAX_LENGTH)
+      {
+      slurped++; 
+      }
+    }
+  self->token_length = slurped;
+  if (slurped > TOKENIZER_MAX_SLICE)
+    {
+    *error = TOKEN_ERROR_TOO_LONG; 
+    return slurped;
+    }
+  const char *s = tokenizer_slice (self, slurped);
+  BOOL ok;
+  if (cls == TOKENIZER_CLASS_HEX) 
+    ok = numparse_hex (s, slurped, &self->number_value);
+#ifdef FIXED_POINT
+  else if (fixed)
+    ok = numparse_fixed (s, slurped, &self->number_value);
+#endif
+  else
+    ok = numparse_decimal (s, slurped, &self->number_value);
+  if (!ok)
+    *error = TOKEN_ERROR_NUMBER_TOO_LONG; 
   return slurped;
   }
 
@@ -212,10 +331,9 @@ static int tokenizer_slurp_hex (Tokenizer *self, TokenError *error)
 static int tokenizer_slurp_whitespace (Tokenizer *self, TokenError *error)
   {
   (void)error;
-  const char *p = self->pos;
   int slurped = 0;
   char c;
-  while (c = p[slurped], c == ' ' || c == '\t')
+  while (c = TOKENIZER_PEEK (self, slurped), TOKENIZER_IS (c, SPACE))
     {
     slurped++; 
     }
@@ -223,19 +341,6 @@ static int tokenizer_slurp_whitespace (Tokenizer *self, TokenError *error)
   return slurped;
   }
 
-/*===========================================================================
-  tokenizer_is_symbol_char
-===========================================================================*/
-static BOOL tokenizer_is_symbol_char (char c)
-  {
-  if (c >= '0' && c <= '9') return FALSE; 
-  if (c >= 'a' && c <= 'z') return FALSE; 
-  if (c >= 'A' && c <= 'Z') return FALSE; 
-  if (c == 0) return FALSE;
-  if (c == '\n') return FALSE;
-  return TRUE; // TODO
-  }
-
 /*===========================================================================
   tokenizer_slurp_symbol
 ===========================================================================*/
@@ -244,8 +349,8 @@ static int tokenizer_slurp_symbol (Tokenizer *self, TokenError *error)
   // This is easy, because we already know there's a symbol at pos
   //   on entry, and all symbols are one character long (so far)
   (void)error;
-  tokenizer_add_to_token (self, *self->pos);
-  //printf ("slurped symbol %c\n", *self->pos);
+  self->sym = TOKENIZER_PEEK (self, 0);
+  self->token_length = 1;
   return 1;
   }
 
@@ -255,18 +360,44 @@ static int tokenizer_slurp_symbol (Tokenizer *self, TokenError *error)
 void tokenizer_next (Tokenizer *self, TokenError *error)
   {
   if (self->finished) return; // Don't waste time doing nothing
-  self->current_token_index = 0;
+  self->token_length = 0;
   self->number_value = 0;
-  self->current_token[0] = 0;
-  char c = *self->pos;
-  if (c == 0)
+  char c = TOKENIZER_PEEK (self, 0);
+  if (self->at_line_start)
+    {
+    // The line number is in binary, in the line header. A zero 
+    //   length marks the end of the program
+    self->at_line_start = FALSE;
+    if (c == 0)
+      {
+      self->current_token_type = TOKEN_TYPE_EOL;
+      self->finished = TRUE;
+      }
+    else
+      {
+      self->current_token_type = TOKEN_TYPE_NUMBER;
+      self->line = (uint8_t)TOKENIZER_PEEK (self, 1) 
+        | ((uint16_t)(uint8_t)TOKENIZER_PEEK (self, 2) << 8);
+      self->number_value = self->line;
+      self->pos += BASICPROGRAM_HEADER_SIZE;
+      }
+    }
+  else if (c == 0)
     {
     self->current_token_type = TOKEN_TYPE_EOL;
     self->finished = TRUE;
     }
-  else if (isalpha (c) || c == '?')
+  else if (TOKENIZER_IS_KEYWORD_BYTE (c)) // Before the symbol test
+    {
+    self->current_token_type = TOKEN_TYPE_KEYWORD;
+    self->keyword = (uint8_t)c - TOKENIZER_KEYWORD_BASE 
+      + STRINGS_FIRST_KEYWORD;
+    self->pos++;
+    }
+  else if (TOKENIZER_IS (c, WORD_START))
     {
     self->current_token_type = TOKEN_TYPE_WORD;
+    self->token_pos = self->pos;
     int slurped = tokenizer_slurp_word (self, error);
     if (!*error)
       self->pos += slurped;
@@ -274,61 +405,113 @@ void tokenizer_next (Tokenizer *self, TokenError *error)
   else if (c == '#') // Do this before slurping symbols
     {
     self->pos++;
-    if (isxdigit (*self->pos))
+    if (TOKENIZER_IS (TOKENIZER_PEEK (self, 0), HEX))
       {
       self->current_token_type = TOKEN_TYPE_NUMBER;
-      int slurped = tokenizer_slurp_hex (self, error);
+      self->token_pos = self->pos;
+      int slurped = tokenizer_slurp_number (self, 
+        TOKENIZER_CLASS_HEX, error);
       if (!*error)
         self->pos += slurped;
       }
     else
       {
       self->current_token_type = TOKEN_TYPE_SYM;
-      tokenizer_add_to_token (self, '#');
+      self->token_pos = self->pos - 1;
+      self->token_length = 1;
+      self->sym = '#';
       }
     }
-  else if (isdigit (c))
+  else if (TOKENIZER_IS (c, DIGIT))
     {
     self->current_token_type = TOKEN_TYPE_NUMBER;
-    int slurped = tokenizer_slurp_decimal (self, error);
+    self->token_pos = self->pos;
+    int slurped = tokenizer_slurp_number (self, 
+      TOKENIZER_CLASS_DIGIT, error);
     if (!*error)
       self->pos += slurped;
     }
-  else if (c == ' ' || c == '\t')
+  else if (TOKENIZER_IS (c, SPACE))
     {
     int slurped = tokenizer_slurp_whitespace (self, error);
     if (!*error)
       {
       self->pos += slurped;
       tokenizer_next (self, error);
+      return;
       }
     }
   else if (c == '\"') // Do this before symbol, because " would count
     {
     self->pos++; // Skip the leading " before slurping
     self->current_token_type = TOKEN_TYPE_STRING;
+    self->token_pos = self->pos;
     int slurped = tokenizer_slurp_string (self, error);
     if (!*error)
       self->pos += slurped;
     }
-  else if (tokenizer_is_symbol_char (c))
+  else if (TOKENIZER_IS (c, SYMBOL))
     {
     self->current_token_type = TOKEN_TYPE_SYM;
+    self->token_pos = self->pos;
     int slurped = tokenizer_slurp_symbol (self, error);
     if (!*error)
       self->pos += slurped;
     }
   else if (c == '\n')
     {
-    self->current_token_type = TOKEN_TYPE_EOL;
-    self->pos += 1;
+    // The \n is only stepped over when the EOL token has been dealt
+    //   with, and the next token is asked for. So the position at the
+    //   end of a line is the \n itself, and not the header of the next
+    //   line, which would not be recognized as such on its own
+    if (self->current_token_type == TOKEN_TYPE_EOL)
+      {
+      self->pos += 1;
+      self->at_line_start = TRUE;
+      tokenizer_next (self, error);
+      return;
+      }
+    else
+      self->current_token_type = TOKEN_TYPE_EOL;
     }
   else 
     {
     *error = TOKEN_ERROR_INTERNAL;
     }
-  //printf ("token type = %d %s\n", self->current_token_type, 
-  //  self->current_token); 
+
+  // If the text can't be addressed directly, the token has to be 
+  //   copied out of it after all. No token is longer than 
+  //   TOKEN_MAX_LENGTH
+  if (!self->text)
+    tokenizer_slice (self, self->token_length);
+  }
+
+/*===========================================================================
+  tokenizer_skip_line
+===========================================================================*/
+void tokenizer_skip_line (Tokenizer *self)
+  {
+  if (self->finished || self->current_token_type == TOKEN_TYPE_EOL) return;
+  char c;
+  if (self->text)
+    {
+    // strchr() is much faster than looking at one character at a time,
+    //   at least with the glibc version, which looks at 16 or 32 bytes 
+    //   at a time
+    const char *p = self->text + self->pos;
+    const char *nl = strchr (p, '\n');
+    if (!nl) nl = p + strlen (p);
+    self->pos = nl - self->text;
+    c = *nl;
+    }
+  else
+    {
+    while ((c = TOKENIZER_PEEK (self, 0)) && c != '\n') 
+      self->pos++;
+    }
+  self->token_length = 0;
+  self->current_token_type = TOKEN_TYPE_EOL;
+  if (c == 0) self->finished = TRUE;
   }
 
 /*===========================================================================
@@ -342,9 +525,10 @@ BOOL tokenizer_finished (const Tokenizer *self)
 /*===========================================================================
   tokenizer_get_text
 ===========================================================================*/
-const char *tokenizer_get_text (const Tokenizer *self)
+const char *tokenizer_get_text (const Tokenizer *self, uint8_t *length)
   {
-  return self->current_token;
+  *length = self->token_length;
+  return self->text ? self->text + self->token_pos : self->fetched;
   }
 
 /*===========================================================================
@@ -384,8 +568,7 @@ extern BOOL tokenizer_is_number (const Tokenizer *self)
 ===========================================================================*/
 extern BOOL tokenizer_is_symbol (const Tokenizer *self, char sym)
   {
-  return (self->current_token_type == TOKEN_TYPE_SYM
-    && self->current_token[0] == sym);
+  return (self->current_token_type == TOKEN_TYPE_SYM && self->sym == sym);
   }
 
 /*===========================================================================
@@ -393,7 +576,8 @@ extern BOOL tokenizer_is_symbol (const Tokenizer *self, char sym)
 ===========================================================================*/
 extern char tokenizer_get_sym (const Tokenizer *self)
   {
-  return self->current_token[0];
+  if (self->current_token_type != TOKEN_TYPE_SYM) return 0;
+  return self->sym;
   }
 
 /*===========================================================================
@@ -407,9 +591,10 @@ extern BOOL tokenizer_is_string (const Tokenizer *self)
 /*===========================================================================
   tokenizer_get_string
 ===========================================================================*/
-extern const char *tokenizer_get_string (const Tokenizer *self)
+extern const char *tokenizer_get_string (const Tokenizer *self, 
+                      uint8_t *length)
   {
-  return self->current_token;
+  return tokenizer_get_text (self, length);
   }
 
 /*===========================================================================
@@ -421,11 +606,31 @@ extern BOOL tokenizer_is_word (const Tokenizer *self)
   }
 
 /*===========================================================================
-  tokenizer_get_string
+  tokenizer_get_word
+===========================================================================*/
+extern const char *tokenizer_get_word (const Tokenizer *self, 
+                      uint8_t *length)
+  {
+  return tokenizer_get_text (self, length);
+  }
+
+/*===========================================================================
+  tokenizer_is_keyword
 ===========================================================================*/
-extern const char *tokenizer_get_word (const Tokenizer *self)
+BOOL tokenizer_is_keyword (const Tokenizer *self, uint8_t index)
   {
-  return self->current_token;
+  return (self->current_token_type == TOKEN_TYPE_KEYWORD
+    && self->keyword == index);
+  }
+
+/*===========================================================================
+  tokenizer_get_keyword
+===========================================================================*/
+uint8_t tokenizer_get_keyword (const Tokenizer *self)
+  {
+  if (self->current_token_type == TOKEN_TYPE_KEYWORD)
+    return self->keyword;
+  return 0;
   }
 
 /*===========================================================================
@@ -437,18 +642,215 @@ extern BOOL tokenizer_is_eol (const Tokenizer *self)
   }
 
 /*===========================================================================
-  tokenizer_is_eol
+  tokenizer_set_pos
 ===========================================================================*/
-void tokenizer_set_pos (Tokenizer *self, const char *pos)
+void tokenizer_set_pos (Tokenizer *self, TokenizerPos pos)
   {
+  // A saved position is always in the text of a line, or at its end,
+  //   and the caller will move on to the next token from there
   self->pos = pos;
+  self->at_line_start = FALSE;
+  self->current_token_type = TOKEN_TYPE_EOL;
+  }
+
+/*===========================================================================
+  tokenizer_resume
+===========================================================================*/
+void tokenizer_resume (Tokenizer *self, TokenizerPos pos, TokenError *error)
+  {
+  // Whatever the current token was, it was not the end of this line
+  self->pos = pos;
+  self->at_line_start = FALSE;
+  self->current_token_type = TOKEN_TYPE_UNKNOWN;
+  tokenizer_next (self, error);
+  }
+
+/*===========================================================================
+  tokenizer_set_line_pos
+===========================================================================*/
+void tokenizer_set_line_pos (Tokenizer *self, TokenizerPos pos)
+  {
+  // As far as the caller is concerned, the current line has ended, so
+  //   nothing after the jump on that line is run
+  self->pos = pos;
+  self->at_line_start = TRUE;
+  self->current_token_type = TOKEN_TYPE_EOL;
+  }
+
+/*===========================================================================
+  tokenizer_peek_char
+===========================================================================*/
+char tokenizer_peek_char (const Tokenizer *self)
+  {
+  return TOKENIZER_PEEK (self, 0);
+  }
+
+/*===========================================================================
+  tokenizer_text_is_stable
+===========================================================================*/
+BOOL tokenizer_text_is_stable (const Tokenizer *self)
+  {
+  return self->text != NULL;
   }
 
 /*===========================================================================
   tokenizer_get_pos
 ===========================================================================*/
-const char *tokenizer_get_pos (const Tokenizer *self)
+TokenizerPos tokenizer_get_pos (const Tokenizer *self)
   {
   return self->pos;
   }
 
+/*===========================================================================
+  tokenizer_is_word_char
+  Characters that make up words and numbers, which must be kept apart
+    by whitespace when crunching.
+===========================================================================*/
+static BOOL tokenizer_is_word_char (char c)
+  {
+  return TOKENIZER_IS (c, WORD);
+  }
+
+/*===========================================================================
+  tokenizer_lookup_keyword
+  Returns the token byte for the word of length len at p, or zero if
+    it is not a keyword. "?" is short for PRINT.
+===========================================================================*/
+static uint8_t tokenizer_lookup_keyword (const char *p, int len)
+  {
+  if (len == 1 && p[0] == '?') 
+    return TOKENIZER_KEYWORD_BYTE (STRING_INDEX_PRINT);
+  if (len > TOKEN_MAX_LENGTH) return 0;
+  for (uint8_t i = 0; i < STRINGS_NUM_KEYWORDS; i++)
+    {
+    if (strings_compare_index_n (p, len, STRINGS_FIRST_KEYWORD + i))
+      return TOKENIZER_KEYWORD_BYTE (STRINGS_FIRST_KEYWORD + i);
+    }
+  return 0;
+  }
+
+/*===========================================================================
+  tokenizer_crunch
+===========================================================================*/
+void tokenizer_crunch (const char *in, char *out)
+  {
+  BOOL verbatim = FALSE; // In a string, or the text of a REM
+  BOOL in_string = FALSE;
+  char last = 0; // The last character written on this line
+  char c;
+  while ((c = *in))
+    {
+    if (c == '\n')
+      {
+      *out++ = *in++;
+      verbatim = FALSE;
+      in_string = FALSE;
+      last = 0;
+      }
+    else if (verbatim)
+      {
+      if (in_string && c == '\"')
+        {
+        // A doubled "" is an escaped ", and just ends and restarts
+        //   the string, which does no harm
+        verbatim = FALSE;
+        in_string = FALSE;
+        }
+      *out++ = *in++;
+      last = c;
+      }
+    else if (TOKENIZER_IS (c, SPACE))
+      {
+      while (TOKENIZER_IS (*in, SPACE)) in++;
+      // Two strings must be kept apart too, or they would read as one
+      //   string with an escaped "
+      if ((tokenizer_is_word_char (last) && tokenizer_is_word_char (*in))
+          || (last == '\"' && *in == '\"'))
+        last = *out++ = ' ';
+      }
+    else if (c == '\"')
+      {
+      verbatim = TRUE;
+      in_string = TRUE;
+      last = *out++ = *in++;
+      }
+    else if (c == '#')
+      {
+      // Hex number -- don't let the digits be mistaken for a word
+      last = *out++ = *in++;
+      while (TOKENIZER_IS (*in, HEX))
+        last = *out++ = *in++;
+      }
+    else if (TOKENIZER_IS (c, WORD_START))
+      {
+      int len = 0;
+      while (tokenizer_is_word_char (in[len])) len++;
+      if (in[len] == '$') len++;
+      uint8_t kw = tokenizer_lookup_keyword (in, len);
+      if (kw)
+        {
+        *out++ = kw;
+        last = kw;
+        in += len;
+        }
+      else
+        {
+        memmove (out, in, len);
+        out += len;
+        in += len;
+        last = out[-1];
+        }
+      }
+    else
+      {
+      last = *out++ = *in++;
+      }
+
+    if (!verbatim && (uint8_t)last == TOKENIZER_KEYWORD_BYTE (STRING_INDEX_REM))
+      {
+      // The rest of the line is a comment, which is kept as it is, 
+      //   apart from leading space
+      while (TOKENIZER_IS (*in, SPACE)) in++;
+      verbatim = TRUE;
+      }
+    }
+  *out = 0;
+  }
+
+/*===========================================================================
+  tokenizer_expand
+===========================================================================*/
+void tokenizer_expand (const char *b, const char *e, char *out, int len)
+  {
+  int n = 0;
+  BOOL verbatim = FALSE;
+  BOOL in_string = FALSE;
+  for (const char *p = b; p < e && n < len - 1; p++)
+    {
+    char c = *p;
+    if (!verbatim && TOKENIZER_IS_KEYWORD_BYTE (c))
+      {
+      uint8_t index = (uint8_t)c - TOKENIZER_KEYWORD_BASE 
+        + STRINGS_FIRST_KEYWORD;
+      char word [TOKEN_MAX_LENGTH + 1];
+      strings_get (index, word, sizeof (word));
+      if (n > 0 && (tokenizer_is_word_char (out[n - 1]) 
+           || out[n - 1] == '\"' || out[n - 1] == '$') && n < len - 1) 
+        out[n++] = ' ';
+      for (const char *w = word; *w && n < len - 1; w++) 
+        out[n++] = *w;
+      if (p + 1 < e && n < len - 1) out[n++] = ' ';
+      if (index == STRING_INDEX_REM) verbatim = TRUE;
+      }
+    else
+      {
+      if (c == '\"' && !(verbatim && !in_string))
+        {
+        in_string = !in_string;
+        verbatim = in_string;
+        }
+      out[n++] = c;
+      }
+    }
+  out[n] = 0;
+  }
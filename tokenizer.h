@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <stddef.h>
 #include "defs.h"
 #include "config.h"
 
@@ -16,15 +17,40 @@ typedef struct _Tokenizer Tokenizer;
 
 typedef uint8_t TokenError;
 
+// A position in the text, counted from the start
+typedef size_t TokenizerPos;
+
+// Reads the character at a position in the text. This lets a program 
+//   be run from memory that is not mapped into the address space, like
+//   EEPROM. Positions after the end of the text must read as zero.
+typedef char (*TokenizerFetch) (const void *source, TokenizerPos pos);
+
+// Keywords are stored in the program as a single byte: this value plus
+//   the keyword's position in the keyword part of the string table
+#define TOKENIZER_KEYWORD_BASE 0x80
+
 BEGIN_DECLS
 
+/** Tokenize text in memory. */
 extern Tokenizer  *tokenizer_new (const char *p);
+/** Tokenize text that is read using the fetch function, which is
+ *    passed the source. */
+extern Tokenizer  *tokenizer_new_fetch (TokenizerFetch fetch, 
+                     const void *source);
 extern void        tokenizer_destroy (Tokenizer *self);
 
 extern void        tokenizer_next (Tokenizer *self, TokenError *error);
 extern BOOL        tokenizer_finished (const Tokenizer *self);
 
-extern const char *tokenizer_get_text (const Tokenizer *self);
+/** Move straight to the end of the current line, without looking at
+ *    the tokens in between, as for the text of a REM. */
+extern void        tokenizer_skip_line (Tokenizer *self);
+
+/** Get the text of the current word, number, string or symbol, and its
+ *    length. The text is not terminated: it is usually just a pointer
+ *    into the program, and is only valid until the next token. */
+extern const char *tokenizer_get_text (const Tokenizer *self, 
+                     uint8_t *length);
 
 // Note that get_line here refers to a line in the program code, not
 //  the number _of_ a line. We're only tokenizing here, not parsing
@@ -38,14 +64,62 @@ extern BOOL        tokenizer_is_symbol (const Tokenizer *self, char sym);
 extern char        tokenizer_get_sym (const Tokenizer *self);
 
 extern BOOL        tokenizer_is_word (const Tokenizer *self);
-extern const char *tokenizer_get_word (const Tokenizer *self);
+
+/** Get the character straight after the current token, without moving
+ *    on. Crunched text has no space before a (, so this is enough to
+ *    tell an array element from an ordinary variable. */
+extern char        tokenizer_peek_char (const Tokenizer *self);
+extern const char *tokenizer_get_word (const Tokenizer *self, 
+                     uint8_t *length);
+
+/** Test whether the current token is the keyword whose string table
+ *    index is given, e.g., STRING_INDEX_ELSE. */
+extern BOOL        tokenizer_is_keyword (const Tokenizer *self, 
+                     uint8_t index);
+/** Get the string table index of the current keyword, or zero if the
+ *    current token is not a keyword. */
+extern uint8_t     tokenizer_get_keyword (const Tokenizer *self);
 
 extern BOOL        tokenizer_is_string (const Tokenizer *self);
-extern const char *tokenizer_get_string (const Tokenizer *self);
+/** Get the text of a string, without its quotes, as for 
+ *    tokenizer_get_text(). An escaped quote is left in the text as two
+ *    quotes, for the caller to decode. */
+extern const char *tokenizer_get_string (const Tokenizer *self, 
+                     uint8_t *length);
 
 extern BOOL        tokenizer_is_eol (const Tokenizer *self);
 
-extern void        tokenizer_set_pos (Tokenizer *self, const char *pos);
-extern const char *tokenizer_get_pos (const Tokenizer *self);
+/** Test whether the text returned by tokenizer_get_text() stays valid
+ *    when the tokenizer moves on, as it does when the program is in 
+ *    memory. Otherwise it is a copy, which the next token replaces. */
+extern BOOL        tokenizer_text_is_stable (const Tokenizer *self);
+
+/** Move to a position returned by tokenizer_get_pos(). The next call to
+ *    tokenizer_next() continues from there. */
+extern void        tokenizer_set_pos (Tokenizer *self, TokenizerPos pos);
+/** Move to a position returned by tokenizer_get_pos(), in the middle of
+ *    an expression, and read the token that follows it. Unlike after
+ *    tokenizer_set_pos(), an end of line there is a token of its own. */
+extern void        tokenizer_resume (Tokenizer *self, TokenizerPos pos,
+                     TokenError *error);
+/** Move to the header of a line of the stored program (or the end of 
+ *    the program). The next token will be the line number. */
+extern void        tokenizer_set_line_pos (Tokenizer *self, 
+                     TokenizerPos pos);
+extern TokenizerPos tokenizer_get_pos (const Tokenizer *self);
+
+/** Convert the text of a line, without its line number, to the form 
+ *    in which it is stored and run: keywords are replaced by single-byte
+ *    tokens, and whitespace that does not separate two words, numbers,
+ *    or strings is removed. Strings and the text of REM are not changed.
+ *    The result is never longer than the input, so in and out may be 
+ *    the same. Text that is already crunched is unchanged. */
+extern void        tokenizer_crunch (const char *in, char *out);
+
+/** Convert crunched text, from b up to (not including) e, back to
+ *    readable text, writing no more than len bytes, including the
+ *    terminating zero, into out. */
+extern void        tokenizer_expand (const char *b, const char *e, 
+                     char *out, int len);
 
 END_DECLS
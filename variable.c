@@ -14,7 +14,6 @@
 #include "config.h"
 #include "defs.h"
 #include "config.h"
-#include "klist.h"
 #include "variable.h"
 
 /*===========================================================================
@@ -22,35 +21,32 @@
 ===========================================================================*/
 struct _Variable
   {
-  char *name;
+  // The number, or for a string variable the StringHandle, which is
+  //   just the unsigned version of the same type
   VARTYPE num_value;
-  //char *str_value; // Future use
+  char name[];
   };
 
-
 /*===========================================================================
-  variable_new_number
+  variable_size
 ===========================================================================*/
-Variable *variable_new_number (const char *name, VARTYPE number)
+size_t variable_size (size_t name_len)
   {
-  Variable *self = malloc (sizeof (Variable));
-  if (self)
-    {
-    self->name = strdup (name);
-    self->num_value = number;
-    //self->str_value = NULL; // Future use
-    }
-  return self;
+  size_t size = offsetof (Variable, name) + name_len + 1;
+  return (size + sizeof (VARTYPE) - 1) / sizeof (VARTYPE) * sizeof (VARTYPE);
   }
 
 /*===========================================================================
-  variable_destroy
+  variable_init
 ===========================================================================*/
-void variable_destroy (Variable *self)
+Variable *variable_init (void *mem, const char *name, size_t name_len, 
+             VARTYPE number)
   {
-  // if (self->str_value) free (self->str_value); // Future use
-  if (self->name) free (self->name);
-  free (self);
+  Variable *self = mem;
+  self->num_value = number;
+  memcpy (self->name, name, name_len);
+  self->name[name_len] = 0;
+  return self;
   }
 
 /*===========================================================================
@@ -77,6 +73,14 @@ VARTYPE variable_get_number (const Variable *self)
   return self->num_value;
   }
 
+/*===========================================================================
+  variable_get_string
+===========================================================================*/
+StringHandle *variable_get_string (Variable *self)
+  {
+  return (StringHandle *)&self->num_value;
+  }
+
 
 
 
@@ -4,8 +4,12 @@
 
   variable.h
 
-  This class represents a single variable which, for now, has only
-  numeric type
+  This class represents a single variable. A variable whose name ends
+  in $ is a string variable, and holds a handle to its value in the
+  string heap, where a numeric variable holds its number. Variables do not allocate their own memory: the variable
+  table places them in its arena, using variable_init(). The name is
+  stored immediately after the value, so each variable is a single
+  block of variable_size() bytes.
 
   (c)2021 Kevin Boone, GPLv3.0
 
@@ -13,20 +17,35 @@
 
 #pragma once
 
+#include <stddef.h>
 #include "defs.h"
 #include "config.h"
+#include "stringheap.h"
 
 struct _Variable;
 typedef struct _Variable Variable;
 
 BEGIN_DECLS
 
-extern Variable   *variable_new_number (const char *name, VARTYPE number);
-extern void        variable_destroy (Variable *self);
+/** Get the number of bytes needed to store a variable whose name is
+ *    name_len characters long. This is always a multiple of 
+ *    sizeof (VARTYPE), so variables can be placed one after another. */
+extern size_t      variable_size (size_t name_len);
+
+/** Create a variable in the block at mem, which must be suitably 
+ *    aligned and at least variable_size(name_len) bytes long. The name
+ *    need not be terminated, as it usually comes straight from the 
+ *    program text. */
+extern Variable   *variable_init (void *mem, const char *name, 
+                     size_t name_len, VARTYPE number);
 
 extern const char *variable_get_name (const Variable *self);
 extern VARTYPE     variable_get_number (const Variable *self);
 extern void        variable_set_number (Variable *self, VARTYPE number);
 
+/** Get the handle of a string variable's value, which the string heap
+ *    updates when the value moves. */
+extern StringHandle *variable_get_string (Variable *self);
+
 END_DECLS
 
@@ -12,62 +12,201 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "config.h"
 #include "defs.h"
 #include "config.h"
-#include "klist.h"
 #include "variabletable.h"
 #include "variable.h"
+#include "stringheap.h"
+#include "heap.h"
 #include "errcodes.h"
 
 /*===========================================================================
-  VariableTable 
+  VariableArena
+  A block of memory that variables are placed in, one after another.
+  The data is declared as VARTYPE to get the alignment right.
+===========================================================================*/
+typedef struct _VariableArena
+  {
+  struct _VariableArena *next;
+  size_t used; // Bytes
+  VARTYPE data [VARIABLE_ARENA_SIZE / sizeof (VARTYPE)];
+  } VariableArena;
+
+/*===========================================================================
+  Array
+  An array is a single block: this header, the name, and then the 
+  elements, at the first offset that is suitably aligned for them. 
+===========================================================================*/
+typedef struct _Array
+  {
+  struct _Array *next;
+  UVARTYPE bound; // Largest subscript
+  VARTYPE *elements;
+  char name[];
+  } Array;
+
+// Arrays in the static pool are placed one after another, so each one
+//   must be a whole number of these
+typedef union _ArrayUnit
+  {
+  void *p;
+  VARTYPE v;
+  } ArrayUnit;
+
+/*===========================================================================
+  VariableTable
+  Variables are never removed individually, so they can simply be
+  allocated from the end of the current arena, and all removed by
+  resetting it. Without STATIC_POOLS, further arenas are allocated as
+  needed, and kept for re-use after a clear.
+  Arrays are kept on a separate list, because they can be far larger
+  than an arena. With STATIC_POOLS they come from their own pool, in
+  the same way as variables; otherwise each one is allocated on the heap.
+  The values of string variables are in the string heap.
 ===========================================================================*/
 struct _VariableTable
   {
-  KList *list; // Of Variable
+  VariableArena first;
+  VariableArena *current;
+  Array *arrays;
+  StringHeap *strings;
+#ifdef STATIC_POOLS
+  size_t array_pool_used; // Units
+#endif
   };
 
+#ifdef STATIC_POOLS
+static VariableTable variabletable_pool;
+static ArrayUnit variabletable_array_pool [POOL_ARRAYS / sizeof (ArrayUnit)];
+#endif
 
 /*===========================================================================
   variabletable_new_empty
 ===========================================================================*/
 VariableTable *variabletable_new_empty (void)
   {
-  VariableTable *self = malloc (sizeof (VariableTable));
+#ifdef STATIC_POOLS
+  VariableTable *self = &variabletable_pool;
+#else
+  VariableTable *self = HEAP_MALLOC (HEAP_SITE_VARIABLE,
+    sizeof (VariableTable));
+#endif
   if (self)
     {
-    self->list = klist_new_empty ((KListFreeFn)variable_destroy);
+    self->strings = stringheap_new ();
+    if (!self->strings)
+      {
+#ifndef STATIC_POOLS
+      HEAP_FREE (HEAP_SITE_VARIABLE, self);
+#endif
+      return NULL;
+      }
+    self->first.next = NULL;
+    self->arrays = NULL;
+    variabletable_clear (self);
     }
   return self;
   }
 
+/*===========================================================================
+  variabletable_free_arrays
+===========================================================================*/
+static void variabletable_free_arrays (VariableTable *self)
+  {
+#ifdef STATIC_POOLS
+  self->array_pool_used = 0;
+#else
+  Array *a = self->arrays;
+  while (a)
+    {
+    Array *next = a->next;
+    HEAP_FREE (HEAP_SITE_ARRAY, a);
+    a = next;
+    }
+#endif
+  self->arrays = NULL;
+  }
+
 /*===========================================================================
   variabletable_destroy
 ===========================================================================*/
 void variabletable_destroy (VariableTable *self)
   {
-  if (self->list) klist_destroy (self->list);
-  free (self);
+  variabletable_free_arrays (self);
+  stringheap_destroy (self->strings);
+#ifndef STATIC_POOLS
+  VariableArena *arena = self->first.next;
+  while (arena)
+    {
+    VariableArena *next = arena->next;
+    HEAP_FREE (HEAP_SITE_VARIABLE, arena);
+    arena = next;
+    }
+  HEAP_FREE (HEAP_SITE_VARIABLE, self);
+#else
+  (void)self;
+#endif
+  }
+
+/*===========================================================================
+  variabletable_alloc
+  Get space for a variable of the specified size, moving on to the
+    next arena if the current one is full. Returns NULL if there is
+    no memory.
+===========================================================================*/
+static void *variabletable_alloc (VariableTable *self, size_t size)
+  {
+  VariableArena *arena = self->current;
+  if (arena->used + size > VARIABLE_ARENA_SIZE)
+    {
+#ifdef STATIC_POOLS
+    return NULL;
+#else
+    if (!arena->next)
+      {
+      arena->next = HEAP_MALLOC (HEAP_SITE_VARIABLE, sizeof (VariableArena));
+      if (!arena->next) return NULL;
+      arena->next->next = NULL;
+      }
+    arena = arena->next;
+    arena->used = 0;
+    self->current = arena;
+#endif
+    }
+  void *ret = (char *)arena->data + arena->used;
+  arena->used += size;
+  return ret;
   }
 
 /*===========================================================================
   variabletable_set_number
 ===========================================================================*/
-void variabletable_set_number (VariableTable *self, const char *name, 
-        VARTYPE number, uint8_t *error)
+void variabletable_set_number (VariableTable *self, const char *name,
+        uint8_t len, VARTYPE number, uint8_t *error)
   {
-  // TODO check if name exists
-  Variable *v = variabletable_get_variable (self, name);
+  if (len > 0 && name[len - 1] == '$')
+    {
+    // Setting a string variable's number would lose its value
+    *error = BASIC_ERR_TYPE_MISMATCH;
+    return;
+    }
+  Variable *v = variabletable_get_variable (self, name, len);
   if (v)
     {
     variable_set_number (v, number);
     }
+  else if (len > MAX_VARIABLE_NAME)
+    {
+    *error = BASIC_ERR_NAME_TOO_LONG;
+    }
   else
     {
-    Variable *v = variable_new_number (name, number);
-    if (v)
-      klist_append (self->list, v);
+    void *mem = variabletable_alloc (self, variable_size (len));
+    if (mem)
+      variable_init (mem, name, len, number);
     else
       *error = BASIC_ERR_NOMEM;
     }
@@ -76,25 +215,33 @@ void variabletable_set_number (VariableTable *self, const char *name,
 /*===========================================================================
   variabletable_get_variable
 ===========================================================================*/
-Variable *variabletable_get_variable (const VariableTable *self, 
-         const char *name)
+Variable *variabletable_get_variable (const VariableTable *self,
+         const char *name, uint8_t len)
   {
-  int l = klist_length (self->list);
-  for (int i = 0; i < l; i++)
+  const VariableArena *arena = &self->first;
+  while (arena)
     {
-    Variable *v = klist_get (self->list, i);
-    if (strcmp (name, variable_get_name (v)) == 0) return v;
+    const char *p = (const char *)arena->data;
+    const char *end = p + arena->used;
+    while (p < end)
+      {
+      Variable *v = (Variable *)p;
+      const char *vname = variable_get_name (v);
+      if (strncmp (name, vname, len) == 0 && vname[len] == 0) return v;
+      p += variable_size (strlen (vname));
+      }
+    arena = (arena == self->current) ? NULL : arena->next;
     }
   return NULL;
   }
 
 /*===========================================================================
-  variabletable_get_variable
+  variabletable_get_number
 ===========================================================================*/
 BOOL variabletable_get_number (const VariableTable *self,
-                          const char *name, VARTYPE *value)
+                          const char *name, uint8_t len, VARTYPE *value)
   {
-  Variable *v = variabletable_get_variable (self, name);
+  Variable *v = variabletable_get_variable (self, name, len);
   if (v)
     {
     *value = variable_get_number (v);
@@ -104,12 +251,140 @@ BOOL variabletable_get_number (const VariableTable *self,
     return FALSE;
   }
 
+/*===========================================================================
+  variabletable_get_string
+===========================================================================*/
+StringHandle *variabletable_get_string (const VariableTable *self,
+         const char *name, uint8_t len)
+  {
+  Variable *v = variabletable_get_variable (self, name, len);
+  return v ? variable_get_string (v) : NULL;
+  }
+
+/*===========================================================================
+  variabletable_new_string
+===========================================================================*/
+StringHandle *variabletable_new_string (VariableTable *self, 
+         const char *name, uint8_t len, uint8_t *error)
+  {
+  if (len > MAX_VARIABLE_NAME)
+    {
+    *error = BASIC_ERR_NAME_TOO_LONG;
+    return NULL;
+    }
+  void *mem = variabletable_alloc (self, variable_size (len));
+  if (!mem)
+    {
+    *error = BASIC_ERR_NOMEM;
+    return NULL;
+    }
+  // A handle of zero is an empty string
+  return variable_get_string (variable_init (mem, name, len, 0));
+  }
+
+/*===========================================================================
+  variabletable_get_string_heap
+===========================================================================*/
+StringHeap *variabletable_get_string_heap (const VariableTable *self)
+  {
+  return self->strings;
+  }
+
+/*===========================================================================
+  variabletable_dim_array
+===========================================================================*/
+void variabletable_dim_array (VariableTable *self, const char *name,
+        uint8_t len, VARTYPE bound, uint8_t *error)
+  {
+  // Variables survive from one run to the next, so a program that 
+  //   dimensions an array will find it already there the second time. 
+  //   That's fine, so long as it is the same size
+  UVARTYPE old_bound;
+  VARTYPE *old = variabletable_get_array (self, name, len, &old_bound);
+  if (old)
+    {
+    if (old_bound == (UVARTYPE)bound)
+      memset (old, 0, ((size_t)bound + 1) * sizeof (VARTYPE));
+    else
+      *error = BASIC_ERR_ARRAY_DEFINED;
+    return;
+    }
+  if (len > MAX_VARIABLE_NAME)
+    {
+    *error = BASIC_ERR_NAME_TOO_LONG;
+    return;
+    }
+  if (bound < 0)
+    {
+    *error = BASIC_ERR_BAD_SUBSCRIPT;
+    return;
+    }
+
+  size_t units = (offsetof (Array, name) + len + 1 + sizeof (ArrayUnit) - 1)
+    / sizeof (ArrayUnit);
+  size_t header = units * sizeof (ArrayUnit);
+  // Take care that the size can't overflow, where size_t is small
+  if ((UVARTYPE)bound >= (SIZE_MAX - header - sizeof (ArrayUnit)) 
+        / sizeof (VARTYPE))
+    {
+    *error = BASIC_ERR_NOMEM;
+    return;
+    }
+  size_t data_size = ((size_t)bound + 1) * sizeof (VARTYPE);
+  size_t size = header + data_size;
+
+#ifdef STATIC_POOLS
+  size_t size_units = (size + sizeof (ArrayUnit) - 1) / sizeof (ArrayUnit);
+  if (size_units > sizeof (variabletable_array_pool) / sizeof (ArrayUnit) 
+       - self->array_pool_used)
+    {
+    *error = BASIC_ERR_NOMEM;
+    return;
+    }
+  Array *a = (Array *)&variabletable_array_pool [self->array_pool_used];
+  self->array_pool_used += size_units;
+#else
+  Array *a = HEAP_MALLOC (HEAP_SITE_ARRAY, size);
+  if (!a)
+    {
+    *error = BASIC_ERR_NOMEM;
+    return;
+    }
+#endif
+  a->bound = bound;
+  a->elements = (VARTYPE *)((ArrayUnit *)a + units);
+  memset (a->elements, 0, data_size);
+  memcpy (a->name, name, len);
+  a->name[len] = 0;
+  a->next = self->arrays;
+  self->arrays = a;
+  }
+
+/*===========================================================================
+  variabletable_get_array
+===========================================================================*/
+VARTYPE *variabletable_get_array (const VariableTable *self, 
+         const char *name, uint8_t len, UVARTYPE *bound)
+  {
+  for (const Array *a = self->arrays; a; a = a->next)
+    {
+    if (strncmp (name, a->name, len) == 0 && a->name[len] == 0) 
+      {
+      if (bound) *bound = a->bound;
+      return a->elements;
+      }
+    }
+  return NULL;
+  }
+
 /*===========================================================================
   variabletable_clear
 ===========================================================================*/
 void variabletable_clear (VariableTable *self)
   {
-  klist_clear (self->list);
+  self->first.used = 0;
+  self->current = &self->first;
+  variabletable_free_arrays (self);
+  stringheap_clear (self->strings);
   }
 
-
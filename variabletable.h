@@ -4,8 +4,10 @@
 
   variabletable.h
 
-  This class represents the variable table. It is implemented as a KList
-  of pointers to Variable instances.
+  This class represents the variable table. Variables are allocated
+  one after another from an arena, and are never removed individually;
+  variabletable_clear() removes them all at once, just by resetting the
+  arena.
 
   Some of these functions return error codes -- these valuee must be
   one of the constants defined in errcodes.h.
@@ -19,6 +21,7 @@
 #include "defs.h"
 #include "config.h"
 #include "variable.h"
+#include "stringheap.h"
 
 struct _VariableTable;
 typedef struct _VariableTable VariableTable;
@@ -27,11 +30,38 @@ BEGIN_DECLS
 
 extern VariableTable *variabletable_new_empty (void);
 extern void     variabletable_destroy (VariableTable *self);
+/* Variable names are passed with their lengths, and need not be 
+ *   terminated, so they can be taken directly from the program text. */
 extern void     variabletable_set_number (VariableTable *self, 
-                          const char *name, VARTYPE number, uint8_t *error);
+                          const char *name, uint8_t len, VARTYPE number, 
+                          uint8_t *error);
 extern Variable *variabletable_get_variable 
-                         (const VariableTable *self, const char *name);
+                         (const VariableTable *self, const char *name,
+                          uint8_t len);
 extern BOOL     variabletable_get_number (const VariableTable *self,
-                          const char *name, VARTYPE *value);
+                          const char *name, uint8_t len, VARTYPE *value);
+/* Arrays are kept apart from other variables, so an array can have the
+ *   same name as an ordinary variable. Subscripts run from 0 to the
+ *   bound given when the array is created, and all elements start at
+ *   zero. */
+extern void     variabletable_dim_array (VariableTable *self, 
+                          const char *name, uint8_t len, VARTYPE bound, 
+                          uint8_t *error);
+/* Get the elements of an array, and its bound if bound is not NULL. 
+ *   Returns NULL if there is no such array. The elements don't move
+ *   until the table is cleared. */
+extern VARTYPE *variabletable_get_array (const VariableTable *self, 
+                          const char *name, uint8_t len, UVARTYPE *bound);
+/* String variables are ordinary variables whose names end in $. The
+ *   table owns the string heap that their values are kept in. 
+ *   variabletable_get_string() returns NULL if there is no such 
+ *   variable; variabletable_new_string() creates one, whose value is
+ *   empty. */
+extern StringHandle *variabletable_get_string (const VariableTable *self,
+                          const char *name, uint8_t len);
+extern StringHandle *variabletable_new_string (VariableTable *self, 
+                          const char *name, uint8_t len, uint8_t *error);
+extern StringHeap *variabletable_get_string_heap 
+                         (const VariableTable *self);
 extern void     variabletable_clear (VariableTable *self);
 END_DECLS